@@ -20,6 +20,38 @@ namespace app
         bool isDirectory{false};
         bool debug{false};
         bool saveDebug{false};
+
+        // Headless (CLI) overrides; empty/0 keep the interactive defaults
+        std::string outputRoot;     // replaces MCE_OUTPUT_ROOT / ./mce_output when set
+        int threads{0};             // batch workers; 0 = one per hardware thread
+        int scanThreads{0};         // angle-sweep threads per image; 0 = cores / workers
+        int readers{1};             // decode threads feeding the workers (sequence mode: one per worker)
+        std::string format{"csv"};  // results file format: csv, jsonl or columnar
+        bool quiet{false};          // suppress per-image console lines
+        bool pyramid{false};        // locate on a downscale, refine at full res
+        double pyramidTol{1.0};     // max coverage drift (pct points) before full-res re-run
+        int validateTopK{0};        // sweep angles warped + validated per image; 0 = all
+        std::string validatorOrder{"adaptive"}; // "adaptive", "fixed" or a comma list of validators
+        bool kmeansValidator{true};             // color-cluster validator: kmeans (false = the palette)
+        int gateMinHues{0};                     // pre-sweep hue gate strictness; 0 = off
+        double decodeBudgetMp{0.0};             // decode large JPEGs reduced, keeping >= this many MP; 0 = full
+        bool multiMarker{false};                // report every validated component, not just the best
+        int maxMarkers{8};                      // multi-marker: results per image
+        double multiBudgetMs{0.0};              // multi-marker: sweep time budget per image; 0 = none
+        bool sequence{false};                   // frames of a directory seed each other (tracking)
+        std::string sequenceOrder{"name"};      // sequence frame order: "name" (natural) or "mtime"
+        double trackPad{0.25};                  // tracking ROI pad, fraction of the prior box's long side
+        std::string debugFormat{"png"};         // debug artifact encoding: "png" or "jpg"
+        int debugQuality{-1};                   // PNG level 0..9 / JPEG quality 1..100; -1 = codec default
+        int debugPreview{0};                    // downscale debug images to this long side; 0 = full size
+        int debugWriters{2};                    // debug encoder threads
+        bool debugPack{false};                  // one <ts>.tar (+ .idx) instead of loose debug files
+        // Debug capture policies (OR-ed; none set = every image)
+        bool debugFailures{false};              // images with no marker
+        int debugEvery{0};                      // every Nth input (1st, N+1th, ...); 0 = off
+        double debugSlowMs{0.0};                // detection slower than this; 0 = off
+        double debugCoverageLo{-1.0};           // a marker's coverage outside [lo, hi]; hi < 0 = off
+        double debugCoverageHi{-1.0};
     };
     class Application
     {
@@ -0,0 +1,152 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <thread>
+
+namespace mce
+{
+    // Bounded lock-free MPMC queue (Vyukov): a ring of cells, each with a
+    // sequence number that says whose turn it is. One CAS per push/pop, no
+    // allocation after construction. T must be default-constructible and
+    // move-assignable; popped cells keep a moved-from T until reused.
+    template <class T>
+    class BoundedQueue
+    {
+    public:
+        // Capacity is rounded up to a power of two (at least 2)
+        explicit BoundedQueue(std::size_t capacity)
+        {
+            std::size_t n = 2;
+            while (n < capacity)
+                n *= 2;
+            mask_ = n - 1;
+            cells_.reset(new Cell[n]);
+            for (std::size_t i = 0; i < n; ++i)
+                cells_[i].seq.store(i, std::memory_order_relaxed);
+        }
+        BoundedQueue(const BoundedQueue &) = delete;
+        BoundedQueue &operator=(const BoundedQueue &) = delete;
+
+        std::size_t capacity() const { return mask_ + 1; }
+
+        // False when full; `v` is only moved from on success
+        bool try_push(T &v)
+        {
+            Cell *c;
+            std::size_t pos = tail_.load(std::memory_order_relaxed);
+            for (;;)
+            {
+                c = &cells_[pos & mask_];
+                const std::size_t seq = c->seq.load(std::memory_order_acquire);
+                const std::intptr_t dif = (std::intptr_t)seq - (std::intptr_t)pos;
+                if (dif == 0)
+                {
+                    if (tail_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                        break;
+                }
+                else if (dif < 0)
+                    return false;
+                else
+                    pos = tail_.load(std::memory_order_relaxed);
+            }
+            c->value = std::move(v);
+            c->seq.store(pos + 1, std::memory_order_release);
+            return true;
+        }
+
+        // False when empty
+        bool try_pop(T &out)
+        {
+            Cell *c;
+            std::size_t pos = head_.load(std::memory_order_relaxed);
+            for (;;)
+            {
+                c = &cells_[pos & mask_];
+                const std::size_t seq = c->seq.load(std::memory_order_acquire);
+                const std::intptr_t dif = (std::intptr_t)seq - (std::intptr_t)(pos + 1);
+                if (dif == 0)
+                {
+                    if (head_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                        break;
+                }
+                else if (dif < 0)
+                    return false;
+                else
+                    pos = head_.load(std::memory_order_relaxed);
+            }
+            out = std::move(c->value);
+            c->seq.store(pos + mask_ + 1, std::memory_order_release);
+            return true;
+        }
+
+        // Items currently queued (racy snapshot, for occupancy sampling)
+        std::size_t size_approx() const
+        {
+            const std::size_t t = tail_.load(std::memory_order_relaxed);
+            const std::size_t h = head_.load(std::memory_order_relaxed);
+            return t > h ? t - h : 0;
+        }
+
+    private:
+        struct Cell
+        {
+            std::atomic<std::size_t> seq{0};
+            T value{};
+        };
+        std::unique_ptr<Cell[]> cells_;
+        std::size_t mask_ = 0;
+        alignas(64) std::atomic<std::size_t> tail_{0};
+        alignas(64) std::atomic<std::size_t> head_{0};
+    };
+
+    // Backpressure: spin briefly, then yield, then sleep in steps growing
+    // from 50 µs to 1 ms, so long-idle consumers (parked encoder threads)
+    // stay cheap. Both return the nanoseconds spent waiting (0 when it went
+    // straight in).
+    namespace detail
+    {
+        inline void backoff(int &round)
+        {
+            if (round >= 64)
+            {
+                const int step = round - 64 < 608 ? 1 + (round - 64) / 32 : 20;
+                std::this_thread::sleep_for(std::chrono::microseconds(50 * step));
+            }
+            else if (round >= 16)
+            {
+                std::this_thread::yield();
+            }
+            ++round;
+        }
+    } // namespace detail
+
+    template <class T>
+    std::int64_t push_wait(BoundedQueue<T> &q, T &v)
+    {
+        if (q.try_push(v))
+            return 0;
+        const auto t0 = std::chrono::steady_clock::now();
+        int round = 0;
+        do
+            detail::backoff(round);
+        while (!q.try_push(v));
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - t0).count();
+    }
+
+    template <class T>
+    std::int64_t pop_wait(BoundedQueue<T> &q, T &out)
+    {
+        if (q.try_pop(out))
+            return 0;
+        const auto t0 = std::chrono::steady_clock::now();
+        int round = 0;
+        do
+            detail::backoff(round);
+        while (!q.try_pop(out));
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - t0).count();
+    }
+
+} // namespace mce
@@ -0,0 +1,32 @@
+#pragma once
+#include <string>
+#include <vector>
+
+// Non-interactive entry point: `MCE_by_IV --input <path> [options]`.
+// Drives app::progress::process_and_report directly, no menus, no stdin.
+// `MCE_by_IV extract <pack.tar> ...` reads members back out of a debug pack;
+// `MCE_by_IV render-debug <results.csv> ...` redraws debug images from results.
+namespace app::cli
+{
+
+    // Process exit codes (stable; scripts and schedulers rely on them)
+    enum ExitCode : int
+    {
+        kOk = 0,          // every image was decoded and processed
+        kPartial = 1,     // batch ran, but some images could not be read
+        kUsage = 2,       // bad or missing arguments
+        kNoInput = 3,     // input path/manifest missing or no images found
+        kOutputError = 4, // output root or results file could not be created
+    };
+
+    // True when argv asks for headless mode (any argument at all).
+    bool wants_headless(int argc, char **argv);
+
+    // Parse args, run the batch, return an ExitCode.
+    int run(int argc, char **argv);
+
+    // Read a manifest: one image path per line, '#' comments and blanks ignored.
+    // Relative entries are resolved against the manifest's directory.
+    bool read_manifest(const std::string &manifestPath, std::vector<std::string> &out);
+
+} // namespace app::cli
@@ -0,0 +1,59 @@
+#pragma once
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace mce::io
+{
+    // One member of a debug pack: data starts at `offset` in the tar
+    struct PackEntry
+    {
+        std::string name;
+        std::uint64_t offset = 0;
+        std::uint64_t size = 0;
+    };
+
+    // Append-only debug pack: a plain (ustar) tar, readable by any tar tool,
+    // plus "<pack>.idx" with one "<offset>\t<size>\t<name>" line per member
+    // so single artifacts can be read with one seek. Names longer than the
+    // 100-byte ustar field get a pax "path" record. append() is thread-safe.
+    class PackWriter
+    {
+    public:
+        explicit PackWriter(const std::string &path);
+        ~PackWriter(); // close()
+        PackWriter(const PackWriter &) = delete;
+        PackWriter &operator=(const PackWriter &) = delete;
+
+        bool ok() const { return ok_; }
+        const std::string &path() const { return path_; }
+
+        // False once any write has failed
+        bool append(const std::string &name, const std::vector<unsigned char> &data);
+
+        // Writes the end-of-archive blocks; later appends fail
+        void close();
+
+    private:
+        bool write_member(const std::string &name, char type, const char *data, std::uint64_t size);
+
+        std::string path_;
+        std::ofstream tar_, idx_;
+        std::uint64_t offset_ = 0;
+        bool ok_ = false, closed_ = false;
+        std::mutex m_;
+    };
+
+    // "<pack>#<member>": how CSV columns point into a pack
+    std::string pack_ref(const std::string &pack, const std::string &member);
+
+    // Members of `pack`, from its .idx when present, else by walking the tar
+    // headers. False when the pack cannot be read.
+    bool read_pack_index(const std::string &pack, std::vector<PackEntry> &entries);
+
+    // Bytes of one member
+    bool read_pack_member(const std::string &pack, const PackEntry &e, std::vector<char> &data);
+
+} // namespace mce::io
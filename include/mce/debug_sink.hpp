@@ -0,0 +1,89 @@
+#pragma once
+#include "mce/bounded_queue.hpp"
+#include "mce/debug_pack.hpp"
+
+#include <opencv2/core.hpp>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace mce
+{
+    // How debug artifacts are encoded
+    struct DebugEncoding
+    {
+        enum class Format
+        {
+            Png,
+            Jpeg
+        };
+        Format format = Format::Png;
+        int quality = -1; // PNG: compression level 0..9, JPEG: quality 1..100; -1 = codec default
+        int max_side = 0; // previews: downscale so the long side is at most this (0 = full size)
+
+        const char *extension() const { return format == Format::Jpeg ? ".jpg" : ".png"; }
+    };
+
+    // Background encoder pool for debug artifacts. submit() only queues the
+    // image (blocking while the queue is full); encoder threads downscale,
+    // encode and write it. The sink owns a submitted Mat: callers must not
+    // write to its buffer afterwards (move a buffer in, or pass a clone).
+    // With a pack path every artifact is appended to that one tar instead
+    // of being a file of its own.
+    class DebugSink
+    {
+    public:
+        DebugSink(int threads, DebugEncoding enc, std::size_t queueCapacity = 16,
+                  const std::string &packPath = {});
+        ~DebugSink(); // drains the queue, joins, then closes the pack
+        DebugSink(const DebugSink &) = delete;
+        DebugSink &operator=(const DebugSink &) = delete;
+
+        const DebugEncoding &encoding() const { return enc_; }
+        bool pack_ok() const { return !pack_ || pack_->ok(); }
+
+        // Downscale factor previews use for an image of `sz` (1 = full size)
+        double preview_scale(cv::Size sz) const;
+
+        // Queues `img` for "<stem><extension>" and returns that path (pack:
+        // "<pack>#<file name>", see io::pack_ref)
+        std::string submit(const std::string &stem, cv::Mat img);
+
+        // Blocks until every submitted image is written (woken by the
+        // encoder threads, no polling)
+        void flush();
+
+        struct Stats
+        {
+            std::uint64_t written = 0, failed = 0, bytes = 0;
+            double encode_ms = 0;  // encoder threads, summed
+            double blocked_ms = 0; // submit() waiting for queue room
+        };
+        Stats stats() const;
+
+    private:
+        struct Job
+        {
+            std::string path; // empty = stop
+            cv::Mat img;
+        };
+        void run();
+
+        DebugEncoding enc_;
+        std::unique_ptr<io::PackWriter> pack_;
+        BoundedQueue<Job> queue_;
+        std::vector<std::thread> threads_;
+        std::atomic<std::uint64_t> submitted_{0};
+        std::uint64_t done_ = 0; // guarded by doneMutex_
+        std::mutex doneMutex_;
+        std::condition_variable doneCv_; // notified when done_ reaches submitted_
+        std::atomic<std::uint64_t> written_{0}, failed_{0}, bytes_{0};
+        std::atomic<std::int64_t> encodeNs_{0}, blockedNs_{0};
+    };
+
+} // namespace mce
@@ -1,10 +1,15 @@
 #pragma once
 #include <opencv2/core.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
 #include <string>
 #include <vector>
 
 namespace mce
 {
+    class DebugSink;
+
     struct DetectOutput
     {
         // final decision
@@ -22,6 +27,27 @@ namespace mce
         double hue_score = 0.0;             // 0..1 richness of hues after warp
         bool line_ok = false;               // grid divisions detected after warp
         int Smin = 0, Vmin = 0, Vmax = 255; // adaptive HSV thresholds used
+        int scale_factor = 1;               // pyramid downscale used to locate (1 = full res)
+        bool tracked = false;               // found by the ROI search around a TrackPrior
+
+        // angle-sweep work (summed over pyramid re-runs)
+        int sweep_scored = 0;    // angles measured geometrically (phase 1)
+        int sweep_validated = 0; // warps + grid cascades run (phase 2 and fallback)
+        int sweep_skipped = 0;   // gated angles never warped (below top-K or after the first pass)
+        int angle_cache_lookups = 0; // per-image angle cache (coarse/fine overlap, fallback box)
+        int angle_cache_hits = 0;
+        int gate_rejected = 0;       // components rejected by the pre-sweep hue gate
+
+        // wall time per stage of this call, ms (steady clock; summed over pyramid re-runs)
+        struct StageTimes
+        {
+            double mask = 0;      // S/V histograms, band mask, morphology
+            double component = 0; // labeling, component mask, runs + outline
+            double sweep = 0;     // angle sweep phase 1 (geometry)
+            double validate = 0;  // phase 2 warps + grid cascade, fallback
+            double refine = 0;    // pyramid downscale + full-res refine
+            double debug_io = 0;  // debug artifact rendering + imwrite
+        } stage_ms;
 
         // debug artifact paths (written only when saveDebug=true)
         std::string debug_quad_path; // original image + green box + % text
@@ -33,9 +59,213 @@ namespace mce
         std::string debug_clip_path; // "<debugBase>_debug_clip.png"
     };
 
-    // Unified detection+coverage API
+    // Grid validators of the warp cascade, in their classic order
+    enum class Validator
+    {
+        LinePeaks,    // CLAHE + binarized projection peaks
+        ColorGrad,    // hue / V gradient projections
+        MaxGap,       // two strongest edge cuts near the thirds
+        KMeans,       // k-means color clusters, label transitions near the thirds
+        Palette,      // fixed hue-band palette labels, same transitions test
+        TemplateCorr, // correlation with an ideal 3×3 edge map
+    };
+    constexpr int kValidatorCount = 6;
+
+    // "linepeaks", "colorgrad", "maxgap", "kmeans", "palette", "template"
+    const char *validator_name(Validator v);
+
+    // "adaptive" → empty; "fixed" → classic order; else a comma list of names
+    bool parse_validator_order(const std::string &spec, std::vector<Validator> &order);
+
+    // Process-wide cascade statistics (every detector, every thread)
+    struct ValidatorStats
+    {
+        std::uint64_t runs = 0, passes = 0;
+        double total_ms = 0.0;
+    };
+    ValidatorStats validator_stats(Validator v);
+    void reset_validator_stats();
+
+    // Order an adaptive cascade uses right now: ascending mean cost / pass
+    // rate (smoothed), i.e. the lowest expected cost until the first pass
+    std::vector<Validator> adaptive_validator_order();
+
+    // Per-call knobs (defaults reproduce the classic behaviour)
+    struct DetectOptions
+    {
+        // Threads for the intra-image angle sweep (OpenMP builds only).
+        // 0 = OpenMP default; 1 = serial. Batch runners should pass
+        // cores / batch_workers so the two levels don't oversubscribe.
+        int scan_threads = 0;
+
+        // Pyramid mode: locate the component and angle on a power-of-two
+        // downscale (long side kept >= pyramid_min_side), then re-tighten
+        // the box at full resolution. If the refined coverage differs from
+        // the coarse one by more than pyramid_tolerance (percentage points),
+        // or nothing is found, the image is re-run at full resolution.
+        // The tolerance bounds refined vs. coarse only, not vs. a plain
+        // full-res run: the kept angle is the coarse one, so the two can
+        // differ by more (a few points on some images).
+        bool pyramid = false;
+        int pyramid_min_side = 1200;
+        double pyramid_tolerance = 1.0;
+
+        // The input is a 1/input_scale downscale of the original (reduced
+        // JPEG decode). Every gate is relative to the image except the
+        // component floor of 100 original pixels, which is divided by
+        // input_scale² (a pyramid level divides it further). Results stay
+        // in input pixels.
+        int input_scale = 1;
+
+        // Two-phase sweep: every angle is ranked on geometry alone, then only
+        // the best validate_top_k (0 = all) are warped and grid-validated, in
+        // rank order, stopping at the first pass. Rank = occupancy
+        // + rank_fill_weight * fill - rank_aspect_weight * (aspect - 1),
+        // where fill is the share of the tight box covered by the mask.
+        // Default all: rank order plus the early exit already bound the
+        // warps, and a cut-off loses markers whose best geometric angle
+        // ranks below it (example/8.png first passes at rank 14 of 32).
+        int validate_top_k = 0;
+        double rank_fill_weight = 0.5;
+        double rank_aspect_weight = 0.1;
+
+        // Validator cascade order. Empty = adaptive (see
+        // adaptive_validator_order, re-planned per image). Otherwise the
+        // listed validators run first, in that order, and the rest follow in
+        // classic order. line_ok is the OR of all validators, so the order
+        // changes the cost only, never the result.
+        std::vector<Validator> validator_order;
+
+        // Color-cluster validator: the original cv::kmeans path by default,
+        // or the palette labeler (only one of the two runs)
+        bool kmeans_validator = true;
+
+        // Pre-sweep gate: a component whose own pixels (its mask, not the
+        // bounding box) fill fewer than gate_min_hues hue bins (18 × 10°,
+        // S > 40) with at least gate_min_share × its area each is rejected
+        // before the sweep. Off by default (0); the final decision needs 3
+        // such bins on the warp (min_hue_score), so 3 is strict and 2 leaves
+        // a margin.
+        int gate_min_hues = 0;
+        double gate_min_share = 0.002;
+
+        // Multi-marker mode (Detector::detect_all): at most max_markers
+        // results per image; components not yet swept when multi_budget_ms
+        // (0 = no limit) has elapsed are skipped
+        int max_markers = 8;
+        double multi_budget_ms = 0.0;
+
+        // Tracking (detect with a TrackPrior): the ROI is the prior quad's
+        // bounding box grown by track_pad × its long side; the sweep covers
+        // ±track_angle_range degrees around the prior angle in 1° steps
+        double track_pad = 0.25;
+        int track_angle_range = 4;
+    };
+
+    // Previous frame's result, used to seed the next frame of a sequence
+    struct TrackPrior
+    {
+        bool valid = false;
+        std::vector<cv::Point2f> quad; // TL,TR,BR,BL
+        double angle = 0.0;            // best_angle_deg
+        int Smin = 0, Vmin = 0, Vmax = 255;
+    };
+
+    // Prior from a result (invalid when nothing was found)
+    TrackPrior track_prior(const DetectOutput &out);
+
+    // False for the color-cluster validator `opt` leaves out
+    bool validator_enabled(const DetectOptions &opt, Validator v);
+
+    // True when the library was built with MCE_ENABLE_OPENMP
+    bool angle_scan_is_parallel();
+
+    // Reusable detector: owns image-sized scratch (HSV, mask, labels, rotated
+    // masks, warps, validator buffers) and reuses it across calls, so a warm
+    // detector does not allocate for same-sized inputs. Not thread-safe: use
+    // one instance per thread.
+    class Detector
+    {
+    public:
+        explicit Detector(DetectOptions opt = {});
+        ~Detector();
+        Detector(Detector &&) noexcept;
+        Detector &operator=(Detector &&) noexcept;
+        Detector(const Detector &) = delete;
+        Detector &operator=(const Detector &) = delete;
+
+        void set_options(const DetectOptions &opt) { opt_ = opt; }
+        const DetectOptions &options() const { return opt_; }
+
+        // Same contract as detect_and_compute()
+        bool detect(const cv::Mat &bgr,
+                    DetectOutput &out,
+                    bool debug,
+                    bool saveDebug,
+                    const std::string &debugBase);
+
+        // Tracking: searches only a padded ROI around `prior` with its HSV
+        // thresholds and a narrow sweep around its angle (out.tracked). If
+        // that fails validation, or the marker has left the ROI, falls back
+        // to a full detect(). An invalid prior is a plain detect().
+        bool detect(const cv::Mat &bgr,
+                    const TrackPrior &prior,
+                    DetectOutput &out,
+                    bool debug,
+                    bool saveDebug,
+                    const std::string &debugBase);
+
+        // Multi-marker mode: one entry per validated component (best
+        // component score first), or a single not-found entry. In OpenMP
+        // builds components are swept in parallel, one per sweep thread;
+        // otherwise one after another. Pyramid is ignored.
+        // Marker k's artifacts use "<debugBase>_m<k>"; mask/labeling work
+        // is charged to the first entry.
+        bool detect_all(const cv::Mat &bgr,
+                        std::vector<DetectOutput> &outs,
+                        bool debug,
+                        bool saveDebug,
+                        const std::string &debugBase);
+
+        // Artifacts for a finished result, for callers that decide per image
+        // once the result is known (capture policies): "<maskBase>_debug_mask"
+        // re-built at full resolution from out's thresholds (skipped when
+        // maskBase is empty) and, for a found marker, quad/crop/clip from
+        // out.quad under markerBase. No warp: that only exists during the
+        // sweep. Sets out's debug paths.
+        void render_debug(const cv::Mat &bgr, DetectOutput &out,
+                          const std::string &maskBase, const std::string &markerBase);
+
+        // Debug artifacts go to `sink` (queued, encoded by its threads)
+        // instead of being written with imwrite inside the call; paths in
+        // DetectOutput then carry the sink's extension. nullptr = in-call
+        // PNG writes. The sink must outlive the detector's calls.
+        void set_debug_sink(DebugSink *sink);
+
+        // Buffers allocated so far for workspace Mats (monotonic). Stays flat
+        // once warm; OpenCV-internal temporaries are not included. The sweep
+        // keeps its vectors in the workspace too, so a warm detect() on a
+        // reused DetectOutput makes no heap allocation of its own (without
+        // debug output; see tests/detector_alloc_test.cpp).
+        std::size_t workspace_allocations() const;
+
+        struct Workspace;
+
+    private:
+        DetectOptions opt_;
+        std::unique_ptr<Workspace> ws_;
+    };
+
+    // Unified detection+coverage API (uses a per-thread Detector)
+    bool detect_and_compute(const cv::Mat &bgr,
+                            DetectOutput &out,
+                            bool debug,
+                            bool saveDebug,
+                            const std::string &debugBase);
+
     bool detect_and_compute(const cv::Mat &bgr,
                             DetectOutput &out,
+                            const DetectOptions &opt,
                             bool debug,
                             bool saveDebug,
                             const std::string &debugBase);
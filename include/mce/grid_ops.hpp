@@ -0,0 +1,36 @@
+#pragma once
+#include <opencv2/core.hpp>
+
+#include <vector>
+
+namespace mce::grid
+{
+    // Primitives of the grid validators, kept out of the detector's
+    // anonymous namespace so the tests can check them against the reference
+    // code they replaced.
+
+    // Pair (a, b), b >= a + minsep, maximizing p[a] + p[b] in O(n): suf[k]
+    // is the first index of the maximum of p[k..n) (caller-owned scratch).
+    // Picks the same pair as the exhaustive i<j scan (first i, then first j,
+    // on ties). False (a = b = -1) when no pair fits.
+    bool best_cut_pair(const std::vector<float> &p, int minsep, int &a, int &b, std::vector<int> &suf);
+
+    // Ideal 3×3 edge map of one size plus the sums the correlation needs
+    struct GridTemplate
+    {
+        cv::Mat t;         // CV_32F, lines at 1/3 and 2/3
+        double sum = 0;    // Σ t
+        double centSq = 0; // Σ (t - mean)²
+    };
+
+    // Draws the template for `size` into gt.t (grid lines at 1/3 and 2/3,
+    // thickness 2, anti-aliased) and caches its sums
+    void make_grid_template(cv::Size size, GridTemplate &gt);
+
+    // matchTemplate(mag, gt.t, TM_CCOEFF_NORMED) for a CV_32F `mag` of the
+    // template's size, where the result is a single value:
+    // Σ(t−t̄)(m−m̄) / sqrt(Σ(t−t̄)² Σ(m−m̄)²), in one pass over mag. 0 when
+    // mag is constant (zero variance), as matchTemplate reports.
+    double template_corr(const cv::Mat &mag, const GridTemplate &gt);
+
+} // namespace mce::grid
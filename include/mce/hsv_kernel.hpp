@@ -0,0 +1,51 @@
+#pragma once
+#include <opencv2/core.hpp>
+
+namespace mce::hsv
+{
+    // Fused BGR → HSV classification for the color mask. Reads BGR directly
+    // (no HSV image, no split) and reproduces OpenCV's 8-bit BGR2HSV exactly
+    // (H in [0,180], S and V in [0,255]), so results match cvtColor+inRange.
+
+    enum class Isa
+    {
+        Scalar, // reference implementation
+        SSE41,
+        AVX2,
+        NEON
+    };
+
+    // Best ISA supported by this CPU. MCE_HSV_ISA=scalar|sse41|avx2|neon
+    // forces a lower tier (unsupported requests fall back to the best one).
+    Isa active_isa();
+    const char *isa_name(Isa isa);
+
+    // Pass 1: S and V histograms of a CV_8UC3 BGR image (ROI views allowed)
+    struct SVHist
+    {
+        int s[256];
+        int v[256];
+    };
+    void sv_histograms(const cv::Mat &bgr, SVHist &h, Isa isa = active_isa());
+
+    // Percentile (0..100) of a 256-bin histogram holding `total` samples
+    int percentile(const int hist[256], int total, double p01_99);
+
+    // S/V limits plus up to kMaxHueRanges merged hue intervals (inclusive)
+    struct BandSpec
+    {
+        static constexpr int kMaxHueRanges = 8;
+        int smin = 0, vmin = 0, vmax = 255;
+        int nHue = 0;
+        int hueLo[kMaxHueRanges] = {};
+        int hueHi[kMaxHueRanges] = {};
+    };
+
+    // Adds [lo, hi] to spec, merging with overlapping or adjacent ranges
+    void add_hue_range(BandSpec &spec, int lo, int hi);
+
+    // Pass 2: 255 where (H,S,V) falls in the spec, else 0. `mask` is created
+    // as CV_8U of bgr.size() (an existing buffer/view of that size is reused).
+    void band_mask(const cv::Mat &bgr, const BandSpec &spec, cv::Mat &mask, Isa isa = active_isa());
+
+} // namespace mce::hsv
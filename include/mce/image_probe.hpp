@@ -0,0 +1,33 @@
+#pragma once
+#include <opencv2/core.hpp>
+#include <string>
+
+namespace mce::io
+{
+    enum class ImageFormat
+    {
+        Unknown,
+        Jpeg,
+        Png
+    };
+
+    // Stored dimensions (before any EXIF rotation)
+    struct ImageInfo
+    {
+        ImageFormat format = ImageFormat::Unknown;
+        int width = 0, height = 0;
+    };
+
+    // Reads only the file header (JPEG SOFn / PNG IHDR). False when the
+    // format is not recognized or the header is truncated.
+    bool probe_image(const std::string &path, ImageInfo &info);
+
+    // Largest reduced-decode factor (1, 2, 4 or 8) that still leaves at least
+    // budgetPixels. Only JPEGs qualify (libjpeg scales during the IDCT; other
+    // codecs would decode at full size first); budgetPixels <= 0 = off.
+    int reduced_decode_factor(const ImageInfo &info, long long budgetPixels);
+
+    // cv::imread with IMREAD_REDUCED_COLOR_<factor> (IMREAD_COLOR for 1)
+    cv::Mat imread_reduced(const std::string &path, int factor);
+
+} // namespace mce::io
@@ -1,5 +1,7 @@
 #pragma once
 #include <iostream>
+#include <mutex>
+#include <sstream>
 #include <string>
 
 namespace mce::log
@@ -13,12 +15,45 @@ namespace mce::log
         g_save_debug = save_debug;
     }
 
+    // Whole lines only: batch workers log concurrently, so each line is
+    // built first and written in one piece under this lock
+    inline std::mutex g_line_mutex;
+
+    inline void line(const char *tag, const std::string &msg)
+    {
+        const std::string text = std::string(tag) + " " + msg + "\n";
+        std::lock_guard<std::mutex> lock(g_line_mutex);
+        std::cerr << text;
+    }
+
     inline void d(const std::string &msg)
     {
         if (g_debug)
-            std::cerr << "[DBG] " << msg << "\n";
+            line("[DBG]", msg);
     }
-    inline void i(const std::string &msg) { std::cerr << "[INF] " << msg << "\n"; }
-    inline void w(const std::string &msg) { std::cerr << "[WRN] " << msg << "\n"; }
-    inline void e(const std::string &msg) { std::cerr << "[ERR] " << msg << "\n"; }
+    inline void i(const std::string &msg) { line("[INF]", msg); }
+    inline void w(const std::string &msg) { line("[WRN]", msg); }
+    inline void e(const std::string &msg) { line("[ERR]", msg); }
+
+    // Streams one debug line into a local buffer and writes it on
+    // destruction, regardless of g_debug (the detector has its own flag):
+    //   if (debug) log::Debug() << "compFrac=" << f;
+    class Debug
+    {
+    public:
+        Debug() = default;
+        Debug(const Debug &) = delete;
+        Debug &operator=(const Debug &) = delete;
+        ~Debug() { line("[DBG]", buf_.str()); }
+
+        template <class T>
+        Debug &operator<<(const T &v)
+        {
+            buf_ << v;
+            return *this;
+        }
+
+    private:
+        std::ostringstream buf_;
+    };
 }
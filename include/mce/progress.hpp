@@ -6,11 +6,47 @@
 namespace app::progress
 {
 
+    // Batch totals returned to the caller (the CLI turns these into exit codes).
+    struct BatchSummary
+    {
+        int total = 0;      // images requested
+        int found = 0;      // images with a valid marker
+        int readFailed = 0; // images that could not be decoded
+        bool outputOk = true; // results file could be created
+        long long run_ms = 0;
+        std::string resultsPath;
+    };
+
     // Run detection, print to console, and save outputs neatly.
-    // Default root is ./mce_output (inside the container), override with env MCE_OUTPUT_ROOT.
-    // - CSV:   <root>/results/<YYYYMMDD-HHMMSS>.csv
+    // Default root is ./mce_output (inside the container), override with env MCE_OUTPUT_ROOT
+    // or State::outputRoot.
+    // - Results: <root>/results/<YYYYMMDD-HHMMSS>.csv (.jsonl / .mcec per State::format)
     // - Debug: <root>/debug/<YYYYMMDD-HHMMSS>/<index>_<name>_{quad,warp,mask}.png
-    void process_and_report(const std::vector<std::string> &images,
-                            const app::State &state);
+    BatchSummary process_and_report(const std::vector<std::string> &images,
+                                    const app::State &state);
+
+    // Lazy debug rendering (`MCE_by_IV render-debug`): which rows of a
+    // results file to redraw, and where
+    struct RenderRequest
+    {
+        std::vector<int> indices; // image indices; empty = every row
+        bool failuresOnly = false; // only rows with found = 0
+        std::string outDir;        // empty = <root>/debug/<results stem>/ next to results/
+    };
+
+    struct RenderSummary
+    {
+        int rows = 0;       // rows selected
+        int rendered = 0;   // rows whose artifacts were written
+        int readFailed = 0; // source images that could not be read
+        bool inputOk = true; // results file readable and recognized
+    };
+
+    // Re-creates mask/quad/crop/clip for selected rows of a .csv or .mcec
+    // results file from the source image and the row's thresholds and quad,
+    // encoded per state's --debug-format, -quality, -preview and -writers.
+    // Prints each written path.
+    RenderSummary render_debug_from_results(const std::string &resultsPath, const RenderRequest &req,
+                                            const app::State &state);
 
 } // namespace app::progress
@@ -0,0 +1,130 @@
+#pragma once
+#include "mce/detect_and_compute.hpp"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace mce::io
+{
+    // One results row: a marker of an image, or the image itself when it
+    // has none (unreadable, or nothing found)
+    struct ResultRow
+    {
+        int index = 0; // 1-based position in the input list
+        std::string_view path;
+        bool read_ok = false;
+        const DetectOutput *out = nullptr; // the marker's result (image result when marker == 0)
+        int marker = 0;                    // 1-based; 0 = no marker on this row
+        bool multi = false;                // --multi run: the marker column is written (empty otherwise)
+        long long elapsed_ms = 0;          // decode + detect
+        double decode_ms = 0, detect_ms = 0, write_ms = 0;
+        int image_markers = 0, image_percent = 0;
+        bool tracked = false;
+        int decode_scale = 1;
+        std::string_view debug_policy;
+    };
+
+    enum class ResultType : std::uint8_t
+    {
+        Int,   // int64
+        Real,  // float64, written with `precision` decimals in text formats
+        Bool,  // 0/1
+        Text,  // UTF-8
+        Points // 4 × (x, y) float32: quad TL,TR,BR,BL
+    };
+
+    struct ResultValue
+    {
+        bool null = true;
+        long long i = 0;                  // Int, Bool
+        double d = 0;                     // Real
+        std::string_view s;               // Text
+        const cv::Point2f *pts = nullptr; // Points
+    };
+
+    // The results schema, in output order. Every writer renders these
+    // columns, so formats cannot drift apart or lose a column on some rows.
+    struct ResultColumn
+    {
+        const char *name;
+        ResultType type;
+        int precision; // Real only
+        ResultValue (*get)(const ResultRow &);
+    };
+    const std::vector<ResultColumn> &result_schema();
+
+    // Streaming results writer; rows arrive in output order
+    class ResultSink
+    {
+    public:
+        virtual ~ResultSink() = default;
+        virtual bool ok() const = 0; // file open and every write so far succeeded
+        virtual void write(const ResultRow &row) = 0;
+        virtual bool finish() = 0;   // flushes and closes; false on any write error
+        const std::string &path() const { return path_; }
+
+    protected:
+        std::string path_;
+    };
+
+    // True for "csv", "jsonl" and "columnar"
+    bool result_format_known(const std::string &format);
+
+    // Sink writing "<stem>.csv", ".jsonl" or ".mcec"; check ok() before use
+    std::unique_ptr<ResultSink> make_result_sink(const std::string &format, const std::string &stem);
+
+    // Memory-mapped reader for the columnar (.mcec) format. Layout, all
+    // little-endian, every section 8-byte aligned:
+    //   header  "MCECOL1\0", u32 columns, u32 0, per column {u8 type, u8 0,
+    //           u16 name length, name}
+    //   groups  u32 rows, u32 0, then per column a validity bitmap (bit r =
+    //           not null) and the values: i64 / f64 / u8 / u32 offsets[rows+1]
+    //           + bytes / f32[8] per row
+    //   footer  u64 group offsets[groups], u64 groups, u64 rows, "MCECEND\0"
+    class ColumnarReader
+    {
+    public:
+        ColumnarReader() = default;
+        ~ColumnarReader();
+        ColumnarReader(const ColumnarReader &) = delete;
+        ColumnarReader &operator=(const ColumnarReader &) = delete;
+
+        // Maps the file and checks its framing; false when it is not a
+        // complete .mcec file
+        bool open(const std::string &path);
+
+        std::size_t rows() const { return rows_; }
+        std::size_t columns() const { return names_.size(); }
+        const std::string &name(int c) const { return names_[c]; }
+        ResultType type(int c) const { return types_[c]; }
+        int column(std::string_view name) const; // -1 when absent
+
+        bool valid(int c, std::size_t r) const;
+        long long integer(int c, std::size_t r) const; // Int, Bool
+        double real(int c, std::size_t r) const;
+        std::string_view text(int c, std::size_t r) const; // empty when the offsets are corrupt
+        const float *points(int c, std::size_t r) const; // 8 floats
+
+    private:
+        struct Group
+        {
+            std::size_t first = 0, rows = 0;
+            std::vector<const std::uint8_t *> validity, data;
+            std::vector<std::size_t> textBytes; // Text: string bytes (last offset), checked against the file
+        };
+        const Group &locate(std::size_t r, std::size_t &local) const;
+        void close();
+
+        const std::uint8_t *base_ = nullptr;
+        std::size_t size_ = 0;
+        void *mapping_ = nullptr; // Windows file-mapping handle
+        std::size_t rows_ = 0;
+        std::vector<std::string> names_;
+        std::vector<ResultType> types_;
+        std::vector<Group> groups_;
+    };
+
+} // namespace mce::io
@@ -0,0 +1,699 @@
+#include "mce/cli.hpp"
+#include "mce/app.hpp"
+#include "mce/ui.hpp"
+#include "mce/progress.hpp"
+#include "mce/debug_pack.hpp"
+#include "mce/detect_and_compute.hpp"
+#include "mce/result_sink.hpp"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+    const char *kUsageText = R"USAGE(Usage:
+  MCE_by_IV                         Interactive TUI (no arguments)
+  MCE_by_IV --input <path> [options]
+  MCE_by_IV --manifest <file> [options]
+  MCE_by_IV extract <pack.tar> [member...] [-o <dir>]
+                                    List a debug pack, or copy members out of it
+                                    (a CSV reference <pack.tar>#<member> also works)
+  MCE_by_IV render-debug <results.csv|.mcec> [--index <i,j,...>] [--failures] [-o <dir>]
+                                    Redraw debug images later from a results file (quad and
+                                    thresholds columns + the source images); takes the
+                                    --debug-format/-quality/-preview/-writers options
+
+Input (exactly one):
+  -i, --input <path>        Image file or folder (recursive .png/.jpg/.jpeg)
+  -m, --manifest <file>     Text file with one image path per line ('#' = comment)
+
+Options:
+  -o, --output <dir>        Output root (default: $MCE_OUTPUT_ROOT or ./mce_output)
+  -j, --threads <n>         Batch worker threads (0 = one per core, 1 = serial)
+      --scan-threads <n>    Angle-sweep threads per image, OpenMP builds (0 = cores / workers)
+      --readers <n>         Decode threads feeding the workers (default 1)
+  -f, --format <fmt>        Results format: csv (default), jsonl or columnar (.mcec)
+      --decode-budget <MP>  Decode large JPEGs at 1/2, 1/4 or 1/8 scale, keeping at least <MP>
+                            megapixels (default 0 = full resolution)
+      --pyramid             Locate on a downscaled copy of large images, refine at full res
+      --pyramid-tol <pct>   Max coverage drift vs. the coarse pass before a full-res re-run (default 1.0)
+      --top-k <n>           Best-ranked sweep angles to grid-validate per image (default 0 = all)
+      --validators <order>  Cascade order: adaptive (default), fixed, or a comma list of
+                            linepeaks,colorgrad,maxgap,kmeans,palette,template (rest follow)
+      --color-validator <v> Color-cluster validator: kmeans (default) or palette
+      --gate <n>            Pre-sweep gate: hue bins a component needs before the angle sweep
+                            (default 0 = off, 2 = lenient, 3 = strict)
+      --multi               Report every validated marker per image (one CSV row each)
+      --max-markers <n>     Multi-marker: markers per image (default 8)
+      --multi-budget <ms>   Multi-marker: stop starting new components after <ms> (default 0 = none)
+      --sequence <order>    Treat each folder as a frame sequence ordered by name or mtime;
+                            each frame searches around the previous frame's marker first
+      --track-pad <frac>    Sequence: search ROI pad, fraction of the previous box (default 0.25)
+      --debug               Print detector debug logs
+      --save-debug          Write debug overlays under <root>/debug/<timestamp>/
+      --debug-format <fmt>  Debug image encoding: png (default) or jpg
+      --debug-quality <n>   PNG compression 0..9 or JPEG quality 1..100 (default: codec default)
+      --debug-preview <px>  Downscale debug images to <px> on the long side (default 0 = full size)
+      --debug-writers <n>   Background threads encoding debug images (default 2)
+      --debug-pack          Write all debug images into one <root>/debug/<timestamp>.tar with
+                            an offset index (.tar.idx); implies --save-debug
+      --debug-failures      Capture debug images only for images without a marker
+      --debug-every <n>     ... and/or for every <n>th input
+      --debug-slow <ms>     ... and/or when detection took longer than <ms>
+      --debug-coverage <lo>:<hi>
+                            ... and/or when a marker's coverage is outside lo..hi percent
+                            (any of these implies --save-debug; without them every image is captured)
+  -q, --quiet               Only print the final summary
+  -h, --help                Show this help
+
+Exit codes:
+  0 all images processed   1 some images unreadable   2 usage error
+  3 no input / no images   4 output could not be written
+)USAGE";
+
+    struct Args
+    {
+        std::string input;
+        std::string manifest;
+        bool help = false;
+    };
+
+    bool parse_int(const std::string &s, int &v)
+    {
+        try
+        {
+            std::size_t used = 0;
+            v = std::stoi(s, &used);
+            return used == s.size();
+        }
+        catch (...)
+        {
+            return false;
+        }
+    }
+
+    bool parse_double(const std::string &s, double &v)
+    {
+        try
+        {
+            std::size_t used = 0;
+            v = std::stod(s, &used);
+            return used == s.size();
+        }
+        catch (...)
+        {
+            return false;
+        }
+    }
+
+    // --debug-format/-quality/-preview/-writers: shared by the batch and
+    // render-debug
+    bool is_debug_encoding_option(const std::string &arg)
+    {
+        return arg == "--debug-format" || arg == "--debug-quality" || arg == "--debug-preview" ||
+               arg == "--debug-writers";
+    }
+
+    bool parse_debug_encoding(const std::string &arg, const std::string &v, app::State &s)
+    {
+        if (arg == "--debug-format")
+        {
+            s.debugFormat = v == "jpeg" ? "jpg" : v;
+            if (s.debugFormat != "png" && s.debugFormat != "jpg")
+            {
+                std::cerr << "[ERR] --debug-format expects png or jpg, got '" << v << "'\n";
+                return false;
+            }
+        }
+        else if (arg == "--debug-quality")
+        {
+            if (!parse_int(v, s.debugQuality) || s.debugQuality < 0 || s.debugQuality > 100)
+            {
+                std::cerr << "[ERR] --debug-quality expects 0..100, got '" << v << "'\n";
+                return false;
+            }
+        }
+        else if (arg == "--debug-preview")
+        {
+            if (!parse_int(v, s.debugPreview) || s.debugPreview < 0)
+            {
+                std::cerr << "[ERR] --debug-preview expects a non-negative pixel count, got '" << v << "'\n";
+                return false;
+            }
+        }
+        else if (!parse_int(v, s.debugWriters) || s.debugWriters < 1) // --debug-writers
+        {
+            std::cerr << "[ERR] --debug-writers expects a positive integer, got '" << v << "'\n";
+            return false;
+        }
+        return true;
+    }
+
+    // Quality range depends on the format, so it is checked after parsing
+    bool check_debug_encoding(const app::State &s)
+    {
+        if (s.debugFormat == "png" && s.debugQuality > 9)
+        {
+            std::cerr << "[ERR] --debug-quality for png is a compression level 0..9\n";
+            return false;
+        }
+        if (s.debugFormat == "jpg" && s.debugQuality == 0)
+        {
+            std::cerr << "[ERR] --debug-quality for jpg is 1..100\n";
+            return false;
+        }
+        return true;
+    }
+
+    // Returns false (and prints why) on any malformed argument.
+    bool parse_args(int argc, char **argv, Args &a, app::State &s)
+    {
+        for (int k = 1; k < argc; ++k)
+        {
+            const std::string arg = argv[k];
+            auto value = [&](std::string &dst) -> bool
+            {
+                if (k + 1 >= argc)
+                {
+                    std::cerr << "[ERR] Missing value for " << arg << "\n";
+                    return false;
+                }
+                dst = argv[++k];
+                return true;
+            };
+
+            if (arg == "-h" || arg == "--help")
+                a.help = true;
+            else if (arg == "-i" || arg == "--input")
+            {
+                if (!value(a.input))
+                    return false;
+            }
+            else if (arg == "-m" || arg == "--manifest")
+            {
+                if (!value(a.manifest))
+                    return false;
+            }
+            else if (arg == "-o" || arg == "--output")
+            {
+                if (!value(s.outputRoot))
+                    return false;
+            }
+            else if (arg == "-j" || arg == "--threads")
+            {
+                std::string v;
+                if (!value(v))
+                    return false;
+                if (!parse_int(v, s.threads) || s.threads < 0)
+                {
+                    std::cerr << "[ERR] --threads expects a non-negative integer, got '" << v << "'\n";
+                    return false;
+                }
+            }
+            else if (arg == "--scan-threads")
+            {
+                std::string v;
+                if (!value(v))
+                    return false;
+                if (!parse_int(v, s.scanThreads) || s.scanThreads < 0)
+                {
+                    std::cerr << "[ERR] --scan-threads expects a non-negative integer, got '" << v << "'\n";
+                    return false;
+                }
+            }
+            else if (arg == "--readers")
+            {
+                std::string v;
+                if (!value(v))
+                    return false;
+                if (!parse_int(v, s.readers) || s.readers < 1)
+                {
+                    std::cerr << "[ERR] --readers expects a positive integer, got '" << v << "'\n";
+                    return false;
+                }
+            }
+            else if (arg == "-f" || arg == "--format")
+            {
+                if (!value(s.format))
+                    return false;
+                if (!mce::io::result_format_known(s.format))
+                {
+                    std::cerr << "[ERR] Unsupported format '" << s.format << "' (supported: csv, jsonl, columnar)\n";
+                    return false;
+                }
+            }
+            else if (arg == "--decode-budget")
+            {
+                std::string v;
+                if (!value(v))
+                    return false;
+                if (!parse_double(v, s.decodeBudgetMp) || s.decodeBudgetMp < 0.0)
+                {
+                    std::cerr << "[ERR] --decode-budget expects a non-negative number of megapixels, got '" << v << "'\n";
+                    return false;
+                }
+            }
+            else if (arg == "--pyramid")
+                s.pyramid = true;
+            else if (arg == "--pyramid-tol")
+            {
+                std::string v;
+                if (!value(v))
+                    return false;
+                if (!parse_double(v, s.pyramidTol) || s.pyramidTol < 0.0)
+                {
+                    std::cerr << "[ERR] --pyramid-tol expects a non-negative number, got '" << v << "'\n";
+                    return false;
+                }
+            }
+            else if (arg == "--top-k")
+            {
+                std::string v;
+                if (!value(v))
+                    return false;
+                if (!parse_int(v, s.validateTopK) || s.validateTopK < 0)
+                {
+                    std::cerr << "[ERR] --top-k expects a non-negative integer, got '" << v << "'\n";
+                    return false;
+                }
+            }
+            else if (arg == "--validators")
+            {
+                if (!value(s.validatorOrder))
+                    return false;
+                std::vector<mce::Validator> order;
+                if (!mce::parse_validator_order(s.validatorOrder, order))
+                {
+                    std::cerr << "[ERR] --validators expects adaptive, fixed or a list of "
+                                 "linepeaks,colorgrad,maxgap,kmeans,palette,template, got '"
+                              << s.validatorOrder << "'\n";
+                    return false;
+                }
+            }
+            else if (arg == "--color-validator")
+            {
+                std::string v;
+                if (!value(v))
+                    return false;
+                if (v != "palette" && v != "kmeans")
+                {
+                    std::cerr << "[ERR] --color-validator expects palette or kmeans, got '" << v << "'\n";
+                    return false;
+                }
+                s.kmeansValidator = (v == "kmeans");
+            }
+            else if (arg == "--gate")
+            {
+                std::string v;
+                if (!value(v))
+                    return false;
+                if (!parse_int(v, s.gateMinHues) || s.gateMinHues < 0 || s.gateMinHues > 18)
+                {
+                    std::cerr << "[ERR] --gate expects an integer in 0..18, got '" << v << "'\n";
+                    return false;
+                }
+            }
+            else if (arg == "--multi")
+                s.multiMarker = true;
+            else if (arg == "--max-markers")
+            {
+                std::string v;
+                if (!value(v))
+                    return false;
+                if (!parse_int(v, s.maxMarkers) || s.maxMarkers < 1)
+                {
+                    std::cerr << "[ERR] --max-markers expects a positive integer, got '" << v << "'\n";
+                    return false;
+                }
+            }
+            else if (arg == "--multi-budget")
+            {
+                std::string v;
+                if (!value(v))
+                    return false;
+                if (!parse_double(v, s.multiBudgetMs) || s.multiBudgetMs < 0.0)
+                {
+                    std::cerr << "[ERR] --multi-budget expects a non-negative number, got '" << v << "'\n";
+                    return false;
+                }
+            }
+            else if (arg == "--sequence")
+            {
+                if (!value(s.sequenceOrder))
+                    return false;
+                if (s.sequenceOrder != "name" && s.sequenceOrder != "mtime")
+                {
+                    std::cerr << "[ERR] --sequence expects name or mtime, got '" << s.sequenceOrder << "'\n";
+                    return false;
+                }
+                s.sequence = true;
+            }
+            else if (arg == "--track-pad")
+            {
+                std::string v;
+                if (!value(v))
+                    return false;
+                if (!parse_double(v, s.trackPad) || s.trackPad < 0.0)
+                {
+                    std::cerr << "[ERR] --track-pad expects a non-negative number, got '" << v << "'\n";
+                    return false;
+                }
+            }
+            else if (arg == "--debug")
+                s.debug = true;
+            else if (arg == "--save-debug")
+                s.saveDebug = true;
+            else if (is_debug_encoding_option(arg))
+            {
+                std::string v;
+                if (!value(v) || !parse_debug_encoding(arg, v, s))
+                    return false;
+            }
+            else if (arg == "--debug-pack")
+            {
+                s.debugPack = true;
+                s.saveDebug = true;
+            }
+            else if (arg == "--debug-failures")
+            {
+                s.debugFailures = true;
+                s.saveDebug = true;
+            }
+            else if (arg == "--debug-every")
+            {
+                std::string v;
+                if (!value(v))
+                    return false;
+                if (!parse_int(v, s.debugEvery) || s.debugEvery < 1)
+                {
+                    std::cerr << "[ERR] --debug-every expects a positive integer, got '" << v << "'\n";
+                    return false;
+                }
+                s.saveDebug = true;
+            }
+            else if (arg == "--debug-slow")
+            {
+                std::string v;
+                if (!value(v))
+                    return false;
+                if (!parse_double(v, s.debugSlowMs) || s.debugSlowMs <= 0.0)
+                {
+                    std::cerr << "[ERR] --debug-slow expects a positive number of ms, got '" << v << "'\n";
+                    return false;
+                }
+                s.saveDebug = true;
+            }
+            else if (arg == "--debug-coverage")
+            {
+                std::string v;
+                if (!value(v))
+                    return false;
+                const auto colon = v.find(':');
+                if (colon == std::string::npos || !parse_double(v.substr(0, colon), s.debugCoverageLo) ||
+                    !parse_double(v.substr(colon + 1), s.debugCoverageHi) || s.debugCoverageLo < 0.0 ||
+                    s.debugCoverageHi < s.debugCoverageLo)
+                {
+                    std::cerr << "[ERR] --debug-coverage expects <lo>:<hi> percent with 0 <= lo <= hi, got '" << v << "'\n";
+                    return false;
+                }
+                s.saveDebug = true;
+            }
+            else if (arg == "-q" || arg == "--quiet")
+                s.quiet = true;
+            else
+            {
+                std::cerr << "[ERR] Unknown argument: " << arg << "\n";
+                return false;
+            }
+        }
+
+        if (a.help)
+            return true;
+        if (s.sequence && s.multiMarker)
+        {
+            std::cerr << "[ERR] --sequence and --multi cannot be combined\n";
+            return false;
+        }
+        if (!check_debug_encoding(s))
+            return false;
+        if (a.input.empty() == a.manifest.empty())
+        {
+            std::cerr << "[ERR] Specify exactly one of --input or --manifest\n";
+            return false;
+        }
+        return true;
+    }
+
+} // namespace
+
+namespace app::cli
+{
+
+    bool wants_headless(int argc, char ** /*argv*/)
+    {
+        return argc > 1;
+    }
+
+    bool read_manifest(const std::string &manifestPath, std::vector<std::string> &out)
+    {
+        std::ifstream in(manifestPath);
+        if (!in)
+            return false;
+
+        const fs::path base = fs::absolute(fs::path(manifestPath)).parent_path();
+        std::string line;
+        while (std::getline(in, line))
+        {
+            line = ui::trim(line);
+            if (line.empty() || line[0] == '#')
+                continue;
+            fs::path p = ui::map_host_path_if_needed(line);
+            if (p.is_relative())
+                p = base / p;
+            out.push_back(p.lexically_normal().string());
+        }
+        return true;
+    }
+
+    namespace
+    {
+        // `extract <pack> [member...] [-o dir]`; no members = list the pack
+        int run_extract(int argc, char **argv)
+        {
+            std::string pack, outDir = ".";
+            std::vector<std::string> members;
+            for (int k = 2; k < argc; ++k)
+            {
+                const std::string arg = argv[k];
+                if (arg == "-o" || arg == "--output")
+                {
+                    if (k + 1 >= argc)
+                    {
+                        std::cerr << "[ERR] Missing value for " << arg << "\n";
+                        return kUsage;
+                    }
+                    outDir = argv[++k];
+                }
+                else if (pack.empty())
+                    pack = arg;
+                else
+                    members.push_back(arg);
+            }
+            if (pack.empty())
+            {
+                std::cerr << "[ERR] extract needs a pack file\n"
+                          << kUsageText;
+                return kUsage;
+            }
+            // CSV references are "<pack>#<member>"
+            const auto hash = pack.rfind('#');
+            if (hash != std::string::npos && !fs::exists(pack))
+            {
+                members.push_back(pack.substr(hash + 1));
+                pack.resize(hash);
+            }
+            for (std::string &m : members)
+                if (const auto h = m.rfind('#'); h != std::string::npos)
+                    m = m.substr(h + 1);
+
+            std::vector<mce::io::PackEntry> entries;
+            if (!mce::io::read_pack_index(pack, entries))
+            {
+                std::cerr << "[ERR] Cannot read debug pack: " << pack << "\n";
+                return kNoInput;
+            }
+            if (members.empty())
+            {
+                for (const mce::io::PackEntry &e : entries)
+                    std::cout << e.size << "\t" << e.name << "\n";
+                return kOk;
+            }
+
+            std::error_code ec;
+            fs::create_directories(outDir, ec);
+            int rc = kOk;
+            std::vector<char> data;
+            for (const std::string &m : members)
+            {
+                auto it = std::find_if(entries.rbegin(), entries.rend(), [&](const mce::io::PackEntry &e)
+                                       { return e.name == m; });
+                if (it == entries.rend())
+                {
+                    std::cerr << "[ERR] No member '" << m << "' in " << pack << "\n";
+                    rc = kNoInput;
+                    continue;
+                }
+                // Only the file name: a member never writes outside outDir
+                const fs::path dst = fs::path(outDir) / fs::path(m).filename();
+                std::ofstream f(dst, std::ios::binary);
+                if (!mce::io::read_pack_member(pack, *it, data) || !f ||
+                    !f.write(data.data(), (std::streamsize)data.size()))
+                {
+                    std::cerr << "[ERR] Cannot extract " << m << " to " << dst.string() << "\n";
+                    rc = kOutputError;
+                    continue;
+                }
+                std::cout << dst.string() << "\n";
+            }
+            return rc;
+        }
+
+        // `render-debug <results.csv> [--index i,j] [--failures] [-o dir] [encoding]`
+        int run_render_debug(int argc, char **argv)
+        {
+            std::string csvPath;
+            progress::RenderRequest req;
+            app::State s;
+            for (int k = 2; k < argc; ++k)
+            {
+                const std::string arg = argv[k];
+                const bool takesValue = arg == "-o" || arg == "--output" || arg == "--index" ||
+                                        is_debug_encoding_option(arg);
+                if (takesValue && k + 1 >= argc)
+                {
+                    std::cerr << "[ERR] Missing value for " << arg << "\n";
+                    return kUsage;
+                }
+                if (arg == "-o" || arg == "--output")
+                    req.outDir = argv[++k];
+                else if (arg == "--index")
+                {
+                    std::stringstream list(argv[++k]);
+                    std::string item;
+                    while (std::getline(list, item, ','))
+                    {
+                        int i = 0;
+                        if (!parse_int(item, i) || i < 1)
+                        {
+                            std::cerr << "[ERR] --index expects a comma list of image indices, got '" << item << "'\n";
+                            return kUsage;
+                        }
+                        req.indices.push_back(i);
+                    }
+                }
+                else if (arg == "--failures")
+                    req.failuresOnly = true;
+                else if (is_debug_encoding_option(arg))
+                {
+                    if (!parse_debug_encoding(arg, argv[++k], s))
+                        return kUsage;
+                }
+                else if (csvPath.empty() && arg[0] != '-')
+                    csvPath = arg;
+                else
+                {
+                    std::cerr << "[ERR] Unknown argument: " << arg << "\n";
+                    return kUsage;
+                }
+            }
+            if (csvPath.empty())
+            {
+                std::cerr << "[ERR] render-debug needs a results file\n"
+                          << kUsageText;
+                return kUsage;
+            }
+            if (!check_debug_encoding(s))
+                return kUsage;
+
+            const progress::RenderSummary sum = progress::render_debug_from_results(csvPath, req, s);
+            if (!sum.inputOk)
+                return kNoInput;
+            if (sum.rows == 0)
+            {
+                std::cerr << "[ERR] No matching rows in " << csvPath << "\n";
+                return kNoInput;
+            }
+            return sum.readFailed > 0 ? kPartial : kOk;
+        }
+    } // namespace
+
+    int run(int argc, char **argv)
+    {
+        if (argc > 1 && std::string(argv[1]) == "extract")
+            return run_extract(argc, argv);
+        if (argc > 1 && std::string(argv[1]) == "render-debug")
+            return run_render_debug(argc, argv);
+
+        Args a;
+        app::State s;
+        if (!parse_args(argc, argv, a, s))
+        {
+            std::cerr << kUsageText;
+            return kUsage;
+        }
+        if (a.help)
+        {
+            std::cout << kUsageText;
+            return kOk;
+        }
+
+        std::vector<std::string> images;
+        if (!a.manifest.empty())
+        {
+            if (!read_manifest(ui::map_host_path_if_needed(a.manifest), images))
+            {
+                std::cerr << "[ERR] Cannot read manifest: " << a.manifest << "\n";
+                return kNoInput;
+            }
+        }
+        else
+        {
+            if (!ui::validate_path(s, a.input))
+            {
+                std::cerr << "[ERR] Input path does not exist: " << a.input << "\n";
+                return kNoInput;
+            }
+            try
+            {
+                images = ui::collect_images(s.inputPath, s.isDirectory);
+            }
+            catch (const fs::filesystem_error &e)
+            {
+                std::cerr << "[ERR] Cannot scan input: " << e.what() << "\n";
+                return kNoInput;
+            }
+        }
+
+        if (images.empty())
+        {
+            std::cerr << "[ERR] No images to process\n";
+            return kNoInput;
+        }
+
+        const progress::BatchSummary sum = progress::process_and_report(images, s);
+        if (!sum.outputOk)
+        {
+            std::cerr << "[ERR] Cannot write results under: " << sum.resultsPath << "\n";
+            return kOutputError;
+        }
+        return sum.readFailed > 0 ? kPartial : kOk;
+    }
+
+} // namespace app::cli
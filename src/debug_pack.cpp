@@ -0,0 +1,208 @@
+// src/debug_pack.cpp — append-only tar pack for debug artifacts + offset index
+#include "mce/debug_pack.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <sstream>
+
+namespace mce::io
+{
+    namespace
+    {
+        constexpr std::uint64_t kBlock = 512;
+
+        std::uint64_t padded(std::uint64_t n) { return (n + kBlock - 1) / kBlock * kBlock; }
+
+        // Zero-padded octal in a fixed-width, NUL-terminated field
+        void put_octal(char *field, int width, std::uint64_t v)
+        {
+            std::snprintf(field, width, "%0*llo", width - 1, (unsigned long long)v);
+        }
+
+        std::uint64_t get_octal(const char *field, int width)
+        {
+            std::uint64_t v = 0;
+            for (int i = 0; i < width && field[i] >= '0' && field[i] <= '7'; ++i)
+                v = v * 8 + (std::uint64_t)(field[i] - '0');
+            return v;
+        }
+
+        // ustar header (name must fit the 100-byte field)
+        void make_header(char (&h)[kBlock], const std::string &name, char type, std::uint64_t size)
+        {
+            std::memset(h, 0, sizeof h);
+            std::memcpy(h, name.data(), std::min<std::size_t>(name.size(), 100));
+            put_octal(h + 100, 8, 0644);
+            put_octal(h + 108, 8, 0);
+            put_octal(h + 116, 8, 0);
+            put_octal(h + 124, 12, size);
+            put_octal(h + 136, 12, (std::uint64_t)std::time(nullptr));
+            h[156] = type;
+            std::memcpy(h + 257, "ustar", 6);
+            std::memcpy(h + 263, "00", 2);
+
+            // Checksum: byte sum with the checksum field read as spaces
+            std::memset(h + 148, ' ', 8);
+            unsigned sum = 0;
+            for (unsigned char c : h)
+                sum += c;
+            std::snprintf(h + 148, 8, "%06o", sum);
+            h[155] = ' ';
+        }
+
+        // pax record "<len> path=<name>\n", where <len> counts itself
+        std::string pax_path_record(const std::string &name)
+        {
+            const std::string body = " path=" + name + "\n";
+            std::size_t len = body.size() + 1;
+            while (std::to_string(len).size() + body.size() != len)
+                ++len;
+            return std::to_string(len) + body;
+        }
+
+        std::string pax_path(const std::string &records)
+        {
+            std::size_t pos = 0;
+            while (pos < records.size())
+            {
+                const std::size_t sp = records.find(' ', pos);
+                if (sp == std::string::npos)
+                    break;
+                const std::size_t len = std::strtoull(records.c_str() + pos, nullptr, 10);
+                if (len == 0 || pos + len > records.size())
+                    break;
+                const std::string kv = records.substr(sp + 1, pos + len - sp - 2); // minus '\n'
+                if (kv.compare(0, 5, "path=") == 0)
+                    return kv.substr(5);
+                pos += len;
+            }
+            return {};
+        }
+
+        // Walks the tar headers (no .idx)
+        bool scan_tar(const std::string &pack, std::vector<PackEntry> &entries)
+        {
+            std::ifstream f(pack, std::ios::binary);
+            if (!f)
+                return false;
+            std::uint64_t pos = 0;
+            std::string longName;
+            char h[kBlock];
+            while (f.read(h, kBlock))
+            {
+                if (std::all_of(h, h + kBlock, [](char c)
+                                { return c == 0; }))
+                    return true; // end-of-archive
+                const std::uint64_t size = get_octal(h + 124, 12);
+                const std::uint64_t data = pos + kBlock;
+                if (h[156] == 'x')
+                {
+                    std::string rec(size, '\0');
+                    if (!f.read(&rec[0], (std::streamsize)size))
+                        return false;
+                    longName = pax_path(rec);
+                }
+                else if (h[156] == '0' || h[156] == '\0')
+                {
+                    PackEntry e;
+                    e.name = longName.empty() ? std::string(h, strnlen(h, 100)) : longName;
+                    e.offset = data;
+                    e.size = size;
+                    entries.push_back(std::move(e));
+                    longName.clear();
+                }
+                pos = data + padded(size);
+                f.seekg((std::streamoff)pos);
+            }
+            return true; // truncated pack (run still writing): what is there
+        }
+    } // namespace
+
+    PackWriter::PackWriter(const std::string &path) : path_(path)
+    {
+        tar_.open(path, std::ios::binary | std::ios::trunc);
+        idx_.open(path + ".idx", std::ios::trunc);
+        ok_ = tar_.good() && idx_.good();
+    }
+
+    PackWriter::~PackWriter()
+    {
+        close();
+    }
+
+    bool PackWriter::write_member(const std::string &name, char type, const char *data, std::uint64_t size)
+    {
+        char h[kBlock];
+        make_header(h, name, type, size);
+        static const char zeros[kBlock] = {};
+        tar_.write(h, kBlock);
+        tar_.write(data, (std::streamsize)size);
+        tar_.write(zeros, (std::streamsize)(padded(size) - size));
+        offset_ += kBlock + padded(size);
+        return tar_.good();
+    }
+
+    bool PackWriter::append(const std::string &name, const std::vector<unsigned char> &data)
+    {
+        std::lock_guard<std::mutex> lock(m_);
+        if (!ok_ || closed_)
+            return false;
+        if (name.size() > 100)
+        {
+            const std::string rec = pax_path_record(name);
+            ok_ = write_member("PaxHeader/" + name.substr(name.size() - 90), 'x', rec.data(), rec.size());
+        }
+        const std::uint64_t dataOffset = offset_ + kBlock;
+        ok_ = ok_ && write_member(name, '0', (const char *)data.data(), data.size());
+        idx_ << dataOffset << '\t' << data.size() << '\t' << name << '\n';
+        ok_ = ok_ && idx_.good();
+        return ok_;
+    }
+
+    void PackWriter::close()
+    {
+        std::lock_guard<std::mutex> lock(m_);
+        if (closed_)
+            return;
+        closed_ = true;
+        static const char zeros[2 * kBlock] = {};
+        tar_.write(zeros, sizeof zeros);
+        tar_.close();
+        idx_.close();
+    }
+
+    std::string pack_ref(const std::string &pack, const std::string &member)
+    {
+        return pack + "#" + member;
+    }
+
+    bool read_pack_index(const std::string &pack, std::vector<PackEntry> &entries)
+    {
+        entries.clear();
+        std::ifstream idx(pack + ".idx");
+        if (!idx)
+            return scan_tar(pack, entries);
+        std::string line;
+        while (std::getline(idx, line))
+        {
+            std::istringstream ls(line);
+            PackEntry e;
+            if (!(ls >> e.offset >> e.size) || ls.get() != '\t' || !std::getline(ls, e.name))
+                return false;
+            entries.push_back(std::move(e));
+        }
+        return true;
+    }
+
+    bool read_pack_member(const std::string &pack, const PackEntry &e, std::vector<char> &data)
+    {
+        std::ifstream f(pack, std::ios::binary);
+        if (!f || !f.seekg((std::streamoff)e.offset))
+            return false;
+        data.resize(e.size);
+        return (bool)f.read(data.data(), (std::streamsize)e.size);
+    }
+
+} // namespace mce::io
@@ -0,0 +1,134 @@
+// src/debug_sink.cpp — background encoder pool for debug artifacts
+#include "mce/debug_sink.hpp"
+#include "mce/log.hpp"
+
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/imgproc.hpp>
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+
+namespace mce
+{
+    DebugSink::DebugSink(int threads, DebugEncoding enc, std::size_t queueCapacity, const std::string &packPath)
+        : enc_(enc), queue_(queueCapacity)
+    {
+        if (!packPath.empty())
+            pack_ = std::make_unique<io::PackWriter>(packPath);
+        const int n = std::max(1, threads);
+        threads_.reserve(n);
+        for (int i = 0; i < n; ++i)
+            threads_.emplace_back([this]
+                                  { run(); });
+    }
+
+    DebugSink::~DebugSink()
+    {
+        for (std::size_t i = 0; i < threads_.size(); ++i)
+        {
+            Job stop;
+            push_wait(queue_, stop);
+        }
+        for (auto &t : threads_)
+            t.join();
+    }
+
+    double DebugSink::preview_scale(cv::Size sz) const
+    {
+        const int longSide = std::max(sz.width, sz.height);
+        if (enc_.max_side <= 0 || longSide <= enc_.max_side)
+            return 1.0;
+        return (double)enc_.max_side / longSide;
+    }
+
+    std::string DebugSink::submit(const std::string &stem, cv::Mat img)
+    {
+        Job job{stem + enc_.extension(), std::move(img)};
+        if (pack_)
+            job.path = std::filesystem::path(job.path).filename().string();
+        std::string path = pack_ ? io::pack_ref(pack_->path(), job.path) : job.path;
+        submitted_.fetch_add(1, std::memory_order_relaxed);
+        blockedNs_ += push_wait(queue_, job);
+        return path;
+    }
+
+    void DebugSink::flush()
+    {
+        std::unique_lock<std::mutex> lock(doneMutex_);
+        doneCv_.wait(lock, [this]
+                     { return done_ >= submitted_.load(std::memory_order_relaxed); });
+    }
+
+    DebugSink::Stats DebugSink::stats() const
+    {
+        Stats s;
+        s.written = written_.load();
+        s.failed = failed_.load();
+        s.bytes = bytes_.load();
+        s.encode_ms = encodeNs_.load() / 1e6;
+        s.blocked_ms = blockedNs_.load() / 1e6;
+        return s;
+    }
+
+    void DebugSink::run()
+    {
+        std::vector<int> params;
+        if (enc_.quality >= 0)
+            params = {enc_.format == DebugEncoding::Format::Jpeg ? cv::IMWRITE_JPEG_QUALITY : cv::IMWRITE_PNG_COMPRESSION,
+                      enc_.quality};
+        std::vector<uchar> buf;
+        cv::Mat small;
+        for (;;)
+        {
+            Job job;
+            pop_wait(queue_, job);
+            if (job.path.empty())
+                return;
+
+            const auto t0 = std::chrono::steady_clock::now();
+            const cv::Mat *img = &job.img;
+            const double s = preview_scale(job.img.size());
+            if (s < 1.0)
+            {
+                cv::resize(job.img, small, cv::Size(), s, s, cv::INTER_AREA);
+                img = &small;
+            }
+            bool ok = false;
+            try
+            {
+                ok = cv::imencode(enc_.extension(), *img, buf, params);
+                if (ok && pack_)
+                {
+                    ok = pack_->append(job.path, buf);
+                }
+                else if (ok)
+                {
+                    std::ofstream f(job.path, std::ios::binary);
+                    ok = (bool)f.write((const char *)buf.data(), (std::streamsize)buf.size());
+                }
+            }
+            catch (const std::exception &e)
+            {
+                log::e("debug write failed for " + job.path + ": " + e.what());
+            }
+            encodeNs_ += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - t0).count();
+            if (ok)
+            {
+                written_.fetch_add(1, std::memory_order_relaxed);
+                bytes_.fetch_add(buf.size(), std::memory_order_relaxed);
+            }
+            else
+            {
+                failed_.fetch_add(1, std::memory_order_relaxed);
+            }
+            job.img.release();
+            {
+                std::lock_guard<std::mutex> lock(doneMutex_);
+                if (++done_ >= submitted_.load(std::memory_order_relaxed))
+                    doneCv_.notify_all();
+            }
+        }
+    }
+
+} // namespace mce
@@ -1,14 +1,23 @@
 // src/detect_and_compute.cpp — FAST + 5-PATH GRID VALIDATION + ROI warp + OpenMP
 #include "mce/detect_and_compute.hpp"
+#include "mce/debug_sink.hpp"
+#include "mce/grid_ops.hpp"
+#include "mce/hsv_kernel.hpp"
+#include "mce/log.hpp"
 
 #include <opencv2/core.hpp>
 #include <opencv2/imgproc.hpp>
 #include <opencv2/imgcodecs.hpp>
 #include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
 #include <numeric>
+#include <optional>
 #include <vector>
 #include <cmath>
 #include <iostream>
+#include <sstream>
 
 #ifdef _OPENMP
 #include <omp.h>
@@ -34,6 +43,9 @@ namespace mce
             // Component size filters (fraction of full image)
             double min_comp_frac = 0.0002;
             double max_comp_frac = 0.95;
+            // Labeling floor in pixels of the original image; params_for
+            // shrinks it for a downscaled input (reduced decode, pyramid)
+            int min_comp_area = 100;
 
             // Angle scan (faster coarse sweep, tighter fine sweep)
             int coarse_step_deg = 2;
@@ -56,173 +68,500 @@ namespace mce
             double max_quad_area_frac = 0.99;
         };
 
-        // ============================== Utilities ==============================
-        static int percentile_u8(const cv::Mat &ch, double p01_99)
+        // Tunables for an input that is a 1/scale downscale of the original:
+        // the one absolute pixel gate shrinks with the area
+        static Params params_for(int scale)
+        {
+            Params P;
+            if (scale > 1)
+                P.min_comp_area = std::max(1, (int)std::lround((double)P.min_comp_area / ((double)scale * scale)));
+            return P;
+        }
+
+        // ============================== Workspace ==============================
+        // Forwards to OpenCV's standard allocator and counts every buffer it
+        // hands out. Workspace Mats point their `allocator` here, so any
+        // (re)allocation by an OpenCV call writing into them is counted.
+        class CountingAllocator : public cv::MatAllocator
+        {
+        public:
+            cv::UMatData *allocate(int dims, const int *sizes, int type, void *data, size_t *step,
+                                   cv::AccessFlag flags, cv::UMatUsageFlags usage) const override
+            {
+                count_.fetch_add(1, std::memory_order_relaxed);
+                return cv::Mat::getStdAllocator()->allocate(dims, sizes, type, data, step, flags, usage);
+            }
+            bool allocate(cv::UMatData *u, cv::AccessFlag flags, cv::UMatUsageFlags usage) const override
+            {
+                return cv::Mat::getStdAllocator()->allocate(u, flags, usage);
+            }
+            void deallocate(cv::UMatData *u) const override
+            {
+                cv::Mat::getStdAllocator()->deallocate(u);
+            }
+            std::size_t count() const { return count_.load(std::memory_order_relaxed); }
+
+        private:
+            mutable std::atomic<std::size_t> count_{0};
+        };
+
+        // Process-wide validator counters (relaxed atomics: statistics only)
+        struct ValidatorCounters
+        {
+            std::atomic<std::uint64_t> runs{0}, passes{0}, nanos{0};
+        };
+        ValidatorCounters g_validatorStats[kValidatorCount];
+
+        // Scratch for the warp validators (one per sweep thread). The feature
+        // planes (HSV, gray, Sobel magnitude, hue unit vectors) are shared by
+        // all validators and computed at most once per warp; validators only
+        // read them and write into their own buffers.
+        struct ValidatorScratch
         {
-            CV_Assert(ch.type() == CV_8U);
-            int hist[256] = {0};
-            for (int y = 0; y < ch.rows; ++y)
+            // shared features (see features_begin / feat_*)
+            cv::Mat hsv, planes[3];                 // HSV of the whole warp
+            cv::Mat W, hsvW[3];                     // validated view (barcode strip removed) + its HSV views
+            cv::Mat gray, gx, gy, mag;              // gray / Sobel of W
+            cv::Mat Hrad, ones, Hcos, Hsin, Sf, Vf; // hue on the unit circle, S, V of W
+            bool haveGray = false, haveSobel = false, haveUnit = false;
+
+            // per-validator buffers
+            cv::Mat work, bin, kH, kV;              // line peaks
+            cv::Mat pxi, pyi, pxf, pyf;             // projections (int / float)
+            cv::Mat HcosS, HsinS, g, gradX, gradY;  // color gradient
+            cv::Mat samples, klabels, centers, lbl; // kmeans
+            grid::GridTemplate templ[2];            // grid templates (full / stripped warp)
+            std::vector<float> prof, tmp, med;
+            std::vector<int> pos, suf;
+            cv::Ptr<cv::CLAHE> clahe;
+
+            void bind(cv::MatAllocator *a)
             {
-                const uchar *row = ch.ptr<uchar>(y);
-                for (int x = 0; x < ch.cols; ++x)
-                    hist[row[x]]++;
+                for (cv::Mat *m : {&hsv, &planes[0], &planes[1], &planes[2], &gray, &gx, &gy, &mag,
+                                   &Hrad, &ones, &Hcos, &Hsin, &Sf, &Vf,
+                                   &work, &bin, &kH, &kV, &pxi, &pyi, &pxf, &pyf,
+                                   &HcosS, &HsinS, &g, &gradX, &gradY,
+                                   &samples, &klabels, &centers, &lbl, &templ[0].t, &templ[1].t})
+                    m->allocator = a;
             }
-            const int total = ch.rows * ch.cols;
-            const int target = (int)std::round(std::clamp(p01_99, 0.0, 100.0) / 100.0 * total);
-            int acc = 0;
-            for (int v = 0; v < 256; ++v)
+        };
+
+        // Binary mask in the form the angle sweep rotates: horizontal runs of
+        // set pixels plus the outline of the largest blob. Rotating these
+        // costs O(runs + outline) per angle instead of a full-frame warp.
+        struct MaskShape
+        {
+            cv::Size size;                  // frame the rotated ROI is clipped to
+            std::vector<cv::Vec3i> runs;    // (y, x0, x1): pixels [x0, x1) of row y are set
+            std::vector<cv::Point> outline; // largest external contour
+        };
+
+        // A labeled component that passed the minimum-area gate
+        struct ComponentCandidate
+        {
+            int label = 0, area = 0;
+            cv::Rect box;
+            double score = 0; // area × compactness (1 / bbox aspect)
+        };
+
+        // One measured sweep angle (slot of the per-image angle cache)
+        struct SweepCandidate
+        {
+            int key = 0;     // angle in 1/100°
+            bool ok = false; // passed the occupancy/aspect gate
+            double angle = 0, occ = 0, rank = 0;
+            cv::RotatedRect tight;
+            int verdict = 0; // grid validation: 0 = not run, 1 = pass, -1 = fail
+            double hue = 0;
+        };
+
+        // Angle cache + pass lists of one sweep_component call, kept across
+        // calls so a warm sweep does not allocate
+        struct SweepBuffers
+        {
+            std::vector<SweepCandidate> cands;
+            std::vector<int> pass, todo; // slots of this pass / slots still to measure
+            std::vector<int> order;      // gated slots in rank order
+        };
+
+        // Per sweep-thread state: rotated outline, warp, validators
+        struct ScanScratch
+        {
+            cv::Mat warped;
+            std::vector<cv::Point2f> poly, clip; // outline clipping buffers
+            ValidatorScratch v;
+
+            // multi-marker mode: this thread's component mask + shape
+            cv::Mat comp;
+            cv::Mat gateHsv; // pre-sweep gate: HSV of the component box
+            std::vector<std::vector<cv::Point>> cnts;
+            MaskShape shape;
+            SweepBuffers sweep; // used by the sweep running on this slot (slot 0 in single mode)
+
+            void bind(cv::MatAllocator *a)
             {
-                acc += hist[v];
-                if (acc >= target)
-                    return v;
+                warped.allocator = a;
+                comp.allocator = a;
+                gateHsv.allocator = a;
+                v.bind(a);
             }
-            return 255;
+        };
+
+    } // namespace (anon)
+
+    // Image-sized buffers reused across detect() calls
+    struct Detector::Workspace
+    {
+        CountingAllocator counter; // declared first: outlives every Mat below
+
+        cv::Mat mask;
+        cv::Mat kernels[2], roiKernels[2]; // close/open elements (located image / full-res refine)
+        cv::Mat labels, stats, centroids, comp;
+        cv::Mat small;                        // pyramid: downscaled input
+        cv::Mat roiMask;                      // pyramid: full-res refine (image-sized, used via views)
+        cv::Mat vis, crop, polyMask, clipped; // debug artifacts
+        cv::Mat renderMask;                   // render_debug: full-res mask
+        std::vector<std::vector<cv::Point>> cnts;
+        MaskShape shape; // component (sweep) or ROI mask (pyramid refine)
+        std::vector<ComponentCandidate> comps;
+        std::vector<ScanScratch> scan;
+        DebugSink *sink = nullptr; // async debug writer (null = imwrite in the call)
+
+        Workspace()
+        {
+            for (cv::Mat *m : {&mask, &kernels[0], &kernels[1],
+                               &roiKernels[0], &roiKernels[1],
+                               &labels, &stats, &centroids, &comp, &small, &roiMask,
+                               &vis, &crop, &polyMask, &clipped, &renderMask})
+                m->allocator = &counter;
         }
 
-        static cv::Mat build_color_mask_adaptive(const cv::Mat &bgr, const Params &P,
-                                                 cv::Mat &hsv_out,
-                                                 int &Smin, int &Vmin, int &Vmax)
+        void ensure_scan_threads(int n)
         {
-            cv::Mat hsv;
-            cv::cvtColor(bgr, hsv, cv::COLOR_BGR2HSV);
-            hsv_out = hsv;
-            std::vector<cv::Mat> ch;
-            cv::split(hsv, ch);
-            const cv::Mat &S = ch[1], &V = ch[2];
+            if ((int)scan.size() >= n)
+                return;
+            scan.resize(n);
+            for (auto &s : scan)
+                s.bind(&counter);
+        }
+    };
 
-            Smin = std::clamp(percentile_u8(S, 85.0) - 10, P.Smin_floor, P.Smin_ceil);
-            Vmin = std::clamp(percentile_u8(V, 60.0), P.Vmin_floor, P.Vmin_ceil);
-            Vmax = std::clamp(percentile_u8(V, 99.0), P.Vmax_floor, P.Vmax_ceil);
+    namespace
+    {
+        using Workspace = Detector::Workspace;
 
-            struct Band
+        // Splits a call into consecutive stages: lap() charges the time since
+        // the previous lap to one DetectOutput::StageTimes field
+        class StageClock
+        {
+        public:
+            StageClock() : t_(std::chrono::steady_clock::now()) {}
+            void lap(double &acc)
             {
-                int h1, s1, v1, h2, s2, v2;
-            };
-            const Band bands[] = {
-                {0, Smin, Vmin, 10, 255, Vmax}, {170, Smin, Vmin, 180, 255, Vmax}, // red (wrap)
-                {20, Smin, Vmin, 35, 255, Vmax},                                   // yellow
-                {40, Smin, Vmin, 85, 255, Vmax},                                   // green
-                {86, Smin, Vmin, 100, 255, Vmax},                                  // cyan-ish
-                {101, Smin, Vmin, 130, 255, Vmax},                                 // blue
-                {131, Smin, Vmin, 169, 255, Vmax},                                 // magenta/purple
-            };
+                const auto now = std::chrono::steady_clock::now();
+                acc += std::chrono::duration<double, std::milli>(now - t_).count();
+                t_ = now;
+            }
+
+        private:
+            std::chrono::steady_clock::time_point t_;
+        };
+
+        // Laps into `acc` when the scope ends (stages with several exits)
+        struct LapOnExit
+        {
+            StageClock &clk;
+            double &acc;
+            ~LapOnExit() { clk.lap(acc); }
+        };
 
-            cv::Mat mask;
-            for (const auto &b : bands)
+        // ============================== Utilities ==============================
+        // MORPH_RECT element cached in `k`; rebuilt only when the size changes
+        static const cv::Mat &rect_kernel(cv::Mat &k, int w, int h)
+        {
+            if (k.cols != w || k.rows != h)
             {
-                cv::Mat m;
-                cv::inRange(hsv, cv::Scalar(b.h1, b.s1, b.v1), cv::Scalar(b.h2, b.s2, b.v2), m);
-                if (mask.empty())
-                    mask = m;
-                else
-                    cv::bitwise_or(mask, m, mask);
+                k.create(h, w, CV_8U);
+                k.setTo(1);
             }
+            return k;
+        }
 
-            int kClose = std::max(3, (std::min(bgr.rows, bgr.cols) / P.close_div) | 1);
-            int kOpen = std::max(3, (std::min(bgr.rows, bgr.cols) / P.open_div) | 1);
-            cv::morphologyEx(mask, mask, cv::MORPH_CLOSE,
-                             cv::getStructuringElement(cv::MORPH_RECT, {kClose, kClose}));
-            cv::morphologyEx(mask, mask, cv::MORPH_OPEN,
-                             cv::getStructuringElement(cv::MORPH_RECT, {kOpen, kOpen}));
-            return mask;
+        // Top-left `sz` view of `buf`, which is kept at least `cap` large so
+        // variable-sized ROIs reuse one buffer instead of reallocating
+        static cv::Mat view_of(cv::Mat &buf, cv::Size cap, cv::Size sz, int type)
+        {
+            if (buf.type() != type || buf.cols < cap.width || buf.rows < cap.height)
+                buf.create(cap, type);
+            return buf(cv::Rect(0, 0, sz.width, sz.height));
         }
 
-        static bool largest_component(const cv::Mat &mask, cv::Mat &compMask, cv::Rect &bbox)
+        // Marker hue bands (OpenCV H, 0..180): the color mask ORs them, the
+        // palette validator labels pixels by them
+        struct HueBand
         {
-            cv::Mat labels, stats, centroids;
-            int num = cv::connectedComponentsWithStats(mask, labels, stats, centroids, 8);
-            if (num <= 1)
-                return false;
+            int h1, h2;
+        };
+        const HueBand kHueBands[] = {
+            {0, 10}, {170, 180}, // red (wrap)
+            {20, 35},            // yellow
+            {40, 85},            // green
+            {86, 100},           // cyan-ish
+            {101, 130},          // blue
+            {131, 169},          // magenta/purple
+        };
+
+        // Pass 2 of the fused HSV kernel: OR of the hue bands within the S/V
+        // limits, then close/open. Kernel sizes follow `refSize` (the image
+        // the thresholds belong to), so an ROI gets the full-image kernels.
+        static void band_mask(const cv::Mat &bgr, int Smin, int Vmin, int Vmax, cv::Size refSize,
+                              const Params &P, cv::Mat &mask, cv::Mat kernels[2])
+        {
+            hsv::BandSpec spec;
+            spec.smin = Smin;
+            spec.vmin = Vmin;
+            spec.vmax = Vmax;
+            for (const auto &b : kHueBands)
+                hsv::add_hue_range(spec, b.h1, b.h2);
+            hsv::band_mask(bgr, spec, mask);
+
+            int kClose = std::max(3, (std::min(refSize.height, refSize.width) / P.close_div) | 1);
+            int kOpen = std::max(3, (std::min(refSize.height, refSize.width) / P.open_div) | 1);
+            cv::morphologyEx(mask, mask, cv::MORPH_CLOSE, rect_kernel(kernels[0], kClose, kClose));
+            cv::morphologyEx(mask, mask, cv::MORPH_OPEN, rect_kernel(kernels[1], kOpen, kOpen));
+        }
+
+        static void build_color_mask_adaptive(const cv::Mat &bgr, const Params &P, Workspace &ws,
+                                              int &Smin, int &Vmin, int &Vmax)
+        {
+            // Pass 1: S/V histograms straight from BGR (no HSV image, no split)
+            hsv::SVHist hist;
+            hsv::sv_histograms(bgr, hist);
+            const int total = bgr.rows * bgr.cols;
+
+            Smin = std::clamp(hsv::percentile(hist.s, total, 85.0) - 10, P.Smin_floor, P.Smin_ceil);
+            Vmin = std::clamp(hsv::percentile(hist.v, total, 60.0), P.Vmin_floor, P.Vmin_ceil);
+            Vmax = std::clamp(hsv::percentile(hist.v, total, 99.0), P.Vmax_floor, P.Vmax_ceil);
+
+            band_mask(bgr, Smin, Vmin, Vmax, bgr.size(), P, ws.mask, ws.kernels);
+        }
 
-            int best = -1;
-            double bestScore = -1.0;
+        // Labels `mask` into ws.labels/stats and lists components of at least
+        // minArea px (Params::min_comp_area), best score first (ties keep
+        // label order)
+        static void ranked_components(const cv::Mat &mask, int minArea, Workspace &ws,
+                                      std::vector<ComponentCandidate> &comps)
+        {
+            comps.clear();
+            int num = cv::connectedComponentsWithStats(mask, ws.labels, ws.stats, ws.centroids, 8);
+            const cv::Mat &stats = ws.stats;
             for (int i = 1; i < num; ++i)
             {
                 int area = stats.at<int>(i, cv::CC_STAT_AREA);
                 int w = stats.at<int>(i, cv::CC_STAT_WIDTH);
                 int h = stats.at<int>(i, cv::CC_STAT_HEIGHT);
-                if (area < 100)
+                if (area < minArea)
                     continue;
                 double ar = (double)std::max(w, h) / std::max(1, std::min(w, h));
                 double compact = 1.0 / ar;
-                double score = (double)area * compact;
-                if (score > bestScore)
-                {
-                    bestScore = score;
-                    best = i;
-                }
+                ComponentCandidate c;
+                c.label = i;
+                c.area = area;
+                c.box = cv::Rect(stats.at<int>(i, cv::CC_STAT_LEFT), stats.at<int>(i, cv::CC_STAT_TOP), w, h);
+                c.score = (double)area * compact;
+                comps.push_back(c);
             }
-            if (best < 0)
+            // std::sort with an explicit tiebreak: stable_sort takes a heap buffer
+            std::sort(comps.begin(), comps.end(), [](const ComponentCandidate &a, const ComponentCandidate &b)
+                      { return a.score != b.score ? a.score > b.score : a.label < b.label; });
+        }
+
+        static bool largest_component(const cv::Mat &mask, int minArea, Workspace &ws, cv::Rect &bbox)
+        {
+            auto &comps = ws.comps;
+            ranked_components(mask, minArea, ws, comps);
+            if (comps.empty())
                 return false;
 
-            bbox = cv::Rect(stats.at<int>(best, cv::CC_STAT_LEFT),
-                            stats.at<int>(best, cv::CC_STAT_TOP),
-                            stats.at<int>(best, cv::CC_STAT_WIDTH),
-                            stats.at<int>(best, cv::CC_STAT_HEIGHT));
-            compMask = (labels == best);
-            compMask.convertTo(compMask, CV_8U, 255);
+            bbox = comps[0].box;
+            cv::compare(ws.labels, (double)comps[0].label, ws.comp, cv::CMP_EQ); // 0/255 CV_8U
             return true;
         }
 
-        static bool rotate_and_tighten(const cv::Mat &binMask,
+        // Index of the largest contour by area (cnts must be non-empty)
+        static size_t largest_contour(const std::vector<std::vector<cv::Point>> &cnts)
+        {
+            size_t bestIdx = 0;
+            double bestA = -1.0;
+            for (size_t i = 0; i < cnts.size(); ++i)
+            {
+                double a = std::fabs(cv::contourArea(cnts[i]));
+                if (a > bestA)
+                {
+                    bestA = a;
+                    bestIdx = i;
+                }
+            }
+            return bestIdx;
+        }
+
+        // Largest contour into `outline`. Copied, not swapped: a swap would
+        // hand the contour buffer's capacity to findContours' next call and
+        // leave `outline` with a fresh one to regrow.
+        static void copy_outline(const std::vector<std::vector<cv::Point>> &cnts, std::vector<cv::Point> &outline)
+        {
+            const std::vector<cv::Point> &best = cnts[largest_contour(cnts)];
+            outline.assign(best.begin(), best.end());
+        }
+
+        // Run-length encodes the set pixels of mask(box) in mask coordinates
+        // shifted by `off`
+        static void mask_runs(const cv::Mat &mask, cv::Rect box, std::vector<cv::Vec3i> &runs,
+                              cv::Point off = cv::Point())
+        {
+            runs.clear();
+            for (int y = box.y; y < box.y + box.height; ++y)
+            {
+                const uchar *row = mask.ptr<uchar>(y);
+                int x = box.x;
+                const int xe = box.x + box.width;
+                while (x < xe)
+                {
+                    while (x < xe && !row[x])
+                        ++x;
+                    const int x0 = x;
+                    while (x < xe && row[x])
+                        ++x;
+                    if (x > x0)
+                        runs.emplace_back(y + off.y, x0 + off.x, x + off.x);
+                }
+            }
+        }
+
+        // Clips segment p→q to [lo, hi] (Liang–Barsky); returns the kept fraction
+        static double clip_fraction(cv::Point2d p, cv::Point2d q, cv::Point2d lo, cv::Point2d hi)
+        {
+            double t0 = 0.0, t1 = 1.0;
+            const double d[2] = {q.x - p.x, q.y - p.y};
+            const double a[2] = {p.x, p.y}, l[2] = {lo.x, lo.y}, h[2] = {hi.x, hi.y};
+            for (int k = 0; k < 2; ++k)
+            {
+                if (d[k] == 0.0)
+                {
+                    if (a[k] < l[k] || a[k] > h[k])
+                        return 0.0;
+                    continue;
+                }
+                double ta = (l[k] - a[k]) / d[k], tb = (h[k] - a[k]) / d[k];
+                if (ta > tb)
+                    std::swap(ta, tb);
+                t0 = std::max(t0, ta);
+                t1 = std::min(t1, tb);
+                if (t0 >= t1)
+                    return 0.0;
+            }
+            return t1 - t0;
+        }
+
+        // Sutherland–Hodgman against one axis-aligned edge: keeps points with
+        // sign * p[axis] <= sign * bound
+        static void clip_edge(const std::vector<cv::Point2f> &in, std::vector<cv::Point2f> &out,
+                              int axis, float bound, float sign)
+        {
+            out.clear();
+            const size_t n = in.size();
+            for (size_t i = 0; i < n; ++i)
+            {
+                const cv::Point2f &a = in[i], &b = in[(i + 1) % n];
+                const float va = axis ? a.y : a.x, vb = axis ? b.y : b.x;
+                const bool ina = sign * va <= sign * bound, inb = sign * vb <= sign * bound;
+                if (ina)
+                    out.push_back(a);
+                if (ina != inb)
+                {
+                    const float t = (bound - va) / (vb - va);
+                    out.emplace_back(a.x + t * (b.x - a.x), a.y + t * (b.y - a.y));
+                }
+            }
+        }
+
+        // Rotates the shape by angle_deg about rr.center (same matrix as
+        // warpAffine with getRotationMatrix2D would use) and measures it in the
+        // rr-sized axis-aligned ROI: occupancy from the clipped runs, tight box
+        // from the clipped outline, fill = set pixels / tight box area.
+        // Nothing is resampled.
+        static bool rotate_and_tighten(const MaskShape &shape,
                                        const cv::RotatedRect &rr,
                                        double angle_deg,
                                        cv::RotatedRect &tightRect,
                                        double &occupancy,
-                                       cv::Mat *outRotMask = nullptr,
-                                       cv::Mat *outROI = nullptr)
+                                       double &fill,
+                                       ScanScratch &s)
         {
             const cv::Point2f center = rr.center;
-            cv::Mat M = cv::getRotationMatrix2D(center, angle_deg, 1.0);
-            cv::Mat rot;
-            cv::warpAffine(binMask, rot, M, binMask.size(), cv::INTER_NEAREST, cv::BORDER_CONSTANT, 0);
+            const double rad = angle_deg * CV_PI / 180.0;
+            const double ca = std::cos(rad), sa = std::sin(rad);
+            const double tx = (1 - ca) * center.x - sa * center.y;
+            const double ty = sa * center.x + (1 - ca) * center.y;
+            auto fwd = [&](double x, double y)
+            { return cv::Point2d(ca * x + sa * y + tx, -sa * x + ca * y + ty); };
 
             const int RW = std::max(1, (int)std::round(rr.size.width));
             const int RH = std::max(1, (int)std::round(rr.size.height));
             int x0 = (int)std::round(center.x - RW / 2.0);
             int y0 = (int)std::round(center.y - RH / 2.0);
-            x0 = std::clamp(x0, 0, rot.cols - 1);
-            y0 = std::clamp(y0, 0, rot.rows - 1);
-            int x1 = std::clamp(x0 + RW, 0, rot.cols);
-            int y1 = std::clamp(y0 + RH, 0, rot.rows);
+            x0 = std::clamp(x0, 0, shape.size.width - 1);
+            y0 = std::clamp(y0, 0, shape.size.height - 1);
+            int x1 = std::clamp(x0 + RW, 0, shape.size.width);
+            int y1 = std::clamp(y0 + RH, 0, shape.size.height);
+            if (x1 <= x0 || y1 <= y0)
+                return false;
 
-            cv::Mat roi = rot(cv::Rect(x0, y0, x1 - x0, y1 - y0));
-            if (roi.empty())
+            // Occupancy: each run is a 1-px-high strip; its rotated centreline
+            // clipped to the ROI's pixel area gives the covered pixel count
+            const cv::Point2d lo(x0 - 0.5, y0 - 0.5), hi(x1 - 0.5, y1 - 0.5);
+            double covered = 0.0;
+            for (const cv::Vec3i &r : shape.runs)
+            {
+                const double len = r[2] - r[1];
+                covered += len * clip_fraction(fwd(r[1] - 0.5, r[0]), fwd(r[2] - 0.5, r[0]), lo, hi);
+            }
+            occupancy = covered / ((double)(x1 - x0) * (y1 - y0));
+            if (covered <= 0.0)
                 return false;
 
-            std::vector<std::vector<cv::Point>> cnts;
-            cv::findContours(roi.clone(), cnts, cv::RETR_EXTERNAL, cv::CHAIN_APPROX_SIMPLE);
-            if (cnts.empty())
+            // Tight box: rotated outline clipped to the ROI's pixel centres
+            auto &poly = s.poly, &tmp = s.clip;
+            poly.clear();
+            for (const cv::Point &p : shape.outline)
+            {
+                const cv::Point2d q = fwd(p.x, p.y);
+                poly.emplace_back((float)q.x, (float)q.y);
+            }
+            clip_edge(poly, tmp, 0, (float)x0, -1.f);
+            clip_edge(tmp, poly, 0, (float)(x1 - 1), 1.f);
+            clip_edge(poly, tmp, 1, (float)y0, -1.f);
+            clip_edge(tmp, poly, 1, (float)(y1 - 1), 1.f);
+            if (poly.empty())
                 return false;
-            size_t bestIdx = 0;
-            double bestA = 0.0;
-            for (size_t i = 0; i < cnts.size(); ++i)
+
+            float minX = poly[0].x, maxX = minX, minY = poly[0].y, maxY = minY;
+            for (const cv::Point2f &p : poly)
             {
-                double a = std::fabs(cv::contourArea(cnts[i]));
-                if (a > bestA)
-                {
-                    bestA = a;
-                    bestIdx = i;
-                }
+                minX = std::min(minX, p.x);
+                maxX = std::max(maxX, p.x);
+                minY = std::min(minY, p.y);
+                maxY = std::max(maxY, p.y);
             }
-            cv::Rect tight = cv::boundingRect(cnts[bestIdx]);
-            occupancy = (double)cv::countNonZero(roi) / std::max(1, roi.rows * roi.cols);
-
-            cv::Mat Minv;
-            cv::invertAffineTransform(M, Minv);
-            cv::Point2f tightCenter((float)(x0 + tight.x + tight.width / 2.0),
-                                    (float)(y0 + tight.y + tight.height / 2.0));
-            cv::Point2f tightCenterBack(
-                (float)(Minv.at<double>(0, 0) * tightCenter.x + Minv.at<double>(0, 1) * tightCenter.y + Minv.at<double>(0, 2)),
-                (float)(Minv.at<double>(1, 0) * tightCenter.x + Minv.at<double>(1, 1) * tightCenter.y + Minv.at<double>(1, 2)));
-
-            tightRect = cv::RotatedRect(tightCenterBack,
-                                        cv::Size2f((float)tight.width, (float)tight.height),
-                                        (float)angle_deg);
-            if (outRotMask)
-                *outRotMask = rot;
-            if (outROI)
-                *outROI = roi.clone();
+
+            // Back to image coordinates (inverse rotation about the same centre)
+            const double cx = 0.5 * (minX + maxX) - center.x, cy = 0.5 * (minY + maxY) - center.y;
+            const cv::Point2f tightCenterBack((float)(center.x + ca * cx - sa * cy),
+                                              (float)(center.y + sa * cx + ca * cy));
+
+            const cv::Size2f tightSize(std::round(maxX - minX) + 1.f, std::round(maxY - minY) + 1.f);
+            tightRect = cv::RotatedRect(tightCenterBack, tightSize, (float)angle_deg);
+            fill = std::min(1.0, covered / ((double)tightSize.width * tightSize.height));
             return true;
         }
 
@@ -252,15 +591,19 @@ namespace mce
             bool line_ok = false;
         };
 
-        static void compute_hue_score(const cv::Mat &warpedBGR, int warpSize, double &hue_score_out)
+        // HSV planes of a warp into scratch (shared by hue score + strip test)
+        static void warp_hsv(const cv::Mat &warpedBGR, ValidatorScratch &s)
+        {
+            cv::cvtColor(warpedBGR, s.hsv, cv::COLOR_BGR2HSV);
+            cv::split(s.hsv, s.planes);
+        }
+
+        // Expects s.planes to hold the HSV of the warp (see features_begin)
+        static void compute_hue_score(int warpSize, double &hue_score_out, const ValidatorScratch &s)
         {
-            cv::Mat hsv;
-            cv::cvtColor(warpedBGR, hsv, cv::COLOR_BGR2HSV);
-            std::vector<cv::Mat> ch;
-            cv::split(hsv, ch);
-            const cv::Mat &H = ch[0], &S = ch[1];
-            int bins = 18;
-            std::vector<int> hist(bins, 0);
+            const cv::Mat &H = s.planes[0], &S = s.planes[1];
+            const int bins = 18;
+            int hist[bins] = {0};
             for (int y = 0; y < H.rows; ++y)
             {
                 const uchar *hrow = H.ptr<uchar>(y);
@@ -277,37 +620,55 @@ namespace mce
             hue_score_out = std::min(1.0, distinct / 9.0);
         }
 
-        static void smooth5(cv::Mat &p)
+        // Copy a reduced projection (1×n or n×1, CV_32S/CV_32F) into a float vector
+        static void load_profile(const cv::Mat &proj, std::vector<float> &p)
+        {
+            const int n = (int)proj.total();
+            p.resize(n);
+            if (proj.depth() == CV_32S)
+            {
+                const int *src = proj.ptr<int>();
+                for (int i = 0; i < n; ++i)
+                    p[i] = (float)src[i];
+            }
+            else
+            {
+                const float *src = proj.ptr<float>();
+                std::copy(src, src + n, p.begin());
+            }
+        }
+
+        static void smooth5(std::vector<float> &p, std::vector<float> &c)
         {
-            int n = (int)p.total();
+            int n = (int)p.size();
             if (n < 5)
                 return;
-            cv::Mat c = p.clone();
+            c.assign(p.begin(), p.end());
             for (int i = 2; i < n - 2; ++i)
             {
-                float s = c.at<float>(i - 2) + c.at<float>(i - 1) + c.at<float>(i) + c.at<float>(i + 1) + c.at<float>(i + 2);
-                p.at<float>(i) = s / 5.f;
+                float s = c[i - 2] + c[i - 1] + c[i] + c[i + 1] + c[i + 2];
+                p[i] = s / 5.f;
             }
         }
 
         static bool two_peaks_prominence(const cv::Mat &proj, double min_prom, double min_sep_frac,
-                                         bool anchor_thirds, double tol_frac)
+                                         bool anchor_thirds, double tol_frac, ValidatorScratch &s)
         {
             int n = (int)proj.total();
             if (n < 8)
                 return false;
-            cv::Mat p32;
-            proj.convertTo(p32, CV_32F);
-            smooth5(p32);
-            double mn, mx;
-            cv::minMaxLoc(p32, &mn, &mx);
+            std::vector<float> &p32 = s.prof;
+            load_profile(proj, p32);
+            smooth5(p32, s.tmp);
+            auto mm = std::minmax_element(p32.begin(), p32.end());
+            const float mn = *mm.first, mx = *mm.second;
             if (mx - mn < 1e-6)
                 return false;
-            p32 = (p32 - mn) / (float)(mx - mn);
+            for (float &x : p32)
+                x = (x - mn) / (mx - mn);
 
-            std::vector<float> v(n);
-            for (int i = 0; i < n; ++i)
-                v[i] = p32.at<float>(i);
+            std::vector<float> &v = s.med;
+            v.assign(p32.begin(), p32.end());
             std::nth_element(v.begin(), v.begin() + n / 2, v.end());
             float med = v[n / 2];
 
@@ -315,7 +676,7 @@ namespace mce
             float pr1 = -1.f, pr2 = -1.f;
             for (int i = 0; i < n; ++i)
             {
-                float pr = p32.at<float>(i) - med;
+                float pr = p32[i] - med;
                 if (pr > pr1)
                 {
                     pr2 = pr1;
@@ -344,148 +705,175 @@ namespace mce
             return strong && sep && near_thirds;
         }
 
-        static cv::Mat strip_barcode_like(const cv::Mat &inBGR)
+        // Expects s.planes to hold the HSV of inBGR (see warp_hsv).
+        // Returns a view into inBGR, never a copy.
+        static cv::Mat strip_barcode_like(const cv::Mat &inBGR, const ValidatorScratch &s)
         {
             // Detect very bright low-sat band at top; if found, crop top ~12%
-            cv::Mat hsv;
-            cv::cvtColor(inBGR, hsv, cv::COLOR_BGR2HSV);
-            std::vector<cv::Mat> ch;
-            cv::split(hsv, ch);
+            const cv::Mat *ch = s.planes;
             cv::Scalar meanTopV = cv::mean(ch[2](cv::Rect(0, 0, inBGR.cols, std::max(1, inBGR.rows / 10))));
             cv::Scalar meanMidV = cv::mean(ch[2](cv::Rect(0, inBGR.rows / 4, inBGR.cols, std::max(1, inBGR.rows / 2))));
             cv::Scalar meanTopS = cv::mean(ch[1](cv::Rect(0, 0, inBGR.cols, std::max(1, inBGR.rows / 10))));
             if (meanTopV[0] > 1.15 * meanMidV[0] && meanTopS[0] < 60)
             {
                 int cut = std::max(1, (int)std::round(0.12 * inBGR.rows));
-                return inBGR(cv::Rect(0, cut, inBGR.cols, inBGR.rows - cut)).clone();
+                return inBGR(cv::Rect(0, cut, inBGR.cols, inBGR.rows - cut));
             }
             return inBGR;
         }
 
+        // ---- Shared feature planes ----
+        // Starts a cascade: HSV of the whole warp, then the validated view W
+        // with its HSV plane views. HSV is per-pixel, so a view of the warp's
+        // planes equals converting W itself.
+        static void features_begin(const cv::Mat &warpedBGR, ValidatorScratch &s)
+        {
+            warp_hsv(warpedBGR, s);
+            s.W = strip_barcode_like(warpedBGR, s);
+            const cv::Rect r(0, warpedBGR.rows - s.W.rows, s.W.cols, s.W.rows);
+            for (int k = 0; k < 3; ++k)
+                s.hsvW[k] = s.planes[k](r);
+            s.haveGray = s.haveSobel = s.haveUnit = false;
+        }
+
+        // Gray of W (a fresh, continuous Mat: filters see W's own borders)
+        static const cv::Mat &feat_gray(ValidatorScratch &s)
+        {
+            if (!s.haveGray)
+            {
+                cv::cvtColor(s.W, s.gray, cv::COLOR_BGR2GRAY);
+                s.haveGray = true;
+            }
+            return s.gray;
+        }
+
+        // |Sobel x| + |Sobel y| of the gray W into s.mag
+        static const cv::Mat &feat_sobel_mag(ValidatorScratch &s)
+        {
+            if (!s.haveSobel)
+            {
+                const cv::Mat &gray = feat_gray(s);
+                cv::Sobel(gray, s.gx, CV_32F, 1, 0, 3);
+                cv::Sobel(gray, s.gy, CV_32F, 0, 1, 3);
+                s.gx = cv::abs(s.gx);
+                s.gy = cv::abs(s.gy);
+                cv::add(s.gx, s.gy, s.mag);
+                s.haveSobel = true;
+            }
+            return s.mag;
+        }
+
+        // Hue of W as a unit vector (Hcos, Hsin) plus S, V in [0,1]
+        static void feat_hue_unit(ValidatorScratch &s)
+        {
+            if (s.haveUnit)
+                return;
+            s.hsvW[0].convertTo(s.Hrad, CV_32F, CV_PI / 180.0);
+            if (s.ones.size() != s.Hrad.size())
+            {
+                s.ones.create(s.Hrad.size(), CV_32F);
+                s.ones.setTo(1);
+            }
+            cv::polarToCart(s.ones, s.Hrad, s.Hcos, s.Hsin, /*angleInDegrees*/ false);
+            s.hsvW[1].convertTo(s.Sf, CV_32F, 1.0 / 255.0);
+            s.hsvW[2].convertTo(s.Vf, CV_32F, 1.0 / 255.0);
+            s.haveUnit = true;
+        }
+
         // ============================== Validators (5 paths) ==============================
         // 1) LinePeaks + CLAHE (adaptive bin + projections + prominence)
-        static bool validator_linepeaks_CLAHE(const cv::Mat &warpedBGR, const Params &P, bool smallMode)
+        static bool validator_linepeaks_CLAHE(const Params &P, bool smallMode, ValidatorScratch &s)
         {
-            cv::Mat gray;
-            cv::cvtColor(warpedBGR, gray, cv::COLOR_BGR2GRAY);
+            // Equalize/blur a private copy: the shared gray stays untouched
+            const cv::Mat &gray = feat_gray(s);
+            cv::Mat &g = s.work;
             if (!smallMode)
             {
-                cv::Ptr<cv::CLAHE> clahe = cv::createCLAHE(2.0, cv::Size(8, 8));
-                clahe->apply(gray, gray);
+                if (!s.clahe)
+                    s.clahe = cv::createCLAHE(2.0, cv::Size(8, 8));
+                s.clahe->apply(gray, g);
+                cv::GaussianBlur(g, g, cv::Size(3, 3), 0.0);
+            }
+            else
+            {
+                cv::GaussianBlur(gray, g, cv::Size(3, 3), 0.0);
             }
-            cv::GaussianBlur(gray, gray, cv::Size(3, 3), 0.0);
 
-            cv::Mat bin;
-            cv::adaptiveThreshold(gray, bin, 255, cv::ADAPTIVE_THRESH_MEAN_C,
+            cv::Mat &bin = s.bin;
+            cv::adaptiveThreshold(g, bin, 255, cv::ADAPTIVE_THRESH_MEAN_C,
                                   cv::THRESH_BINARY_INV, 21, 5);
 
-            cv::dilate(bin, bin, cv::getStructuringElement(cv::MORPH_RECT, {3, 1}), cv::Point(-1, -1), 1);
-            cv::dilate(bin, bin, cv::getStructuringElement(cv::MORPH_RECT, {1, 3}), cv::Point(-1, -1), 1);
+            cv::dilate(bin, bin, rect_kernel(s.kH, 3, 1), cv::Point(-1, -1), 1);
+            cv::dilate(bin, bin, rect_kernel(s.kV, 1, 3), cv::Point(-1, -1), 1);
 
-            cv::Mat px, py;
-            cv::reduce(bin, px, 0, cv::REDUCE_SUM, CV_32S);
-            cv::reduce(bin, py, 1, cv::REDUCE_SUM, CV_32S);
+            cv::reduce(bin, s.pxi, 0, cv::REDUCE_SUM, CV_32S);
+            cv::reduce(bin, s.pyi, 1, cv::REDUCE_SUM, CV_32S);
 
             double prom = smallMode ? std::min(0.12, P.min_line_peak) : P.min_line_peak;
             double sep = smallMode ? std::min(0.12, P.min_peak_sep) : P.min_peak_sep;
 
-            return two_peaks_prominence(px, prom, sep, /*anchor_thirds*/ true, P.thirds_tol) &&
-                   two_peaks_prominence(py, prom, sep, /*anchor_thirds*/ true, P.thirds_tol);
+            return two_peaks_prominence(s.pxi, prom, sep, /*anchor_thirds*/ true, P.thirds_tol, s) &&
+                   two_peaks_prominence(s.pyi, prom, sep, /*anchor_thirds*/ true, P.thirds_tol, s);
         }
 
         // 2) ColorGradient + Sobel (Hue on unit circle + V)
-        static bool validator_colorgrad_Sobel(const cv::Mat &warpedBGR, const Params &P, bool smallMode)
+        static bool validator_colorgrad_Sobel(const Params &P, bool smallMode, ValidatorScratch &s)
         {
             (void)smallMode;
-            cv::Mat hsv;
-            cv::cvtColor(warpedBGR, hsv, cv::COLOR_BGR2HSV);
-            std::vector<cv::Mat> ch;
-            cv::split(hsv, ch);
-            cv::Mat H = ch[0], S = ch[1], V = ch[2];
-
-            cv::Mat Hf;
-            H.convertTo(Hf, CV_32F);
-            cv::Mat Hrad = Hf * (float)(CV_PI / 180.0f);
-            cv::Mat ones = cv::Mat::ones(Hrad.size(), CV_32F);
-            cv::Mat Hcos, Hsin;
-            cv::polarToCart(ones, Hrad, Hcos, Hsin, /*angleInDegrees*/ false);
-            cv::Mat Sf;
-            S.convertTo(Sf, CV_32F, 1.0 / 255.0);
-            Hcos = Hcos.mul(Sf);
-            Hsin = Hsin.mul(Sf);
-            cv::Mat Vf;
-            V.convertTo(Vf, CV_32F, 1.0 / 255.0);
-
-            auto sobelAbs = [](const cv::Mat &m, bool alongX)
-            {
-                cv::Mat g;
-                if (alongX)
-                    cv::Sobel(m, g, CV_32F, 1, 0, 3);
-                else
-                    cv::Sobel(m, g, CV_32F, 0, 1, 3);
-                return cv::abs(g);
-            };
+            feat_hue_unit(s);
+            cv::multiply(s.Hcos, s.Sf, s.HcosS);
+            cv::multiply(s.Hsin, s.Sf, s.HsinS);
+
+            // acc = |d Hcos| + |d Hsin| + alpha * |d V| along one axis
             const float alpha = 0.35f;
-            cv::Mat gradHx = sobelAbs(Hcos, true) + sobelAbs(Hsin, true) + alpha * sobelAbs(Vf, true);
-            cv::Mat gradHy = sobelAbs(Hcos, false) + sobelAbs(Hsin, false) + alpha * sobelAbs(Vf, false);
+            auto grad_sum = [&](bool alongX, cv::Mat &acc)
+            {
+                const int dx = alongX ? 1 : 0, dy = alongX ? 0 : 1;
+                cv::Sobel(s.HcosS, acc, CV_32F, dx, dy, 3);
+                acc = cv::abs(acc);
+                cv::Sobel(s.HsinS, s.g, CV_32F, dx, dy, 3);
+                s.g = cv::abs(s.g);
+                cv::add(acc, s.g, acc);
+                cv::Sobel(s.Vf, s.g, CV_32F, dx, dy, 3);
+                s.g = cv::abs(s.g);
+                cv::scaleAdd(s.g, alpha, acc, acc);
+            };
+            grad_sum(true, s.gradX);
+            grad_sum(false, s.gradY);
 
-            cv::Mat px, py;
-            cv::reduce(gradHx, px, 0, cv::REDUCE_SUM, CV_32F);
-            cv::reduce(gradHy, py, 1, cv::REDUCE_SUM, CV_32F);
+            cv::reduce(s.gradX, s.pxf, 0, cv::REDUCE_SUM, CV_32F);
+            cv::reduce(s.gradY, s.pyf, 1, cv::REDUCE_SUM, CV_32F);
 
             double prom = P.min_line_peak;
             double sep = P.min_peak_sep;
 
-            return two_peaks_prominence(px, prom, sep, /*anchor_thirds*/ true, P.thirds_tol) &&
-                   two_peaks_prominence(py, prom, sep, /*anchor_thirds*/ true, P.thirds_tol);
+            return two_peaks_prominence(s.pxf, prom, sep, /*anchor_thirds*/ true, P.thirds_tol, s) &&
+                   two_peaks_prominence(s.pyf, prom, sep, /*anchor_thirds*/ true, P.thirds_tol, s);
         }
 
         // 3) MaxGap2Cuts: pick two cuts maximizing profile sum with min-separation
-        static bool validator_maxgap_2cuts(const cv::Mat &warpedBGR, const Params &P, bool smallMode)
+        static bool validator_maxgap_2cuts(const Params &P, bool smallMode, ValidatorScratch &s)
         {
-            cv::Mat gray;
-            cv::cvtColor(warpedBGR, gray, cv::COLOR_BGR2GRAY);
-            cv::Mat gx, gy;
-            cv::Sobel(gray, gx, CV_32F, 1, 0, 3);
-            cv::Sobel(gray, gy, CV_32F, 0, 1, 3);
-            cv::Mat mag = cv::abs(gx) + cv::abs(gy);
+            const cv::Mat &mag = feat_sobel_mag(s);
+            cv::reduce(mag, s.pxf, 0, cv::REDUCE_SUM, CV_32F);
+            cv::reduce(mag, s.pyf, 1, cv::REDUCE_SUM, CV_32F);
 
-            cv::Mat px, py;
-            cv::reduce(mag, px, 0, cv::REDUCE_SUM, CV_32F);
-            cv::reduce(mag, py, 1, cv::REDUCE_SUM, CV_32F);
-            smooth5(px);
-            smooth5(py);
-
-            auto best_pair = [&](const cv::Mat &p, int &a, int &b) -> bool
+            auto best_pair = [&](const cv::Mat &proj, int &a, int &b) -> bool
             {
-                int n = (int)p.total();
+                std::vector<float> &p = s.prof;
+                load_profile(proj, p);
+                smooth5(p, s.tmp);
+                int n = (int)p.size();
                 if (n < 8)
                     return false;
                 int minsep = (int)std::round((smallMode ? std::min(0.12, P.min_peak_sep) : P.min_peak_sep) * n);
-                const float *pp = p.ptr<float>();
-                float best = -1.f;
-                a = -1;
-                b = -1;
-                for (int i = 0; i < n; ++i)
-                {
-                    for (int j = i + minsep; j < n; ++j)
-                    {
-                        float s = pp[i] + pp[j];
-                        if (s > best)
-                        {
-                            best = s;
-                            a = i;
-                            b = j;
-                        }
-                    }
-                }
-                return (a >= 0 && b >= 0);
+                return grid::best_cut_pair(p, minsep, a, b, s.suf);
             };
 
             int ix1, ix2, iy1, iy2;
-            if (!best_pair(px, ix1, ix2))
+            if (!best_pair(s.pxf, ix1, ix2))
                 return false;
-            if (!best_pair(py, iy1, iy2))
+            if (!best_pair(s.pyf, iy1, iy2))
                 return false;
 
             auto near_thirds_ok = [&](int n, int i1, int i2) -> bool
@@ -495,190 +883,273 @@ namespace mce
                         (std::abs(i2 - a) < tol || std::abs(i2 - b) < tol));
             };
 
-            bool okX = near_thirds_ok((int)px.total(), ix1, ix2);
-            bool okY = near_thirds_ok((int)py.total(), iy1, iy2);
+            bool okX = near_thirds_ok((int)s.pxf.total(), ix1, ix2);
+            bool okY = near_thirds_ok((int)s.pyf.total(), iy1, iy2);
             return okX && okY;
         }
 
+        // Label changes along the middle row/column of a label grid; true when
+        // there is one near 1/3 and one near 2/3 (kmeans / palette validators)
+        static bool transitions_near_thirds(const cv::Mat &L, bool alongX, const Params &P,
+                                            std::vector<int> &pos)
+        {
+            const int n = alongX ? L.cols : L.rows;
+            auto label_at = [&](int k)
+            { return alongX ? L.at<int>(L.rows / 2, k) : L.at<int>(k, L.cols / 2); };
+
+            pos.clear();
+            int last = label_at(0);
+            for (int k = 1; k < n; ++k)
+            {
+                int cur = label_at(k);
+                if (cur != last)
+                {
+                    pos.push_back(k);
+                    last = cur;
+                }
+            }
+            float a = n / 3.f, b = 2 * n / 3.f, tol = (float)P.thirds_tol * n;
+            bool hitA = false, hitB = false;
+            for (int p : pos)
+            {
+                if (std::abs(p - a) < tol)
+                    hitA = true;
+                if (std::abs(p - b) < tol)
+                    hitB = true;
+            }
+            return hitA && hitB;
+        }
+
         // 4) KMeans Color (K=6) on subsample + check label transitions near thirds
-        static bool validator_kmeans_color(const cv::Mat &warpedBGR, const Params &P, bool smallMode)
+        static bool validator_kmeans_color(const Params &P, bool smallMode, ValidatorScratch &s)
         {
             int stride = smallMode ? 8 : 6; // faster
-            int rows = warpedBGR.rows, cols = warpedBGR.cols;
-            int nsamp = (rows / stride) * (cols / stride);
+            int rows = s.W.rows, cols = s.W.cols;
+            int gr = rows / stride, gc = cols / stride; // sample grid
+            int nsamp = gr * gc;
             if (nsamp < 64)
                 return false;
 
             // Build feature: [Hcos,Hsin,S,V]
-            cv::Mat hsv;
-            cv::cvtColor(warpedBGR, hsv, cv::COLOR_BGR2HSV);
-            std::vector<cv::Mat> ch;
-            cv::split(hsv, ch);
-            cv::Mat H = ch[0], S = ch[1], V = ch[2];
-            cv::Mat Hf;
-            H.convertTo(Hf, CV_32F);
-            cv::Mat Hrad = Hf * (float)(CV_PI / 180.0f);
-            cv::Mat ones = cv::Mat::ones(Hrad.size(), CV_32F);
-            cv::Mat Hcos, Hsin;
-            cv::polarToCart(ones, Hrad, Hcos, Hsin, false);
-            cv::Mat Sf, Vf;
-            S.convertTo(Sf, CV_32F, 1.0 / 255.0);
-            V.convertTo(Vf, CV_32F, 1.0 / 255.0);
-
-            cv::Mat samples(nsamp, 4, CV_32F);
+            feat_hue_unit(s);
+
+            // Only full grid cells: a partial last row/column would overrun nsamp
+            s.samples.create(nsamp, 4, CV_32F);
             int r = 0;
-            for (int y = 0; y < rows; y += stride)
+            for (int y = 0; y < gr * stride; y += stride)
             {
-                for (int x = 0; x < cols; x += stride)
+                for (int x = 0; x < gc * stride; x += stride)
                 {
-                    samples.at<float>(r, 0) = Hcos.at<float>(y, x) * (Sf.at<float>(y, x));
-                    samples.at<float>(r, 1) = Hsin.at<float>(y, x) * (Sf.at<float>(y, x));
-                    samples.at<float>(r, 2) = Sf.at<float>(y, x);
-                    samples.at<float>(r, 3) = Vf.at<float>(y, x);
-                    ++r;
+                    float *row = s.samples.ptr<float>(r++);
+                    const float sf = s.Sf.at<float>(y, x);
+                    row[0] = s.Hcos.at<float>(y, x) * sf;
+                    row[1] = s.Hsin.at<float>(y, x) * sf;
+                    row[2] = sf;
+                    row[3] = s.Vf.at<float>(y, x);
                 }
             }
 
             int K = 6;
-            cv::Mat labels, centers;
-            cv::kmeans(samples, K, labels,
+            cv::kmeans(s.samples, K, s.klabels,
                        cv::TermCriteria(cv::TermCriteria::EPS + cv::TermCriteria::MAX_ITER, 10, 1e-3),
-                       1, cv::KMEANS_PP_CENTERS, centers);
+                       1, cv::KMEANS_PP_CENTERS, s.centers);
 
-            if (centers.rows < 5)
+            if (s.centers.rows < 5)
                 return false;
 
             // Map labels back to full grid at stride positions
-            cv::Mat lbl(rows / stride, cols / stride, CV_32S);
+            s.lbl.create(gr, gc, CV_32S);
             r = 0;
-            for (int y = 0; y < lbl.rows; ++y)
-                for (int x = 0; x < lbl.cols; ++x)
-                    lbl.at<int>(y, x) = labels.at<int>(r++);
+            for (int y = 0; y < s.lbl.rows; ++y)
+                for (int x = 0; x < s.lbl.cols; ++x)
+                    s.lbl.at<int>(y, x) = s.klabels.at<int>(r++);
+
+            return transitions_near_thirds(s.lbl, /*alongX*/ true, P, s.pos) &&
+                   transitions_near_thirds(s.lbl, /*alongX*/ false, P, s.pos);
+        }
 
-            auto transitions_near_thirds = [&](const cv::Mat &L, bool alongX) -> bool
+        // 4b) Palette: label the same sample grid against the fixed hue-band
+        // palette (plus dark/light for unsaturated pixels) instead of kmeans
+        static bool validator_palette_color(const Params &P, bool smallMode, ValidatorScratch &s)
+        {
+            // Hue → palette index: a band's own index, gaps go to the nearest band
+            // (by circular hue distance); red's two ranges share one label
+            static const std::array<uchar, 181> hueLabel = []
             {
-                if (alongX)
+                std::array<uchar, 181> lut{};
+                const int nb = (int)(sizeof(kHueBands) / sizeof(kHueBands[0]));
+                for (int h = 0; h <= 180; ++h)
                 {
-                    int y = L.rows / 2;
-                    int n = L.cols;
-                    int last = L.at<int>(y, 0);
-                    std::vector<int> pos;
-                    for (int x = 1; x < n; ++x)
+                    int best = 0, bestD = 1 << 30;
+                    for (int b = 0; b < nb; ++b)
                     {
-                        int cur = L.at<int>(y, x);
-                        if (cur != last)
+                        int d = 0;
+                        if (h < kHueBands[b].h1)
+                            d = kHueBands[b].h1 - h;
+                        else if (h > kHueBands[b].h2)
+                            d = h - kHueBands[b].h2;
+                        d = std::min(d, 180 - d);
+                        if (d < bestD)
                         {
-                            pos.push_back(x);
-                            last = cur;
+                            bestD = d;
+                            best = b;
                         }
                     }
-                    float a = n / 3.f, b = 2 * n / 3.f, tol = (float)P.thirds_tol * n;
-                    bool hitA = false, hitB = false;
-                    for (int p : pos)
-                    {
-                        if (std::abs(p - a) < tol)
-                            hitA = true;
-                        if (std::abs(p - b) < tol)
-                            hitB = true;
-                    }
-                    return hitA && hitB;
+                    lut[h] = (uchar)std::max(0, best - 1); // bands 0 and 1 are both red
                 }
-                else
+                return lut;
+            }();
+            const int kDark = 6, kLight = 7;
+            const int minSat = 40; // chroma threshold shared with the hue score
+            const int darkV = 80;
+
+            int stride = smallMode ? 8 : 6;
+            int gr = s.W.rows / stride, gc = s.W.cols / stride;
+            if (gr * gc < 64)
+                return false;
+
+            const cv::Mat &H = s.hsvW[0], &S = s.hsvW[1], &V = s.hsvW[2];
+            s.lbl.create(gr, gc, CV_32S);
+            for (int gy = 0; gy < gr; ++gy)
+            {
+                const uchar *hr = H.ptr<uchar>(gy * stride);
+                const uchar *sr = S.ptr<uchar>(gy * stride);
+                const uchar *vr = V.ptr<uchar>(gy * stride);
+                int *lr = s.lbl.ptr<int>(gy);
+                for (int gx = 0; gx < gc; ++gx)
                 {
-                    int x = L.cols / 2;
-                    int n = L.rows;
-                    int last = L.at<int>(0, x);
-                    std::vector<int> pos;
-                    for (int y = 1; y < n; ++y)
-                    {
-                        int cur = L.at<int>(y, x);
-                        if (cur != last)
-                        {
-                            pos.push_back(y);
-                            last = cur;
-                        }
-                    }
-                    float a = n / 3.f, b = 2 * n / 3.f, tol = (float)P.thirds_tol * n;
-                    bool hitA = false, hitB = false;
-                    for (int p : pos)
-                    {
-                        if (std::abs(p - a) < tol)
-                            hitA = true;
-                        if (std::abs(p - b) < tol)
-                            hitB = true;
-                    }
-                    return hitA && hitB;
+                    const int x = gx * stride;
+                    lr[gx] = sr[x] > minSat ? hueLabel[hr[x]] : (vr[x] < darkV ? kDark : kLight);
                 }
-            };
-
-            return transitions_near_thirds(lbl, /*alongX*/ true) &&
-                   transitions_near_thirds(lbl, /*alongX*/ false);
+            }
+            return transitions_near_thirds(s.lbl, /*alongX*/ true, P, s.pos) &&
+                   transitions_near_thirds(s.lbl, /*alongX*/ false, P, s.pos);
         }
 
         // 5) Template correlation against ideal 3×3 edge map (normalized)
-        static bool validator_template_corr(const cv::Mat &warpedBGR, const Params & /*P*/, bool /*smallMode*/)
-        {
-            cv::Mat gray;
-            cv::cvtColor(warpedBGR, gray, cv::COLOR_BGR2GRAY);
-            cv::Mat gx, gy;
-            cv::Sobel(gray, gx, CV_32F, 1, 0, 3);
-            cv::Sobel(gray, gy, CV_32F, 0, 1, 3);
-            cv::Mat mag = cv::abs(gx) + cv::abs(gy);
-            cv::normalize(mag, mag, 0, 1, cv::NORM_MINMAX);
-
-            // Build template with grid lines at 1/3 and 2/3 (thickness 2)
-            cv::Mat templ = cv::Mat::zeros(mag.size(), CV_32F);
-            int W = templ.cols, H = templ.rows;
-            auto draw_v = [&](int x)
-            { cv::line(templ, {x, 0}, {x, H - 1}, 1.0f, 2, cv::LINE_AA); };
-            auto draw_h = [&](int y)
-            { cv::line(templ, {0, y}, {W - 1, y}, 1.0f, 2, cv::LINE_AA); };
-            draw_v(W / 3);
-            draw_v(2 * W / 3);
-            draw_h(H / 3);
-            draw_h(2 * H / 3);
-
-            // Single-value normalized correlation
-            cv::Mat res;
-            cv::matchTemplate(mag, templ, res, cv::TM_CCOEFF_NORMED);
-            double minv, maxv;
-            cv::minMaxLoc(res, &minv, &maxv);
-            return maxv > 0.25; // threshold
-        }
-
-        // Master: run cascade of 5 validators
-        static void grid_checks_cascade(const cv::Mat &warpedBGR,
-                                        GridCheckResult &out,
-                                        const Params &P)
+        // TM_CCOEFF_NORMED of the Sobel magnitude and the template, computed
+        // in one fused pass (grid::template_corr). Invariant to the old
+        // min-max normalization of m.
+        static bool validator_template_corr(const Params & /*P*/, bool /*smallMode*/, ValidatorScratch &s)
         {
-            // Hue richness once
-            compute_hue_score(warpedBGR, P.warpSize, out.hue_score);
-            // Pre-strip barcode/glare if exists
-            cv::Mat W = strip_barcode_like(warpedBGR);
+            const cv::Mat &mag = feat_sobel_mag(s);
+
+            // Template with grid lines at 1/3 and 2/3 (thickness 2). Two slots
+            // (full / barcode-stripped warp); redrawn only when the size changes.
+            grid::GridTemplate &gt = (s.templ[0].t.empty() || s.templ[0].t.size() == mag.size()) ? s.templ[0] : s.templ[1];
+            if (gt.t.size() != mag.size())
+                grid::make_grid_template(mag.size(), gt);
+
+            const double corr = grid::template_corr(mag, gt);
+            return corr > 0.25; // threshold
+        }
+
+        // ---- Validator registry ----
+        using ValidatorFn = bool (*)(const Params &, bool smallMode, ValidatorScratch &);
+        struct ValidatorEntry
+        {
+            const char *name;
+            ValidatorFn fn;
+        };
+        // Indexed by mce::Validator
+        const ValidatorEntry kValidators[kValidatorCount] = {
+            {"linepeaks", validator_linepeaks_CLAHE},
+            {"colorgrad", validator_colorgrad_Sobel},
+            {"maxgap", validator_maxgap_2cuts},
+            {"kmeans", validator_kmeans_color},
+            {"palette", validator_palette_color},
+            {"template", validator_template_corr},
+        };
 
-            bool smallMode = std::min(W.rows, W.cols) < 60;
+        // Enabled validators in cascade order
+        struct ValidatorPlan
+        {
+            std::array<Validator, kValidatorCount> v{};
+            int n = 0;
+            const Validator *begin() const { return v.data(); }
+            const Validator *end() const { return v.data() + n; }
+        };
 
-            if (validator_linepeaks_CLAHE(W, P, smallMode))
+        // Current adaptive order (see adaptive_validator_order) into `order`
+        static void adaptive_order(std::array<Validator, kValidatorCount> &order)
+        {
+            // Expected cost of a first-pass cascade is minimized by ascending
+            // cost / P(pass). Pass rates are Laplace-smoothed; a validator with
+            // no runs yet costs 0, so each one is sampled early. Ties keep the
+            // classic order (which is also the cold-start order).
+            double key[kValidatorCount];
+            for (int k = 0; k < kValidatorCount; ++k)
             {
-                out.line_ok = true;
-                return;
+                const ValidatorStats st = validator_stats((Validator)k);
+                const double cost = st.runs ? st.total_ms / st.runs : 0.0;
+                const double pass = (st.passes + 1.0) / (st.runs + 2.0);
+                key[k] = cost / pass;
+                order[k] = (Validator)k;
             }
-            if (validator_colorgrad_Sobel(W, P, smallMode))
+            std::sort(order.begin(), order.end(), [&](Validator a, Validator b)
+                      { return key[(int)a] != key[(int)b] ? key[(int)a] < key[(int)b] : a < b; });
+        }
+
+        // Cascade order for one image: the pinned prefix (rest in classic
+        // order) or the current adaptive order, minus disabled validators
+        static ValidatorPlan plan_validators(const DetectOptions &opt)
+        {
+            ValidatorPlan plan;
+            bool used[kValidatorCount] = {};
+            auto add = [&](Validator v)
             {
-                out.line_ok = true;
-                return;
-            }
-            if (validator_maxgap_2cuts(W, P, smallMode))
+                if (used[(int)v] || !validator_enabled(opt, v))
+                    return;
+                used[(int)v] = true;
+                plan.v[plan.n++] = v;
+            };
+            if (opt.validator_order.empty())
             {
-                out.line_ok = true;
-                return;
+                std::array<Validator, kValidatorCount> adaptive;
+                adaptive_order(adaptive);
+                for (Validator v : adaptive)
+                    add(v);
             }
-            if (validator_kmeans_color(W, P, smallMode))
+            for (Validator v : opt.validator_order)
+                add(v);
+            for (int k = 0; k < kValidatorCount; ++k)
+                add((Validator)k);
+            return plan;
+        }
+
+        // Master: run the validators in plan order until one passes
+        static void grid_checks_cascade(const cv::Mat &warpedBGR,
+                                        GridCheckResult &out,
+                                        const Params &P,
+                                        const ValidatorPlan &plan,
+                                        ValidatorScratch &s)
+        {
+            // Shared planes: warp HSV now, the rest on first use; W is the
+            // warp with any barcode/glare strip removed
+            features_begin(warpedBGR, s);
+            // Hue richness once
+            compute_hue_score(P.warpSize, out.hue_score, s);
+
+            bool smallMode = std::min(s.W.rows, s.W.cols) < 60;
+
+            out.line_ok = false;
+            for (Validator v : plan)
             {
-                out.line_ok = true;
-                return;
+                const auto t0 = std::chrono::steady_clock::now();
+                const bool ok = kValidators[(int)v].fn(P, smallMode, s);
+                const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now() - t0);
+
+                ValidatorCounters &c = g_validatorStats[(int)v];
+                c.runs.fetch_add(1, std::memory_order_relaxed);
+                c.nanos.fetch_add((std::uint64_t)ns.count(), std::memory_order_relaxed);
+                if (ok)
+                {
+                    c.passes.fetch_add(1, std::memory_order_relaxed);
+                    out.line_ok = true;
+                    return;
+                }
             }
-            out.line_ok = validator_template_corr(W, P, smallMode);
         }
 
         // ============================== Drawing ==============================
@@ -697,208 +1168,320 @@ namespace mce
             }
         }
 
-    } // namespace (anon)
+        // ============================== Debug artifacts ==============================
+        // Without a sink "<stem>.png" is written in the call. A sink queues
+        // the image and owns it from then on, so it gets its own buffer:
+        // either a copy (already at preview size) or a Mat rendered fresh
+        // for it, never a workspace buffer the next call would overwrite.
+        static std::string save_artifact(Workspace &ws, const std::string &stem, const cv::Mat &img)
+        {
+            if (!ws.sink)
+            {
+                const std::string path = stem + ".png";
+                cv::imwrite(path, img);
+                return path;
+            }
+            const double s = ws.sink->preview_scale(img.size());
+            cv::Mat copy;
+            if (s < 1.0)
+                cv::resize(img, copy, cv::Size(), s, s, cv::INTER_AREA);
+            else
+                img.copyTo(copy);
+            return ws.sink->submit(stem, std::move(copy));
+        }
 
-    // ============================== Public API ==============================
-    bool detect_and_compute(const cv::Mat &bgr,
-                            DetectOutput &out,
-                            bool debug,
-                            bool saveDebug,
-                            const std::string &debugBase)
-    {
-        out = DetectOutput{};
-        if (bgr.empty())
-            return true;
-
-        Params P;
-
-        // (1) Adaptive color mask
-        cv::Mat hsv;
-        int Smin = 0, Vmin = 0, Vmax = 255;
-        cv::Mat mask = build_color_mask_adaptive(bgr, P, hsv, Smin, Vmin, Vmax);
-        out.Smin = Smin;
-        out.Vmin = Vmin;
-        out.Vmax = Vmax;
-        if (saveDebug)
+        // For `img` rendered into render_target(): handed over without a copy
+        static std::string save_rendered(Workspace &ws, const std::string &stem, cv::Mat &img)
         {
-            out.debug_mask_path = debugBase + "_debug_mask.png";
-            cv::imwrite(out.debug_mask_path, mask);
+            if (!ws.sink)
+            {
+                const std::string path = stem + ".png";
+                cv::imwrite(path, img);
+                return path;
+            }
+            return ws.sink->submit(stem, std::move(img));
         }
 
-        // (2) Best connected component
-        cv::Mat comp;
-        cv::Rect compBox;
-        if (!largest_component(mask, comp, compBox))
+        // Workspace buffer when writing in the call, a fresh Mat for the sink
+        static cv::Mat &render_target(const Workspace &ws, cv::Mat &wsBuf, cv::Mat &fresh)
         {
-            if (debug)
-                std::cout << "[DBG] No component\n";
-            return true;
+            return ws.sink ? fresh : wsBuf;
         }
 
-        double compFrac = (double)cv::countNonZero(comp) / std::max(1, bgr.rows * bgr.cols);
-        if (debug)
-            std::cout << "[DBG] compFrac=" << compFrac
-                      << " (min=" << P.min_comp_frac << ", max=" << P.max_comp_frac << ")\n";
-        if (compFrac < P.min_comp_frac || compFrac > P.max_comp_frac)
+        // Original + box + coverage text; rendered at preview size when the
+        // sink downscales anyway (no full-resolution copy)
+        static void render_quad(const cv::Mat &bgr, const cv::RotatedRect &rect, int pct,
+                                const Workspace &ws, cv::Mat &vis)
         {
-            if (debug)
-                std::cout << "[DBG] Component frac out of range: " << compFrac << "\n";
-            return true;
+            const double s = ws.sink ? ws.sink->preview_scale(bgr.size()) : 1.0;
+            if (s < 1.0)
+            {
+                cv::resize(bgr, vis, cv::Size(), s, s, cv::INTER_AREA);
+                const cv::RotatedRect scaled(cv::Point2f((float)(rect.center.x * s), (float)(rect.center.y * s)),
+                                             cv::Size2f((float)(rect.size.width * s), (float)(rect.size.height * s)),
+                                             rect.angle);
+                draw_box(vis, scaled, pct);
+                return;
+            }
+            bgr.copyTo(vis);
+            draw_box(vis, rect, pct);
         }
 
-        // (3) Base orientation
-        std::vector<std::vector<cv::Point>> cnts;
-        cv::findContours(comp, cnts, cv::RETR_EXTERNAL, cv::CHAIN_APPROX_SIMPLE);
-        if (cnts.empty())
-            return true;
-        cv::RotatedRect rr = cv::minAreaRect(cnts[0]);
-        double baseAngle = rr.angle;
-
-        double baseArea = rr.size.width * rr.size.height;
-        double baseFrac = baseArea / (double)(bgr.cols * bgr.rows);
-        if (debug)
-            std::cout << "[DBG] baseFrac=" << baseFrac
-                      << " (max_quad_area_frac=" << P.max_quad_area_frac << ")\n";
-        if (baseFrac > P.max_quad_area_frac && debug)
-            std::cout << "[DBG] Base rect very large; continuing with scan anyway\n";
-
-        // (4) Angle scan: coarse→fine, keep best (OpenMP)
-        struct Best
+        // ============================== Locate / refine ==============================
+        // Where the marker is, before any artifact is written
+        struct Located
         {
+            bool found = false;
+            bool fallback = false; // minAreaRect warp passed (no angle passed validation)
+            cv::RotatedRect rect;  // tight box (or rr for the fallback), image coords
             double angle = 0, cov = 0, occ = 0, hue = 0;
             bool line_ok = false;
-            cv::RotatedRect tight;
-        } best;
-        bool earlyStop = false;
+            cv::Mat warp; // fallback warp, only when its scan slot is reused before emission
+        };
 
-        auto evaluate_angle = [&](double ang, Best &localBest)
+        // Stages 3–4 for one component whose runs + outline are in `shape`:
+        // base orientation, two-phase angle sweep, fallback warp. Sweep
+        // threads use slots[0..scanThreads). The coarse pass is centered on
+        // `seedAngle` when given (tracking), else on the base angle.
+        static void sweep_component(const cv::Mat &bgr, const Params &P, const DetectOptions &opt,
+                                    const ValidatorPlan &plan, const MaskShape &shape,
+                                    ScanScratch *slots, int scanThreads, bool keepWarp,
+                                    Located &loc, DetectOutput &out, StageClock &clk, bool debug,
+                                    std::optional<double> seedAngle = std::nullopt)
         {
-            cv::RotatedRect tight;
-            double occ = 0.0;
-            if (!rotate_and_tighten(comp, rr, ang, tight, occ))
-                return;
-
-            double w = tight.size.width, h = tight.size.height;
-            if (w <= 0 || h <= 0)
-                return;
-            double ar = std::max(w, h) / std::max(1.0, std::min(w, h));
-            if (occ < P.min_occupancy || ar > P.max_aspect)
-                return;
-
-            // --- ROI crop סביב ה-tightRect על המקור:
-            cv::Point2f tpts[4];
-            tight.points(tpts);
-            cv::Point2f TL, TR, BR, BL;
-            order_quad_tl_tr_br_bl(tpts, TL, TR, BR, BL);
-            std::vector<cv::Point2f> src = {TL, TR, BR, BL};
-
-            cv::Rect fullRoi = cv::boundingRect(src);
-            int pad = std::max(2, (int)std::round(0.10 * std::max(fullRoi.width, fullRoi.height)));
-            fullRoi.x = std::max(0, fullRoi.x - pad);
-            fullRoi.y = std::max(0, fullRoi.y - pad);
-            fullRoi.width = std::min(bgr.cols - fullRoi.x, fullRoi.width + 2 * pad);
-            fullRoi.height = std::min(bgr.rows - fullRoi.y, fullRoi.height + 2 * pad);
-
-            // הזז את הנקודות לקואורדינטות של ה-ROI
-            std::vector<cv::Point2f> srcR(4);
-            for (int i = 0; i < 4; ++i)
-                srcR[i] = cv::Point2f(src[i].x - fullRoi.x, src[i].y - fullRoi.y);
-
-            cv::Mat roiBGR = bgr(fullRoi);
-            std::vector<cv::Point2f> dst = {{0, 0}, {(float)P.warpSize - 1, 0}, {(float)P.warpSize - 1, (float)P.warpSize - 1}, {0, (float)P.warpSize - 1}};
-            cv::Mat H = cv::getPerspectiveTransform(srcR, dst);
-            cv::Mat warped;
-            cv::warpPerspective(roiBGR, warped, H, cv::Size(P.warpSize, P.warpSize));
-
-            // 5-path cascade
-            GridCheckResult gcr;
-            grid_checks_cascade(warped, gcr, P);
-            if (gcr.hue_score < P.min_hue_score || !gcr.line_ok)
-                return;
+            DetectOutput::StageTimes &st = out.stage_ms;
+            cv::RotatedRect rr = cv::minAreaRect(shape.outline);
+            double baseAngle = rr.angle;
 
-            double area = w * h;
-            double cov = 100.0 * area / (double)(bgr.cols * bgr.rows);
-            double score = occ * (0.5 + 0.5 * gcr.hue_score);
+            double baseArea = rr.size.width * rr.size.height;
+            double baseFrac = baseArea / (double)(bgr.cols * bgr.rows);
+            if (debug)
+                mce::log::Debug() << "baseFrac=" << baseFrac
+                                  << " (max_quad_area_frac=" << P.max_quad_area_frac << ")";
+            if (baseFrac > P.max_quad_area_frac && debug)
+                mce::log::Debug() << "Base rect very large; continuing with scan anyway";
+
+            // (4) Two-phase angle sweep (OpenMP)
+            //   phase 1: geometry only (occupancy, aspect, fill) on every
+            //            coarse angle, then fine around the best-ranked one
+            //   phase 2: warp + grid cascade on the top-K in rank order; the
+            //            first candidate that passes wins
+            using Candidate = SweepCandidate;
+            // Per-image angle cache: every measured angle keeps one slot, keyed
+            // by angle in 1/100°. The fine pass reuses coarse slots; the
+            // fallback reuses a failed validation of the same box. A few dozen
+            // slots at most, so a linear search beats a hash map (and does
+            // not allocate); the buffers live in slot 0.
+            SweepBuffers &sb = slots[0].sweep;
+            std::vector<Candidate> &cands = sb.cands;
+            cands.clear();
+            auto angle_key = [](double deg)
+            { return (int)std::lround(deg * 100.0); };
+            auto find_slot = [&](int key)
+            {
+                for (int k = 0; k < (int)cands.size(); ++k)
+                    if (cands[k].key == key)
+                        return k;
+                return -1;
+            };
+#ifndef _OPENMP
+            (void)scanThreads; // serial build: slot 0 only
+#endif
 
-            double bestScore = localBest.occ * (0.5 + 0.5 * localBest.hue);
-            if (score > bestScore)
+            auto measure = [&](Candidate &c, ScanScratch &s)
             {
-                localBest.angle = ang;
-                localBest.cov = cov;
-                localBest.occ = occ;
-                localBest.hue = gcr.hue_score;
-                localBest.line_ok = gcr.line_ok;
-                localBest.tight = tight;
-            }
-        };
+                double occ = 0.0, fill = 0.0;
+                if (!rotate_and_tighten(shape, rr, c.angle, c.tight, occ, fill, s))
+                    return;
+
+                double w = c.tight.size.width, h = c.tight.size.height;
+                if (w <= 0 || h <= 0)
+                    return;
+                double ar = std::max(w, h) / std::max(1.0, std::min(w, h));
+                if (occ < P.min_occupancy || ar > P.max_aspect)
+                    return;
+
+                c.ok = true;
+                c.occ = occ;
+                c.rank = occ + opt.rank_fill_weight * fill - opt.rank_aspect_weight * (ar - 1.0);
+            };
 
-        auto scan = [&](int stepDeg, int rangeDeg) -> bool
-        {
-            // נכין את רשימת הזוויות מראש
-            std::vector<int> deltas;
-            for (int d = -rangeDeg; d <= rangeDeg; d += stepDeg)
-                deltas.push_back(d);
+            // Scores `center + d` for d in ±rangeDeg; returns the best-ranked angle
+            auto score_pass = [&](double center, int stepDeg, int rangeDeg) -> double
+            {
+                std::vector<int> &pass = sb.pass, &todo = sb.todo;
+                pass.clear();
+                todo.clear();
+                for (int d = -rangeDeg; d <= rangeDeg; d += stepDeg)
+                {
+                    const double ang = center + d;
+                    const int key = angle_key(ang);
+                    int slot = find_slot(key);
+                    ++out.angle_cache_lookups;
+                    if (slot < 0)
+                    {
+                        slot = (int)cands.size();
+                        Candidate &c = cands.emplace_back();
+                        c.key = key;
+                        c.angle = ang;
+                        todo.push_back(slot);
+                    }
+                    else
+                    {
+                        ++out.angle_cache_hits;
+                    }
+                    pass.push_back(slot);
+                }
 
-            // Best מקומי לכל ת’רד
-            std::vector<Best> locals(
 #ifdef _OPENMP
-                std::max(1, omp_get_max_threads())
+                const int nThreads = std::max(1, std::min(scanThreads, (int)todo.size()));
+#pragma omp parallel for num_threads(nThreads) schedule(dynamic, 1)
+#endif
+                for (int i = 0; i < (int)todo.size(); ++i)
+                {
+#ifdef _OPENMP
+                    int tid = omp_get_thread_num();
 #else
-                1
+                    int tid = 0;
 #endif
-            );
+                    measure(cands[todo[i]], slots[tid]);
+                }
+                out.sweep_scored += (int)todo.size();
+
+                const Candidate *top = nullptr;
+                for (int k : pass)
+                    if (cands[k].ok && (!top || cands[k].rank > top->rank))
+                        top = &cands[k];
+                return top ? top->angle : center;
+            };
 
+            const double coarseTop = score_pass(seedAngle.value_or(baseAngle), P.coarse_step_deg, P.coarse_range_deg);
+            score_pass(coarseTop, P.fine_step_deg, P.fine_range_deg);
+            clk.lap(st.sweep);
+            LapOnExit validateLap{clk, st.validate};
+
+            // Phase 2: gated slots, best rank first (ties keep sweep order)
+            std::vector<int> &order = sb.order;
+            order.clear();
+            for (int k = 0; k < (int)cands.size(); ++k)
+                if (cands[k].ok)
+                    order.push_back(k);
+            std::sort(order.begin(), order.end(), [&](int a, int b)
+                      { return cands[a].rank != cands[b].rank ? cands[a].rank > cands[b].rank : a < b; });
+            const int gated = (int)order.size();
+            const int K = opt.validate_top_k > 0 ? std::min(opt.validate_top_k, gated) : gated;
+
+            // Lowest passing rank index so far: candidates ranked below it are
+            // skipped, so the winner is the same for any thread count
+            std::atomic<int> firstPass{K};
+            std::atomic<int> validated{0};
 #ifdef _OPENMP
-#pragma omp parallel for schedule(static)
+            const int nValThreads = std::max(1, std::min(scanThreads, K));
+#pragma omp parallel for num_threads(nValThreads) schedule(dynamic, 1)
 #endif
-            for (int i = 0; i < (int)deltas.size(); ++i)
+            for (int i = 0; i < K; ++i)
             {
+                if (i > firstPass.load(std::memory_order_relaxed))
+                    continue; // a better-ranked candidate already passed
 #ifdef _OPENMP
-                if (earlyStop)
-                    continue; // בדיקה רופפת
                 int tid = omp_get_thread_num();
 #else
                 int tid = 0;
 #endif
-                double ang = (best.cov > 0.0 ? best.angle : baseAngle) + deltas[i];
-                evaluate_angle(ang, locals[tid]);
+                ScanScratch &s = slots[tid];
+                Candidate &c = cands[order[i]];
+                const cv::RotatedRect &tight = c.tight;
+
+                // --- ROI crop סביב ה-tightRect על המקור:
+                cv::Point2f tpts[4];
+                tight.points(tpts);
+                cv::Point2f TL, TR, BR, BL;
+                order_quad_tl_tr_br_bl(tpts, TL, TR, BR, BL);
+                const std::array<cv::Point2f, 4> src = {TL, TR, BR, BL};
+
+                cv::Rect fullRoi = cv::boundingRect(src);
+                int pad = std::max(2, (int)std::round(0.10 * std::max(fullRoi.width, fullRoi.height)));
+                fullRoi.x = std::max(0, fullRoi.x - pad);
+                fullRoi.y = std::max(0, fullRoi.y - pad);
+                fullRoi.width = std::min(bgr.cols - fullRoi.x, fullRoi.width + 2 * pad);
+                fullRoi.height = std::min(bgr.rows - fullRoi.y, fullRoi.height + 2 * pad);
+
+                // הזז את הנקודות לקואורדינטות של ה-ROI
+                std::array<cv::Point2f, 4> srcR;
+                for (int k = 0; k < 4; ++k)
+                    srcR[k] = cv::Point2f(src[k].x - fullRoi.x, src[k].y - fullRoi.y);
+
+                cv::Mat roiBGR = bgr(fullRoi);
+                const std::array<cv::Point2f, 4> dst = {{{0, 0}, {(float)P.warpSize - 1, 0}, {(float)P.warpSize - 1, (float)P.warpSize - 1}, {0, (float)P.warpSize - 1}}};
+                cv::Mat H = cv::getPerspectiveTransform(srcR, dst);
+                cv::warpPerspective(roiBGR, s.warped, H, cv::Size(P.warpSize, P.warpSize));
+
+                // 5-path cascade
+                GridCheckResult gcr;
+                grid_checks_cascade(s.warped, gcr, P, plan, s.v);
+                validated.fetch_add(1, std::memory_order_relaxed);
+                c.hue = gcr.hue_score;
+                c.verdict = (gcr.hue_score >= P.min_hue_score && gcr.line_ok) ? 1 : -1;
+                if (c.verdict > 0)
+                {
+                    int cur = firstPass.load(std::memory_order_relaxed);
+                    while (i < cur && !firstPass.compare_exchange_weak(cur, i, std::memory_order_relaxed))
+                    {
+                    }
+                }
             }
 
-            // מיזוג best מקומי לגלובלי
-            for (const auto &lb : locals)
+            out.sweep_validated += validated.load();
+            out.sweep_skipped += gated - validated.load();
+            if (debug)
+                mce::log::Debug() << "sweep: " << gated << " of " << out.sweep_scored << " angles gated, "
+                                  << validated.load() << " validated (top-K=" << K << "), cache "
+                                  << out.angle_cache_hits << "/" << out.angle_cache_lookups << " hits";
+
+            const int win = firstPass.load();
+            if (win < K)
             {
-                double sLb = lb.occ * (0.5 + 0.5 * lb.hue);
-                double sGl = best.occ * (0.5 + 0.5 * best.hue);
-                if (sLb > sGl)
-                    best = lb;
+                const Candidate &c = cands[order[win]];
+                loc.found = true;
+                loc.rect = c.tight;
+                loc.angle = c.angle;
+                loc.cov = 100.0 * c.tight.size.width * c.tight.size.height / (double)(bgr.cols * bgr.rows);
+                loc.occ = c.occ;
+                loc.hue = c.hue;
+                loc.line_ok = true;
+                return;
             }
 
-            // early stop if we have a good enough result
-            if (best.occ > 0.78 && best.hue > 0.85 && best.line_ok)
+            // The fallback box is rr itself; if the sweep already warped the
+            // same box at the base angle and it failed, don't warp it again
+            ++out.angle_cache_lookups;
+            const int hit = find_slot(angle_key(baseAngle));
+            if (hit >= 0)
             {
-                earlyStop = true;
-                return true;
+                const Candidate &c = cands[hit];
+                const cv::Point2f dc = c.tight.center - rr.center;
+                if (c.verdict < 0 && std::fabs(dc.x) <= 0.5f && std::fabs(dc.y) <= 0.5f &&
+                    std::fabs(c.tight.size.width - rr.size.width) <= 1.0f &&
+                    std::fabs(c.tight.size.height - rr.size.height) <= 1.0f)
+                {
+                    ++out.angle_cache_hits;
+                    if (debug)
+                        mce::log::Debug() << "No angle passed validation; fallback box already failed (cached)";
+                    return;
+                }
             }
-            return false;
-        };
-
-        if (!scan(P.coarse_step_deg, P.coarse_range_deg))
-            scan(P.fine_step_deg, P.fine_range_deg);
 
-        if (best.cov <= 0.0)
-        {
             if (debug)
             {
-                std::cout << "[DBG] No angle passed validation\n"
-                          << "      (trying direct warp from minAreaRect as fallback)\n";
+                mce::log::Debug() << "No angle passed validation (trying direct warp from minAreaRect as fallback)";
             }
             // Fallback: warp rr as-is
             cv::Point2f rrPts[4];
             rr.points(rrPts);
             cv::Point2f TL, TR, BR, BL;
             order_quad_tl_tr_br_bl(rrPts, TL, TR, BR, BL);
-            std::vector<cv::Point2f> src2 = {TL, TR, BR, BL};
-            std::vector<cv::Point2f> dst2 = {{0, 0}, {(float)P.warpSize - 1, 0}, {(float)P.warpSize - 1, (float)P.warpSize - 1}, {0, (float)P.warpSize - 1}};
+            const std::array<cv::Point2f, 4> src2 = {TL, TR, BR, BL};
+            const std::array<cv::Point2f, 4> dst2 = {{{0, 0}, {(float)P.warpSize - 1, 0}, {(float)P.warpSize - 1, (float)P.warpSize - 1}, {0, (float)P.warpSize - 1}}};
 
             // ROI Fallback: crop around the minAreaRect
             cv::Rect fullRoi = cv::boundingRect(src2);
@@ -908,96 +1491,815 @@ namespace mce
             fullRoi.width = std::min(bgr.cols - fullRoi.x, fullRoi.width + 2 * pad);
             fullRoi.height = std::min(bgr.rows - fullRoi.y, fullRoi.height + 2 * pad);
 
-            std::vector<cv::Point2f> src2R(4);
+            std::array<cv::Point2f, 4> src2R;
             for (int i = 0; i < 4; ++i)
                 src2R[i] = cv::Point2f(src2[i].x - fullRoi.x, src2[i].y - fullRoi.y);
 
+            // The warp stays in slot 0 for the debug writer (copied out when
+            // the slot is reused before emission)
+            ScanScratch &s0 = slots[0];
             cv::Mat roiBGR = bgr(fullRoi);
             cv::Mat H2 = cv::getPerspectiveTransform(src2R, dst2);
-            cv::Mat warped2;
-            cv::warpPerspective(roiBGR, warped2, H2, cv::Size(P.warpSize, P.warpSize));
+            cv::warpPerspective(roiBGR, s0.warped, H2, cv::Size(P.warpSize, P.warpSize));
 
             GridCheckResult gcr2;
-            grid_checks_cascade(warped2, gcr2, P);
+            grid_checks_cascade(s0.warped, gcr2, P, plan, s0.v);
+            ++out.sweep_validated;
             if (gcr2.hue_score >= P.min_hue_score && gcr2.line_ok)
             {
-                double cov2 = 100.0 * (rr.size.width * rr.size.height) / (double)(bgr.cols * bgr.rows);
-                int pct2 = (int)std::lround(std::clamp(cov2, 0.0, 100.0));
-                out.coverage_percent = pct2;
-                out.found = true;
-                out.best_angle_deg = baseAngle;
-                out.occupancy = 1.0;
-                out.hue_score = gcr2.hue_score;
-                out.line_ok = true;
+                if (keepWarp)
+                    s0.warped.copyTo(loc.warp);
+                loc.found = true;
+                loc.fallback = true;
+                loc.rect = rr;
+                loc.angle = baseAngle;
+                loc.cov = 100.0 * (rr.size.width * rr.size.height) / (double)(bgr.cols * bgr.rows);
+                loc.occ = 1.0;
+                loc.hue = gcr2.hue_score;
+                loc.line_ok = true;
+                return;
+            }
+            if (debug)
+                mce::log::Debug() << "Fallback also failed (hue=" << gcr2.hue_score << ", line=no)";
+        }
 
-                if (saveDebug)
+        // Pre-sweep gate: hue richness of the component's own pixels (`mask`
+        // is the component mask over `box`), on the same 18 bins and S > 40
+        // rule as compute_hue_score. A marker shows several hues; a
+        // component with fewer than gate_min_hues bins holding gate_min_share
+        // of its area is rejected before any per-angle work. Background
+        // inside the bounding box does not count. Counted in out.gate_rejected.
+        static bool hue_gate(const cv::Mat &bgr, cv::Rect box, const cv::Mat &mask, int area,
+                             const DetectOptions &opt, cv::Mat &hsvBuf, DetectOutput &out, bool debug)
+        {
+            if (opt.gate_min_hues <= 0)
+                return true;
+            cv::Mat hsv = view_of(hsvBuf, bgr.size(), box.size(), CV_8UC3);
+            cv::cvtColor(bgr(box), hsv, cv::COLOR_BGR2HSV);
+
+            const int bins = 18;
+            int hist[bins] = {0};
+            for (int y = 0; y < hsv.rows; ++y)
+            {
+                const uchar *row = hsv.ptr<uchar>(y);
+                const uchar *in = mask.ptr<uchar>(y);
+                for (int x = 0; x < hsv.cols; ++x, row += 3)
+                    if (in[x] && row[1] > 40)
+                        hist[row[0] * bins / 180]++;
+            }
+            const int thr = std::max(1, (int)std::lround(opt.gate_min_share * area));
+            int distinct = 0;
+            for (int h : hist)
+                distinct += h >= thr;
+            if (debug)
+                mce::log::Debug() << "gate: " << distinct << " hue bins >= " << thr << " px (need "
+                                  << opt.gate_min_hues << ")";
+            if (distinct >= opt.gate_min_hues)
+                return true;
+            ++out.gate_rejected;
+            return false;
+        }
+
+        // Stage 1 into ws.mask (thresholds and mask path recorded in `out`)
+        static void mask_stage(const cv::Mat &bgr, const Params &P, Workspace &ws, DetectOutput &out,
+                               StageClock &clk, bool saveDebug, const std::string &debugBase)
+        {
+            int Smin = 0, Vmin = 0, Vmax = 255;
+            build_color_mask_adaptive(bgr, P, ws, Smin, Vmin, Vmax);
+            out.Smin = Smin;
+            out.Vmin = Vmin;
+            out.Vmax = Vmax;
+            clk.lap(out.stage_ms.mask);
+            if (saveDebug)
+            {
+                out.debug_mask_path = save_artifact(ws, debugBase + "_debug_mask", ws.mask);
+                clk.lap(out.stage_ms.debug_io);
+            }
+        }
+
+        // Stages 1–4 on `bgr`: mask → component → angle sweep (→ fallback warp)
+        static void locate(const cv::Mat &bgr, const Params &P, const DetectOptions &opt,
+                           Workspace &ws, int scanThreads, Located &loc, DetectOutput &out,
+                           StageClock &clk, bool debug, bool saveDebug, const std::string &debugBase)
+        {
+            DetectOutput::StageTimes &st = out.stage_ms;
+
+            // (1) Adaptive color mask
+            mask_stage(bgr, P, ws, out, clk, saveDebug, debugBase);
+            const cv::Mat &mask = ws.mask;
+
+            // (2) Best connected component
+            cv::Rect compBox;
+            if (!largest_component(mask, P.min_comp_area, ws, compBox))
+            {
+                clk.lap(st.component);
+                if (debug)
+                    mce::log::Debug() << "No component";
+                return;
+            }
+            const cv::Mat &comp = ws.comp;
+
+            double compFrac = (double)ws.comps[0].area / std::max(1, bgr.rows * bgr.cols);
+            if (debug)
+                mce::log::Debug() << "compFrac=" << compFrac
+                                  << " (min=" << P.min_comp_frac << ", max=" << P.max_comp_frac << ")";
+            if (compFrac < P.min_comp_frac || compFrac > P.max_comp_frac)
+            {
+                clk.lap(st.component);
+                if (debug)
+                    mce::log::Debug() << "Component frac out of range: " << compFrac;
+                return;
+            }
+            if (!hue_gate(bgr, compBox, comp(compBox), ws.comps[0].area, opt, ws.scan[0].gateHsv, out, debug))
+            {
+                clk.lap(st.component);
+                return;
+            }
+
+            // (3) Base orientation; the sweep works on the component's runs + outline
+            auto &cnts = ws.cnts;
+            cv::findContours(comp(compBox), cnts, cv::RETR_EXTERNAL, cv::CHAIN_APPROX_SIMPLE, compBox.tl());
+            if (cnts.empty())
+            {
+                clk.lap(st.component);
+                return;
+            }
+            MaskShape &shape = ws.shape;
+            shape.size = comp.size();
+            copy_outline(cnts, shape.outline);
+            mask_runs(comp, compBox, shape.runs);
+            clk.lap(st.component);
+
+            sweep_component(bgr, P, opt, plan_validators(opt), shape, ws.scan.data(), scanThreads,
+                            /*keepWarp*/ false, loc, out, clk, debug);
+        }
+
+        // Adds the work counters and stage times of `src` to `dst`
+        static void add_work(DetectOutput &dst, const DetectOutput &src)
+        {
+            dst.sweep_scored += src.sweep_scored;
+            dst.sweep_validated += src.sweep_validated;
+            dst.sweep_skipped += src.sweep_skipped;
+            dst.angle_cache_lookups += src.angle_cache_lookups;
+            dst.angle_cache_hits += src.angle_cache_hits;
+            dst.gate_rejected += src.gate_rejected;
+            DetectOutput::StageTimes &a = dst.stage_ms;
+            const DetectOutput::StageTimes &b = src.stage_ms;
+            a.mask += b.mask;
+            a.component += b.component;
+            a.sweep += b.sweep;
+            a.validate += b.validate;
+            a.refine += b.refine;
+            a.debug_io += b.debug_io;
+        }
+
+        // One component of a multi-marker run
+        struct MarkerSweep
+        {
+            bool ran = false;
+            Located loc;
+            DetectOutput out; // this component's counters / stage times
+        };
+
+        // Multi-marker stages 2–4: every component that passes the size
+        // gates is swept, best score first: with OpenMP one component per
+        // thread (each sweep serial on its own slot), else in sequence on
+        // slot 0. Components not yet started are
+        // skipped once maxMarkers have passed or the budget has run out.
+        static void locate_all(const cv::Mat &bgr, const Params &P, const DetectOptions &opt,
+                               Workspace &ws, int threads, std::vector<MarkerSweep> &res,
+                               DetectOutput &img, StageClock &clk, bool debug, bool keepWarp)
+        {
+            const auto t0 = std::chrono::steady_clock::now();
+            auto &comps = ws.comps;
+            ranked_components(ws.mask, P.min_comp_area, ws, comps);
+            const double total = std::max(1, bgr.rows * bgr.cols);
+            comps.erase(std::remove_if(comps.begin(), comps.end(), [&](const ComponentCandidate &c)
+                                       { return c.area / total < P.min_comp_frac || c.area / total > P.max_comp_frac; }),
+                        comps.end());
+            clk.lap(img.stage_ms.component);
+            res.assign(comps.size(), MarkerSweep{});
+            if (comps.empty())
+            {
+                if (debug)
+                    mce::log::Debug() << "multi: no component in range";
+                return;
+            }
+
+            const ValidatorPlan plan = plan_validators(opt);
+            const int maxMarkers = std::max(1, opt.max_markers);
+            std::atomic<int> found{0};
+#ifdef _OPENMP
+            const int nThreads = std::max(1, std::min(threads, (int)comps.size()));
+#pragma omp parallel for num_threads(nThreads) schedule(dynamic, 1)
+#else
+            (void)threads;
+#endif
+            for (int i = 0; i < (int)comps.size(); ++i)
+            {
+                // Components are handed out in score order, so every skipped
+                // one ranks below all the markers that stopped the run
+                if (found.load(std::memory_order_relaxed) >= maxMarkers)
+                    continue;
+                if (opt.multi_budget_ms > 0 &&
+                    std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count() > opt.multi_budget_ms)
+                    continue;
+#ifdef _OPENMP
+                int tid = omp_get_thread_num();
+#else
+                int tid = 0;
+#endif
+                ScanScratch &s = ws.scan[tid];
+                const ComponentCandidate &c = comps[i];
+                MarkerSweep &r = res[i];
+                r.ran = true;
+                StageClock cclk;
+                cv::Mat comp = view_of(s.comp, bgr.size(), c.box.size(), CV_8U);
+                cv::compare(ws.labels(c.box), (double)c.label, comp, cv::CMP_EQ);
+                if (!hue_gate(bgr, c.box, comp, c.area, opt, s.gateHsv, r.out, debug))
                 {
-                    out.debug_warp_path = debugBase + "_debug_warp.png";
-                    cv::imwrite(out.debug_warp_path, warped2);
-                    cv::Mat vis = bgr.clone();
-                    draw_box(vis, rr, pct2);
-                    out.debug_quad_path = debugBase + "_debug_quad.png";
-                    cv::imwrite(out.debug_quad_path, vis);
+                    cclk.lap(r.out.stage_ms.component);
+                    continue;
+                }
+                cv::findContours(comp, s.cnts, cv::RETR_EXTERNAL, cv::CHAIN_APPROX_SIMPLE, c.box.tl());
+                if (s.cnts.empty())
+                {
+                    cclk.lap(r.out.stage_ms.component);
+                    continue;
                 }
-                out.quad = {TL, TR, BR, BL};
+                s.shape.size = bgr.size();
+                copy_outline(s.cnts, s.shape.outline);
+                mask_runs(comp, cv::Rect(0, 0, comp.cols, comp.rows), s.shape.runs, c.box.tl());
+                cclk.lap(r.out.stage_ms.component);
+
+                sweep_component(bgr, P, opt, plan, s.shape, &s, 1, keepWarp, r.loc, r.out, cclk, debug);
+                if (r.loc.found)
+                    found.fetch_add(1, std::memory_order_relaxed);
+            }
+
+            // Sweep times are per marker (they overlap across threads); the
+            // region's wall time is only logged
+            double wallMs = 0;
+            clk.lap(wallMs);
+            if (debug)
+            {
+                int ran = 0;
+                for (const MarkerSweep &r : res)
+                    ran += r.ran;
+                mce::log::Debug() << "multi: " << comps.size() << " components, " << ran << " swept, "
+                                  << found.load() << " passed (max=" << maxMarkers << "), " << wallMs << " ms";
+            }
+        }
+
+        // Power-of-two downscale that keeps the long side >= minSide (1 = off)
+        static int pyramid_factor(cv::Size sz, int minSide)
+        {
+            const int longSide = std::max(sz.width, sz.height);
+            int f = 1;
+            while (minSide > 0 && longSide / (f * 2) >= minSide)
+                f *= 2;
+            return f;
+        }
+
+        // Maps a box found on `small` back to `bgr` and re-tightens it against
+        // the full-res mask inside a padded ROI. False when the refined
+        // coverage drifts more than tolPct from the coarse one.
+        static bool refine_full_res(const cv::Mat &bgr, const cv::Mat &small, const Params &P,
+                                    Workspace &ws, int Smin, int Vmin, int Vmax,
+                                    double tolPct, Located &loc, bool debug)
+        {
+            const double sx = (double)bgr.cols / small.cols;
+            const double sy = (double)bgr.rows / small.rows;
+            const double s = 0.5 * (sx + sy);
+            const cv::RotatedRect &c = loc.rect;
+            const cv::Point2f center((float)(c.center.x * sx), (float)(c.center.y * sy));
+
+            if (loc.fallback)
+            {
+                // minAreaRect as-is: nothing to tighten, just rescale
+                loc.rect = cv::RotatedRect(center, cv::Size2f((float)(c.size.width * s), (float)(c.size.height * s)), c.angle);
                 return true;
             }
+
+            // Search box: the coarse box grown by a few small-image pixels
+            const float margin = 3.0f;
+            cv::RotatedRect search(center,
+                                   cv::Size2f((float)((c.size.width + 2 * margin) * s),
+                                              (float)((c.size.height + 2 * margin) * s)),
+                                   c.angle);
+            cv::Rect roi = search.boundingRect() & cv::Rect(0, 0, bgr.cols, bgr.rows);
+            if (roi.width < 2 || roi.height < 2)
+                return false;
+
+            // Same thresholds, same kernel sizes as a full-res run
+            cv::Mat mask = view_of(ws.roiMask, bgr.size(), roi.size(), CV_8U);
+            band_mask(bgr(roi), Smin, Vmin, Vmax, bgr.size(), P, mask, ws.roiKernels);
+
+            auto &cnts = ws.cnts;
+            cv::findContours(mask, cnts, cv::RETR_EXTERNAL, cv::CHAIN_APPROX_SIMPLE);
+            if (cnts.empty())
+                return false;
+            MaskShape &shape = ws.shape;
+            shape.size = mask.size();
+            copy_outline(cnts, shape.outline);
+            mask_runs(mask, cv::Rect(0, 0, mask.cols, mask.rows), shape.runs);
+
+            search.center -= cv::Point2f((float)roi.x, (float)roi.y);
+            cv::RotatedRect tight;
+            double occ = 0.0, fill = 0.0;
+            if (!rotate_and_tighten(shape, search, loc.angle, tight, occ, fill, ws.scan[0]))
+                return false;
+            tight.center += cv::Point2f((float)roi.x, (float)roi.y);
+
+            const double cov = 100.0 * tight.size.width * tight.size.height / (double)(bgr.cols * bgr.rows);
             if (debug)
-                std::cout << "[DBG] Fallback also failed (hue=" << gcr2.hue_score << ", line=no)\n";
+                mce::log::Debug() << "pyramid refine: coverage " << loc.cov << " -> " << cov
+                                  << " (tol=" << tolPct << ")";
+            if (std::fabs(cov - loc.cov) > tolPct)
+                return false;
+
+            loc.rect = tight;
+            loc.cov = cov;
             return true;
         }
 
-        // (5) Emit result
-        int pct = (int)std::lround(std::clamp(best.cov, 0.0, 100.0));
-        out.coverage_percent = pct;
-        out.found = true;
+        // Tracking: stages 1–4 inside a padded ROI around the prior quad, with
+        // the prior's thresholds (no histogram pass) and a narrow sweep around
+        // its angle. False when nothing passes or the component is cut by the
+        // ROI edge (the marker moved out, its box would be clipped). Saves no
+        // artifacts: the caller does once it keeps the result.
+        static bool locate_tracked(const cv::Mat &bgr, const Params &P, const DetectOptions &opt,
+                                   const TrackPrior &prior, Workspace &ws, int scanThreads,
+                                   Located &loc, DetectOutput &out, StageClock &clk, bool debug)
+        {
+            DetectOutput::StageTimes &st = out.stage_ms;
+            const cv::Rect box = cv::boundingRect(prior.quad);
+            const int pad = std::max(4, (int)std::lround(opt.track_pad * std::max(box.width, box.height)));
+            const cv::Rect frame(0, 0, bgr.cols, bgr.rows);
+            const cv::Rect roi = cv::Rect(box.x - pad, box.y - pad, box.width + 2 * pad, box.height + 2 * pad) & frame;
+            if (roi.width < 2 || roi.height < 2)
+                return false;
+
+            // (1) ROI mask, same kernel sizes as a full-frame run
+            cv::Mat mask = view_of(ws.roiMask, bgr.size(), roi.size(), CV_8U);
+            band_mask(bgr(roi), prior.Smin, prior.Vmin, prior.Vmax, bgr.size(), P, mask, ws.roiKernels);
+            out.Smin = prior.Smin;
+            out.Vmin = prior.Vmin;
+            out.Vmax = prior.Vmax;
+            clk.lap(st.mask);
+
+            // (2) Best component of the ROI
+            LapOnExit componentLap{clk, st.component};
+            cv::Rect compBox;
+            if (!largest_component(mask, P.min_comp_area, ws, compBox))
+                return false;
+            const double compFrac = (double)ws.comps[0].area / std::max(1, bgr.rows * bgr.cols);
+            const bool cut = (compBox.x == 0 && roi.x > 0) || (compBox.y == 0 && roi.y > 0) ||
+                             (compBox.br().x == roi.width && roi.br().x < bgr.cols) ||
+                             (compBox.br().y == roi.height && roi.br().y < bgr.rows);
+            if (debug)
+                mce::log::Debug() << "track: roi=" << roi.width << "x" << roi.height << " compFrac=" << compFrac
+                                  << (cut ? " (cut by the ROI edge)" : "");
+            if (cut || compFrac < P.min_comp_frac || compFrac > P.max_comp_frac)
+                return false;
+            const cv::Rect frameBox = compBox + roi.tl();
+            if (!hue_gate(bgr, frameBox, ws.comp(compBox), ws.comps[0].area, opt, ws.scan[0].gateHsv, out, debug))
+                return false;
 
-        out.best_angle_deg = best.angle;
-        out.occupancy = best.occ;
-        out.hue_score = best.hue;
-        out.line_ok = best.line_ok;
+            // (3) Runs + outline in frame coordinates
+            auto &cnts = ws.cnts;
+            cv::findContours(ws.comp(compBox), cnts, cv::RETR_EXTERNAL, cv::CHAIN_APPROX_SIMPLE, compBox.tl() + roi.tl());
+            if (cnts.empty())
+                return false;
+            MaskShape &shape = ws.shape;
+            shape.size = bgr.size();
+            copy_outline(cnts, shape.outline);
+            mask_runs(ws.comp, compBox, shape.runs, roi.tl());
+            clk.lap(st.component);
+
+            // (4) ±track_angle_range in 1° steps around the prior angle
+            Params Pt = P;
+            Pt.coarse_step_deg = 1;
+            Pt.coarse_range_deg = std::max(0, opt.track_angle_range);
+            Pt.fine_range_deg = 0;
+            sweep_component(bgr, Pt, opt, plan_validators(opt), shape, ws.scan.data(), scanThreads,
+                            /*keepWarp*/ false, loc, out, clk, debug, prior.angle);
+            return loc.found;
+        }
 
-        if (saveDebug)
+        // "<debugBase>_debug_mask" re-built at full resolution from out's
+        // thresholds: for results whose mask stage did not run on the full
+        // frame (pyramid hit, tracked ROI) and for render_debug
+        static void save_full_mask(const cv::Mat &bgr, const Params &P, Workspace &ws, DetectOutput &out,
+                                   const std::string &debugBase)
         {
-            cv::Mat vis = bgr.clone();
-            draw_box(vis, best.tight, pct);
-            out.debug_quad_path = debugBase + "_debug_quad.png";
-            cv::imwrite(out.debug_quad_path, vis);
+            // Own buffer: ws.mask may be pyramid-sized, and swapping its
+            // size here would reallocate it on every call
+            cv::Mat fresh;
+            cv::Mat &mask = render_target(ws, ws.renderMask, fresh);
+            band_mask(bgr, out.Smin, out.Vmin, out.Vmax, bgr.size(), P, mask, ws.kernels);
+            out.debug_mask_path = save_rendered(ws, debugBase + "_debug_mask", mask);
+        }
+
+        // Quad overlay, natural-size crop and clipped polygon for a marker
+        // whose out.quad (TL,TR,BR,BL) is set
+        static void marker_artifacts(const cv::Mat &bgr, const cv::RotatedRect &rect, int pct,
+                                     Workspace &ws, DetectOutput &out, const std::string &debugBase)
+        {
+            const cv::Point2f TL = out.quad[0], TR = out.quad[1], BR = out.quad[2], BL = out.quad[3];
+            cv::Mat freshVis, freshCrop, freshClip;
+            cv::Mat &vis = render_target(ws, ws.vis, freshVis);
+            render_quad(bgr, rect, pct, ws, vis);
+            out.debug_quad_path = save_rendered(ws, debugBase + "_debug_quad", vis);
 
             // perspective-corrected crop (natural size)
-            cv::Point2f pts[4];
-            best.tight.points(pts);
-            cv::Point2f TL, TR, BR, BL;
-            order_quad_tl_tr_br_bl(pts, TL, TR, BR, BL);
-            int dstW = std::max(20, (int)std::lround(best.tight.size.width));
-            int dstH = std::max(20, (int)std::lround(best.tight.size.height));
-            std::vector<cv::Point2f> srcVec = {TL, TR, BR, BL};
-            std::vector<cv::Point2f> dst = {{0.0f, 0.0f}, {(float)dstW - 1, 0.0f}, {(float)dstW - 1, (float)dstH - 1}, {0.0f, (float)dstH - 1}};
+            int dstW = std::max(20, (int)std::lround(rect.size.width));
+            int dstH = std::max(20, (int)std::lround(rect.size.height));
+            const std::array<cv::Point2f, 4> srcVec = {TL, TR, BR, BL};
+            const std::array<cv::Point2f, 4> dst = {{{0.0f, 0.0f}, {(float)dstW - 1, 0.0f}, {(float)dstW - 1, (float)dstH - 1}, {0.0f, (float)dstH - 1}}};
             cv::Mat Hnat = cv::getPerspectiveTransform(srcVec, dst);
-            cv::Mat crop;
+            cv::Mat &crop = render_target(ws, ws.crop, freshCrop);
             cv::warpPerspective(bgr, crop, Hnat, cv::Size(dstW, dstH), cv::INTER_LINEAR, cv::BORDER_REPLICATE);
-            out.debug_crop_path = debugBase + "_debug_crop.png";
-            cv::imwrite(out.debug_crop_path, crop);
+            out.debug_crop_path = save_rendered(ws, debugBase + "_debug_crop", crop);
 
-            cv::Mat polyMask = cv::Mat::zeros(bgr.size(), CV_8U);
-            std::vector<cv::Point> q = {
+            ws.polyMask.create(bgr.size(), CV_8U);
+            ws.polyMask.setTo(0);
+            const std::array<cv::Point, 4> q = {
                 cv::Point((int)std::lround(TL.x), (int)std::lround(TL.y)),
                 cv::Point((int)std::lround(TR.x), (int)std::lround(TR.y)),
                 cv::Point((int)std::lround(BR.x), (int)std::lround(BR.y)),
                 cv::Point((int)std::lround(BL.x), (int)std::lround(BL.y))};
-            cv::fillConvexPoly(polyMask, q, 255);
-            cv::Mat clipped;
-            bgr.copyTo(clipped, polyMask);
-            out.debug_clip_path = debugBase + "_debug_clip.png";
-            cv::imwrite(out.debug_clip_path, clipped);
+            cv::fillConvexPoly(ws.polyMask, q, 255);
+            cv::Mat &clipped = render_target(ws, ws.clipped, freshClip);
+            clipped.create(bgr.size(), bgr.type());
+            clipped.setTo(0); // reused buffer: a masked copy only writes inside the quad
+            bgr.copyTo(clipped, ws.polyMask);
+            out.debug_clip_path = save_rendered(ws, debugBase + "_debug_clip", clipped);
+        }
+
+        // Clears `out` for a new call; quad keeps its capacity so a reused
+        // DetectOutput does not reallocate it
+        static void reset_output(DetectOutput &out)
+        {
+            std::vector<cv::Point2f> quad;
+            quad.swap(out.quad);
+            out = DetectOutput{};
+            quad.clear();
+            out.quad.swap(quad);
+        }
+
+        // (5) Result fields + debug artifacts for a located marker.
+        // `fallbackWarp` is the warp a fallback box was validated on.
+        static void emit(const cv::Mat &bgr, const Located &loc, const cv::Mat &fallbackWarp,
+                         Workspace &ws, DetectOutput &out, bool saveDebug, const std::string &debugBase)
+        {
+            cv::Point2f pts[4];
+            loc.rect.points(pts);
+            cv::Point2f TL, TR, BR, BL;
+            order_quad_tl_tr_br_bl(pts, TL, TR, BR, BL);
+
+            if (loc.fallback)
+            {
+                int pct2 = (int)std::lround(std::clamp(loc.cov, 0.0, 100.0));
+                out.coverage_percent = pct2;
+                out.found = true;
+                out.best_angle_deg = loc.angle;
+                out.occupancy = loc.occ;
+                out.hue_score = loc.hue;
+                out.line_ok = true;
+
+                if (saveDebug)
+                {
+                    out.debug_warp_path = save_artifact(ws, debugBase + "_debug_warp", fallbackWarp);
+                    cv::Mat fresh;
+                    cv::Mat &vis = render_target(ws, ws.vis, fresh);
+                    render_quad(bgr, loc.rect, pct2, ws, vis);
+                    out.debug_quad_path = save_rendered(ws, debugBase + "_debug_quad", vis);
+                }
+                out.quad.assign({TL, TR, BR, BL});
+                return;
+            }
+
+            int pct = (int)std::lround(std::clamp(loc.cov, 0.0, 100.0));
+            out.coverage_percent = pct;
+            out.found = true;
+
+            out.best_angle_deg = loc.angle;
+            out.occupancy = loc.occ;
+            out.hue_score = loc.hue;
+            out.line_ok = loc.line_ok;
+
+            out.quad.assign({TL, TR, BR, BL});
+            if (saveDebug)
+                marker_artifacts(bgr, loc.rect, pct, ws, out, debugBase);
+        }
+
+    } // namespace (anon)
+
+    // ============================== Public API ==============================
+    bool angle_scan_is_parallel()
+    {
+#ifdef _OPENMP
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    const char *validator_name(Validator v)
+    {
+        const int k = (int)v;
+        return (k >= 0 && k < kValidatorCount) ? kValidators[k].name : "?";
+    }
+
+    bool validator_enabled(const DetectOptions &opt, Validator v)
+    {
+        if (v == Validator::KMeans)
+            return opt.kmeans_validator;
+        if (v == Validator::Palette)
+            return !opt.kmeans_validator;
+        return true;
+    }
+
+    bool parse_validator_order(const std::string &spec, std::vector<Validator> &order)
+    {
+        order.clear();
+        if (spec == "adaptive")
+            return true;
+        if (spec == "fixed")
+        {
+            for (int k = 0; k < kValidatorCount; ++k)
+                order.push_back((Validator)k);
+            return true;
+        }
+        std::stringstream ss(spec);
+        std::string name;
+        while (std::getline(ss, name, ','))
+        {
+            int k = 0;
+            while (k < kValidatorCount && name != kValidators[k].name)
+                ++k;
+            if (k == kValidatorCount)
+                return false;
+            order.push_back((Validator)k);
+        }
+        return !order.empty();
+    }
+
+    ValidatorStats validator_stats(Validator v)
+    {
+        const ValidatorCounters &c = g_validatorStats[(int)v];
+        ValidatorStats st;
+        st.runs = c.runs.load(std::memory_order_relaxed);
+        st.passes = c.passes.load(std::memory_order_relaxed);
+        st.total_ms = c.nanos.load(std::memory_order_relaxed) / 1e6;
+        return st;
+    }
+
+    void reset_validator_stats()
+    {
+        for (ValidatorCounters &c : g_validatorStats)
+        {
+            c.runs = 0;
+            c.passes = 0;
+            c.nanos = 0;
         }
+    }
+
+    std::vector<Validator> adaptive_validator_order()
+    {
+        std::array<Validator, kValidatorCount> order;
+        adaptive_order(order);
+        return std::vector<Validator>(order.begin(), order.end());
+    }
+
+    Detector::Detector(DetectOptions opt) : opt_(opt), ws_(std::make_unique<Workspace>()) {}
+    Detector::~Detector() = default;
+    Detector::Detector(Detector &&) noexcept = default;
+    Detector &Detector::operator=(Detector &&) noexcept = default;
+
+    void Detector::set_debug_sink(DebugSink *sink)
+    {
+        ws_->sink = sink;
+    }
+
+    std::size_t Detector::workspace_allocations() const
+    {
+        return ws_->counter.count();
+    }
+
+    bool detect_and_compute(const cv::Mat &bgr,
+                            DetectOutput &out,
+                            bool debug,
+                            bool saveDebug,
+                            const std::string &debugBase)
+    {
+        return detect_and_compute(bgr, out, DetectOptions{}, debug, saveDebug, debugBase);
+    }
 
-        cv::Point2f pts[4];
-        best.tight.points(pts);
-        cv::Point2f TL, TR, BR, BL;
-        order_quad_tl_tr_br_bl(pts, TL, TR, BR, BL);
-        out.quad = {TL, TR, BR, BL};
+    bool detect_and_compute(const cv::Mat &bgr,
+                            DetectOutput &out,
+                            const DetectOptions &opt,
+                            bool debug,
+                            bool saveDebug,
+                            const std::string &debugBase)
+    {
+        // One warm workspace per calling thread
+        thread_local Detector det;
+        det.set_options(opt);
+        return det.detect(bgr, out, debug, saveDebug, debugBase);
+    }
+
+    bool Detector::detect(const cv::Mat &bgr,
+                          DetectOutput &out,
+                          bool debug,
+                          bool saveDebug,
+                          const std::string &debugBase)
+    {
+        reset_output(out);
+        if (bgr.empty())
+            return true;
+
+        const Params P = params_for(opt_.input_scale);
+        Workspace &ws = *ws_;
+
+#ifdef _OPENMP
+        const int scanThreads = opt_.scan_threads > 0 ? opt_.scan_threads : omp_get_max_threads();
+#else
+        const int scanThreads = 1;
+#endif
+        ws.ensure_scan_threads(scanThreads);
+
+        // (1–4) Locate: on a downscaled copy in pyramid mode, refined at full
+        // resolution; any miss or coverage drift re-runs at full resolution.
+        // The coarse pass is provisional and saves nothing: the mask is saved
+        // once, by the full-res pass or re-built for a pyramid hit below.
+        StageClock clk;
+        Located loc;
+        bool maskSaved = true; // the returned pass ran its mask stage on bgr
+        const int f = opt_.pyramid ? pyramid_factor(bgr.size(), opt_.pyramid_min_side) : 1;
+        if (f > 1)
+        {
+            cv::resize(bgr, ws.small, cv::Size(bgr.cols / f, bgr.rows / f), 0, 0, cv::INTER_AREA);
+            clk.lap(out.stage_ms.refine);
+            if (debug)
+                mce::log::Debug() << "pyramid 1/" << f << ": " << ws.small.cols << "x" << ws.small.rows;
+            locate(ws.small, params_for(opt_.input_scale * f), opt_, ws, scanThreads, loc, out, clk, debug,
+                   /*saveDebug*/ false, debugBase);
+            const bool refined = loc.found && refine_full_res(bgr, ws.small, P, ws, out.Smin, out.Vmin, out.Vmax,
+                                                              opt_.pyramid_tolerance, loc, debug);
+            clk.lap(out.stage_ms.refine);
+            if (refined)
+            {
+                out.scale_factor = f;
+                maskSaved = false;
+            }
+            else
+            {
+                if (debug)
+                    mce::log::Debug() << "pyramid " << (loc.found ? "drift" : "miss")
+                                      << "; re-running at full resolution";
+                loc = Located{};
+                locate(bgr, P, opt_, ws, scanThreads, loc, out, clk, debug, saveDebug, debugBase);
+            }
+        }
+        else
+        {
+            locate(bgr, P, opt_, ws, scanThreads, loc, out, clk, debug, saveDebug, debugBase);
+        }
+        // Everything below is result emission + debug artifacts
+        LapOnExit ioLap{clk, out.stage_ms.debug_io};
+        if (saveDebug && !maskSaved)
+            save_full_mask(bgr, P, ws, out, debugBase);
+        if (loc.found)
+            emit(bgr, loc, ws.scan[0].warped, ws, out, saveDebug, debugBase);
+        return true;
+    }
+
+    void Detector::render_debug(const cv::Mat &bgr, DetectOutput &out,
+                                const std::string &maskBase, const std::string &markerBase)
+    {
+        if (bgr.empty())
+            return;
+        const Params P = params_for(opt_.input_scale);
+        Workspace &ws = *ws_;
+        StageClock clk;
+        LapOnExit ioLap{clk, out.stage_ms.debug_io};
+        if (!maskBase.empty())
+            save_full_mask(bgr, P, ws, out, maskBase);
+        if (out.found && out.quad.size() == 4)
+            marker_artifacts(bgr, cv::minAreaRect(out.quad), out.coverage_percent, ws, out, markerBase);
+    }
+
+    TrackPrior track_prior(const DetectOutput &out)
+    {
+        TrackPrior p;
+        if (!out.found || out.quad.size() != 4)
+            return p;
+        p.valid = true;
+        p.quad = out.quad;
+        p.angle = out.best_angle_deg;
+        p.Smin = out.Smin;
+        p.Vmin = out.Vmin;
+        p.Vmax = out.Vmax;
+        return p;
+    }
+
+    bool Detector::detect(const cv::Mat &bgr,
+                          const TrackPrior &prior,
+                          DetectOutput &out,
+                          bool debug,
+                          bool saveDebug,
+                          const std::string &debugBase)
+    {
+        if (!prior.valid || bgr.empty())
+            return detect(bgr, out, debug, saveDebug, debugBase);
+
+        reset_output(out);
+        const Params P = params_for(opt_.input_scale);
+        Workspace &ws = *ws_;
+#ifdef _OPENMP
+        const int scanThreads = opt_.scan_threads > 0 ? opt_.scan_threads : omp_get_max_threads();
+#else
+        const int scanThreads = 1;
+#endif
+        ws.ensure_scan_threads(scanThreads);
+
+        StageClock clk;
+        Located loc;
+        if (locate_tracked(bgr, P, opt_, prior, ws, scanThreads, loc, out, clk, debug))
+        {
+            out.tracked = true;
+            LapOnExit ioLap{clk, out.stage_ms.debug_io};
+            if (saveDebug)
+                save_full_mask(bgr, P, ws, out, debugBase);
+            emit(bgr, loc, ws.scan[0].warped, ws, out, saveDebug, debugBase);
+            return true;
+        }
+
+        // Lost track: full detection; the attempt's work stays on the books
+        if (debug)
+            mce::log::Debug() << "track: lost, running a full detection";
+        DetectOutput attempt = std::move(out);
+        const bool ok = detect(bgr, out, debug, saveDebug, debugBase);
+        add_work(out, attempt);
+        return ok;
+    }
+
+    bool Detector::detect_all(const cv::Mat &bgr,
+                              std::vector<DetectOutput> &outs,
+                              bool debug,
+                              bool saveDebug,
+                              const std::string &debugBase)
+    {
+        outs.assign(1, DetectOutput{});
+        if (bgr.empty())
+            return true;
+
+        const Params P = params_for(opt_.input_scale);
+        Workspace &ws = *ws_;
+
+#ifdef _OPENMP
+        const int threads = opt_.scan_threads > 0 ? opt_.scan_threads : omp_get_max_threads();
+#else
+        const int threads = 1;
+#endif
+        ws.ensure_scan_threads(threads);
+
+        // (1) one mask for the whole image, (2–4) every component
+        StageClock clk;
+        DetectOutput img; // image-level work: mask, labeling, components that did not pass
+        mask_stage(bgr, P, ws, img, clk, saveDebug, debugBase);
+        std::vector<MarkerSweep> res;
+        locate_all(bgr, P, opt_, ws, threads, res, img, clk, debug, /*keepWarp*/ saveDebug);
+
+        // Markers in component score order, at most max_markers
+        outs.clear();
+        const size_t maxMarkers = (size_t)std::max(1, opt_.max_markers);
+        for (MarkerSweep &r : res)
+        {
+            if (!r.loc.found || outs.size() == maxMarkers)
+            {
+                add_work(img, r.out);
+                continue;
+            }
+            DetectOutput &out = outs.emplace_back(std::move(r.out));
+            StageClock ioClk;
+            LapOnExit ioLap{ioClk, out.stage_ms.debug_io};
+            out.Smin = img.Smin;
+            out.Vmin = img.Vmin;
+            out.Vmax = img.Vmax;
+            out.debug_mask_path = img.debug_mask_path;
+            emit(bgr, r.loc, r.loc.warp, ws, out, saveDebug,
+                 debugBase + "_m" + std::to_string(outs.size()));
+        }
 
+        // Shared work is charged to the first entry (the only one when
+        // nothing passed)
+        if (outs.empty())
+            outs.push_back(std::move(img));
+        else
+            add_work(outs[0], img);
         return true;
     }
 
@@ -0,0 +1,94 @@
+// src/grid_ops.cpp — grid validator primitives (cut-pair search, template correlation)
+#include "mce/grid_ops.hpp"
+
+#include <opencv2/imgproc.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+namespace mce::grid
+{
+    bool best_cut_pair(const std::vector<float> &p, int minsep, int &a, int &b, std::vector<int> &suf)
+    {
+        const int n = (int)p.size();
+        a = -1;
+        b = -1;
+        minsep = std::max(0, minsep);
+        if (minsep >= n)
+            return false;
+        suf.resize(n);
+        suf[n - 1] = n - 1;
+        for (int k = n - 2; k >= 0; --k)
+            suf[k] = p[k] >= p[suf[k + 1]] ? k : suf[k + 1];
+
+        float best = -1.f;
+        for (int i = 0; i + minsep < n; ++i)
+        {
+            const int j = suf[i + minsep];
+            const float sum = p[i] + p[j];
+            if (sum > best)
+            {
+                best = sum;
+                a = i;
+                b = j;
+            }
+        }
+        return a >= 0;
+    }
+
+    void make_grid_template(cv::Size size, GridTemplate &gt)
+    {
+        cv::Mat &templ = gt.t;
+        templ.create(size, CV_32F);
+        templ.setTo(0);
+        const int W = templ.cols, H = templ.rows;
+        auto draw_v = [&](int x)
+        { cv::line(templ, {x, 0}, {x, H - 1}, 1.0f, 2, cv::LINE_AA); };
+        auto draw_h = [&](int y)
+        { cv::line(templ, {0, y}, {W - 1, y}, 1.0f, 2, cv::LINE_AA); };
+        draw_v(W / 3);
+        draw_v(2 * W / 3);
+        draw_h(H / 3);
+        draw_h(2 * H / 3);
+
+        double st = 0, stt = 0;
+        for (int y = 0; y < H; ++y)
+        {
+            const float *tr = templ.ptr<float>(y);
+            for (int x = 0; x < W; ++x)
+            {
+                st += tr[x];
+                stt += (double)tr[x] * tr[x];
+            }
+        }
+        gt.sum = st;
+        gt.centSq = stt - st * st / ((double)W * H);
+    }
+
+    double template_corr(const cv::Mat &mag, const GridTemplate &gt)
+    {
+        CV_Assert(mag.type() == CV_32F && mag.size() == gt.t.size());
+        // Σm, Σm², Σt·m in one pass, on m − m(0,0): the shift leaves the
+        // correlation unchanged, but a constant mag then sums to exactly 0
+        // instead of leaving rounding noise in Σm² − (Σm)²/N
+        const double m0 = mag.empty() ? 0.0 : mag.at<float>(0, 0);
+        double sm = 0, smm = 0, stm = 0;
+        for (int y = 0; y < mag.rows; ++y)
+        {
+            const float *mr = mag.ptr<float>(y);
+            const float *tr = gt.t.ptr<float>(y);
+            for (int x = 0; x < mag.cols; ++x)
+            {
+                const double m = mr[x] - m0;
+                sm += m;
+                smm += m * m;
+                stm += tr[x] * m;
+            }
+        }
+        const double N = (double)mag.rows * mag.cols;
+        const double num = stm - gt.sum * sm / N;
+        const double den = std::sqrt(std::max(0.0, smm - sm * sm / N) * std::max(0.0, gt.centSq));
+        return den > 1e-12 ? num / den : 0.0; // flat image: matchTemplate gives 0 too
+    }
+
+} // namespace mce::grid
@@ -0,0 +1,557 @@
+// src/hsv_kernel.cpp — fused BGR→HSV histogram / band-mask kernels (scalar + SIMD)
+#include "mce/hsv_kernel.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define MCE_HSV_X86 1
+#include <immintrin.h>
+#define MCE_TARGET_SSE41 __attribute__((target("sse4.1")))
+#define MCE_TARGET_AVX2 __attribute__((target("avx2")))
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#define MCE_HSV_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace mce::hsv
+{
+    namespace
+    {
+        // OpenCV RGB2HSV_b fixed point: s = diff * sdiv[v], h = n * hdiv[diff]
+        constexpr int kShift = 12;
+        constexpr int kHalf = 1 << (kShift - 1);
+        constexpr float kSNum = 255 << kShift;       // sdiv[v] = round(kSNum / v)
+        constexpr float kHNum = (180 << kShift) / 6; // hdiv[d] = round(kHNum / d)
+
+        struct Tables
+        {
+            int sdiv[256];
+            int hdiv[256];
+            Tables()
+            {
+                sdiv[0] = hdiv[0] = 0;
+                for (int i = 1; i < 256; ++i)
+                {
+                    sdiv[i] = (int)std::lrint((255 << kShift) / (1. * i));
+                    hdiv[i] = (int)std::lrint((180 << kShift) / (6. * i));
+                }
+            }
+        };
+
+        const Tables &tables()
+        {
+            static const Tables t;
+            return t;
+        }
+
+        // ------------------------------ Scalar reference ------------------------------
+        inline void hsv_px(int b, int g, int r, const Tables &t, int &h, int &s, int &v)
+        {
+            v = std::max(std::max(b, g), r);
+            const int diff = v - std::min(std::min(b, g), r);
+            const int vr = v == r ? -1 : 0;
+            const int vg = v == g ? -1 : 0;
+            s = (diff * t.sdiv[v] + kHalf) >> kShift;
+            int hh = (vr & (g - b)) + (~vr & ((vg & (b - r + 2 * diff)) + ((~vg) & (r - g + 4 * diff))));
+            hh = (hh * t.hdiv[diff] + kHalf) >> kShift;
+            h = hh + (hh < 0 ? 180 : 0);
+        }
+
+        inline bool in_band(int h, int s, int v, const BandSpec &b)
+        {
+            if (s < b.smin || v < b.vmin || v > b.vmax)
+                return false;
+            for (int k = 0; k < b.nHue; ++k)
+                if (h >= b.hueLo[k] && h <= b.hueHi[k])
+                    return true;
+            return false;
+        }
+
+        void hist_row_scalar(const uchar *src, int n, SVHist &hist)
+        {
+            const Tables &t = tables();
+            for (int x = 0; x < n; ++x, src += 3)
+            {
+                int h, s, v;
+                hsv_px(src[0], src[1], src[2], t, h, s, v);
+                hist.s[s]++;
+                hist.v[v]++;
+            }
+        }
+
+        void band_row_scalar(const uchar *src, uchar *dst, int n, const BandSpec &b)
+        {
+            const Tables &t = tables();
+            for (int x = 0; x < n; ++x, src += 3)
+            {
+                int h, s, v;
+                hsv_px(src[0], src[1], src[2], t, h, s, v);
+                dst[x] = in_band(h, s, v, b) ? 255 : 0;
+            }
+        }
+
+#ifdef MCE_HSV_X86
+        // ------------------------------ SSE4.1 ------------------------------
+        // 16 packed BGR pixels (48 bytes) → one register per channel
+        MCE_TARGET_SSE41 inline void deinterleave16(const uchar *p, __m128i &B, __m128i &G, __m128i &R)
+        {
+            const __m128i a = _mm_loadu_si128((const __m128i *)p);
+            const __m128i b = _mm_loadu_si128((const __m128i *)(p + 16));
+            const __m128i c = _mm_loadu_si128((const __m128i *)(p + 32));
+            B = _mm_or_si128(_mm_or_si128(
+                                 _mm_shuffle_epi8(a, _mm_setr_epi8(0, 3, 6, 9, 12, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1)),
+                                 _mm_shuffle_epi8(b, _mm_setr_epi8(-1, -1, -1, -1, -1, -1, 2, 5, 8, 11, 14, -1, -1, -1, -1, -1))),
+                             _mm_shuffle_epi8(c, _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 1, 4, 7, 10, 13)));
+            G = _mm_or_si128(_mm_or_si128(
+                                 _mm_shuffle_epi8(a, _mm_setr_epi8(1, 4, 7, 10, 13, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1)),
+                                 _mm_shuffle_epi8(b, _mm_setr_epi8(-1, -1, -1, -1, -1, 0, 3, 6, 9, 12, 15, -1, -1, -1, -1, -1))),
+                             _mm_shuffle_epi8(c, _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 2, 5, 8, 11, 14)));
+            R = _mm_or_si128(_mm_or_si128(
+                                 _mm_shuffle_epi8(a, _mm_setr_epi8(2, 5, 8, 11, 14, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1)),
+                                 _mm_shuffle_epi8(b, _mm_setr_epi8(-1, -1, -1, -1, -1, 1, 4, 7, 10, 13, -1, -1, -1, -1, -1, -1))),
+                             _mm_shuffle_epi8(c, _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 0, 3, 6, 9, 12, 15)));
+        }
+
+        // S for 4 lanes (int32); the division rebuilds sdiv[v] exactly
+        MCE_TARGET_SSE41 inline __m128i s_sse(__m128i v, __m128i d)
+        {
+            const __m128i sdiv = _mm_cvtps_epi32(_mm_div_ps(_mm_set1_ps(kSNum), _mm_cvtepi32_ps(v)));
+            return _mm_srai_epi32(_mm_add_epi32(_mm_mullo_epi32(d, sdiv), _mm_set1_epi32(kHalf)), kShift);
+        }
+
+        MCE_TARGET_SSE41 inline __m128i band4_sse(__m128i b, __m128i g, __m128i r, __m128i v, __m128i d,
+                                                  const BandSpec &spec)
+        {
+            const __m128i s = s_sse(v, d);
+            const __m128i hdiv = _mm_cvtps_epi32(_mm_div_ps(_mm_set1_ps(kHNum), _mm_cvtepi32_ps(d)));
+            const __m128i vr = _mm_cmpeq_epi32(v, r), vg = _mm_cmpeq_epi32(v, g);
+            const __m128i d2 = _mm_add_epi32(d, d), d4 = _mm_add_epi32(d2, d2);
+            __m128i n = _mm_add_epi32(_mm_sub_epi32(r, g), d4);                  // v == b
+            n = _mm_blendv_epi8(n, _mm_add_epi32(_mm_sub_epi32(b, r), d2), vg); // v == g
+            n = _mm_blendv_epi8(n, _mm_sub_epi32(g, b), vr);                    // v == r (wins ties)
+            __m128i h = _mm_srai_epi32(_mm_add_epi32(_mm_mullo_epi32(n, hdiv), _mm_set1_epi32(kHalf)), kShift);
+            h = _mm_add_epi32(h, _mm_and_si128(_mm_cmpgt_epi32(_mm_setzero_si128(), h), _mm_set1_epi32(180)));
+
+            __m128i ok = _mm_and_si128(_mm_cmpgt_epi32(s, _mm_set1_epi32(spec.smin - 1)),
+                                       _mm_and_si128(_mm_cmpgt_epi32(v, _mm_set1_epi32(spec.vmin - 1)),
+                                                     _mm_cmpgt_epi32(_mm_set1_epi32(spec.vmax + 1), v)));
+            __m128i hue = _mm_setzero_si128();
+            for (int k = 0; k < spec.nHue; ++k)
+                hue = _mm_or_si128(hue, _mm_and_si128(_mm_cmpgt_epi32(h, _mm_set1_epi32(spec.hueLo[k] - 1)),
+                                                      _mm_cmpgt_epi32(_mm_set1_epi32(spec.hueHi[k] + 1), h)));
+            return _mm_and_si128(ok, hue);
+        }
+
+        // Lane group k (0..3) of 16 bytes, zero-extended to int32
+        MCE_TARGET_SSE41 inline __m128i lanes4(__m128i x, int k)
+        {
+            switch (k)
+            {
+            case 0:
+                return _mm_cvtepu8_epi32(x);
+            case 1:
+                return _mm_cvtepu8_epi32(_mm_srli_si128(x, 4));
+            case 2:
+                return _mm_cvtepu8_epi32(_mm_srli_si128(x, 8));
+            default:
+                return _mm_cvtepu8_epi32(_mm_srli_si128(x, 12));
+            }
+        }
+
+        MCE_TARGET_SSE41 void hist_row_sse41(const uchar *src, int n, SVHist &hist)
+        {
+            alignas(16) uchar sb[16], vb[16];
+            int x = 0;
+            for (; x + 16 <= n; x += 16, src += 48)
+            {
+                __m128i B, G, R;
+                deinterleave16(src, B, G, R);
+                const __m128i V = _mm_max_epu8(_mm_max_epu8(B, G), R);
+                const __m128i D = _mm_sub_epi8(V, _mm_min_epu8(_mm_min_epu8(B, G), R));
+                __m128i s[4];
+                for (int k = 0; k < 4; ++k)
+                    s[k] = s_sse(lanes4(V, k), lanes4(D, k));
+                _mm_store_si128((__m128i *)sb, _mm_packus_epi16(_mm_packs_epi32(s[0], s[1]), _mm_packs_epi32(s[2], s[3])));
+                _mm_store_si128((__m128i *)vb, V);
+                for (int i = 0; i < 16; ++i)
+                {
+                    hist.s[sb[i]]++;
+                    hist.v[vb[i]]++;
+                }
+            }
+            hist_row_scalar(src, n - x, hist);
+        }
+
+        MCE_TARGET_SSE41 void band_row_sse41(const uchar *src, uchar *dst, int n, const BandSpec &spec)
+        {
+            int x = 0;
+            for (; x + 16 <= n; x += 16, src += 48)
+            {
+                __m128i B, G, R;
+                deinterleave16(src, B, G, R);
+                const __m128i V = _mm_max_epu8(_mm_max_epu8(B, G), R);
+                const __m128i D = _mm_sub_epi8(V, _mm_min_epu8(_mm_min_epu8(B, G), R));
+                __m128i m[4];
+                for (int k = 0; k < 4; ++k)
+                    m[k] = band4_sse(lanes4(B, k), lanes4(G, k), lanes4(R, k), lanes4(V, k), lanes4(D, k), spec);
+                _mm_storeu_si128((__m128i *)(dst + x),
+                                 _mm_packs_epi16(_mm_packs_epi32(m[0], m[1]), _mm_packs_epi32(m[2], m[3])));
+            }
+            band_row_scalar(src, dst + x, n - x, spec);
+        }
+
+        // ------------------------------ AVX2 ------------------------------
+        MCE_TARGET_AVX2 inline __m256i s_avx2(__m256i v, __m256i d)
+        {
+            const __m256i sdiv = _mm256_cvtps_epi32(_mm256_div_ps(_mm256_set1_ps(kSNum), _mm256_cvtepi32_ps(v)));
+            return _mm256_srai_epi32(_mm256_add_epi32(_mm256_mullo_epi32(d, sdiv), _mm256_set1_epi32(kHalf)), kShift);
+        }
+
+        MCE_TARGET_AVX2 inline __m256i band8_avx2(__m256i b, __m256i g, __m256i r, __m256i v, __m256i d,
+                                                  const BandSpec &spec)
+        {
+            const __m256i s = s_avx2(v, d);
+            const __m256i hdiv = _mm256_cvtps_epi32(_mm256_div_ps(_mm256_set1_ps(kHNum), _mm256_cvtepi32_ps(d)));
+            const __m256i vr = _mm256_cmpeq_epi32(v, r), vg = _mm256_cmpeq_epi32(v, g);
+            const __m256i d2 = _mm256_add_epi32(d, d), d4 = _mm256_add_epi32(d2, d2);
+            __m256i n = _mm256_add_epi32(_mm256_sub_epi32(r, g), d4);
+            n = _mm256_blendv_epi8(n, _mm256_add_epi32(_mm256_sub_epi32(b, r), d2), vg);
+            n = _mm256_blendv_epi8(n, _mm256_sub_epi32(g, b), vr);
+            __m256i h = _mm256_srai_epi32(_mm256_add_epi32(_mm256_mullo_epi32(n, hdiv), _mm256_set1_epi32(kHalf)), kShift);
+            h = _mm256_add_epi32(h, _mm256_and_si256(_mm256_cmpgt_epi32(_mm256_setzero_si256(), h), _mm256_set1_epi32(180)));
+
+            __m256i ok = _mm256_and_si256(_mm256_cmpgt_epi32(s, _mm256_set1_epi32(spec.smin - 1)),
+                                          _mm256_and_si256(_mm256_cmpgt_epi32(v, _mm256_set1_epi32(spec.vmin - 1)),
+                                                           _mm256_cmpgt_epi32(_mm256_set1_epi32(spec.vmax + 1), v)));
+            __m256i hue = _mm256_setzero_si256();
+            for (int k = 0; k < spec.nHue; ++k)
+                hue = _mm256_or_si256(hue, _mm256_and_si256(_mm256_cmpgt_epi32(h, _mm256_set1_epi32(spec.hueLo[k] - 1)),
+                                                            _mm256_cmpgt_epi32(_mm256_set1_epi32(spec.hueHi[k] + 1), h)));
+            return _mm256_and_si256(ok, hue);
+        }
+
+        // Bytes 8..15 zero-extended to int32
+        MCE_TARGET_AVX2 inline __m256i lanes8_hi(__m128i x)
+        {
+            return _mm256_cvtepu8_epi32(_mm_srli_si128(x, 8));
+        }
+
+        // Two int32×8 results → 16 ordered bytes (packs work per 128-bit lane).
+        // Signed saturation keeps 0/-1 masks intact; unsigned keeps 0..255 values.
+        template <bool Unsigned>
+        MCE_TARGET_AVX2 inline __m128i pack16_avx2(__m256i lo, __m256i hi)
+        {
+            const __m256i p16 = _mm256_permute4x64_epi64(_mm256_packs_epi32(lo, hi), 0xD8);
+            const __m128i a = _mm256_castsi256_si128(p16), b = _mm256_extracti128_si256(p16, 1);
+            return Unsigned ? _mm_packus_epi16(a, b) : _mm_packs_epi16(a, b);
+        }
+
+        MCE_TARGET_AVX2 void hist_row_avx2(const uchar *src, int n, SVHist &hist)
+        {
+            alignas(16) uchar sb[16], vb[16];
+            int x = 0;
+            for (; x + 16 <= n; x += 16, src += 48)
+            {
+                __m128i B, G, R;
+                deinterleave16(src, B, G, R);
+                const __m128i V = _mm_max_epu8(_mm_max_epu8(B, G), R);
+                const __m128i D = _mm_sub_epi8(V, _mm_min_epu8(_mm_min_epu8(B, G), R));
+                const __m256i s0 = s_avx2(_mm256_cvtepu8_epi32(V), _mm256_cvtepu8_epi32(D));
+                const __m256i s1 = s_avx2(lanes8_hi(V), lanes8_hi(D));
+                _mm_store_si128((__m128i *)sb, pack16_avx2<true>(s0, s1));
+                _mm_store_si128((__m128i *)vb, V);
+                for (int i = 0; i < 16; ++i)
+                {
+                    hist.s[sb[i]]++;
+                    hist.v[vb[i]]++;
+                }
+            }
+            hist_row_scalar(src, n - x, hist);
+        }
+
+        MCE_TARGET_AVX2 void band_row_avx2(const uchar *src, uchar *dst, int n, const BandSpec &spec)
+        {
+            int x = 0;
+            for (; x + 16 <= n; x += 16, src += 48)
+            {
+                __m128i B, G, R;
+                deinterleave16(src, B, G, R);
+                const __m128i V = _mm_max_epu8(_mm_max_epu8(B, G), R);
+                const __m128i D = _mm_sub_epi8(V, _mm_min_epu8(_mm_min_epu8(B, G), R));
+                const __m256i m0 = band8_avx2(_mm256_cvtepu8_epi32(B), _mm256_cvtepu8_epi32(G), _mm256_cvtepu8_epi32(R),
+                                              _mm256_cvtepu8_epi32(V), _mm256_cvtepu8_epi32(D), spec);
+                const __m256i m1 = band8_avx2(lanes8_hi(B), lanes8_hi(G), lanes8_hi(R), lanes8_hi(V), lanes8_hi(D), spec);
+                _mm_storeu_si128((__m128i *)(dst + x), pack16_avx2<false>(m0, m1));
+            }
+            band_row_scalar(src, dst + x, n - x, spec);
+        }
+#endif // MCE_HSV_X86
+
+#ifdef MCE_HSV_NEON
+        // ------------------------------ NEON (AArch64) ------------------------------
+        inline int32x4_t lanes4(uint8x16_t x, int k)
+        {
+            const uint16x8_t w = (k < 2) ? vmovl_u8(vget_low_u8(x)) : vmovl_u8(vget_high_u8(x));
+            const uint32x4_t q = (k & 1) ? vmovl_u16(vget_high_u16(w)) : vmovl_u16(vget_low_u16(w));
+            return vreinterpretq_s32_u32(q);
+        }
+
+        inline int32x4_t s_neon(int32x4_t v, int32x4_t d)
+        {
+            const int32x4_t sdiv = vcvtnq_s32_f32(vdivq_f32(vdupq_n_f32(kSNum), vcvtq_f32_s32(v)));
+            return vshrq_n_s32(vaddq_s32(vmulq_s32(d, sdiv), vdupq_n_s32(kHalf)), kShift);
+        }
+
+        inline uint32x4_t band4_neon(int32x4_t b, int32x4_t g, int32x4_t r, int32x4_t v, int32x4_t d,
+                                     const BandSpec &spec)
+        {
+            const int32x4_t s = s_neon(v, d);
+            const int32x4_t hdiv = vcvtnq_s32_f32(vdivq_f32(vdupq_n_f32(kHNum), vcvtq_f32_s32(d)));
+            const uint32x4_t vr = vceqq_s32(v, r), vg = vceqq_s32(v, g);
+            const int32x4_t d2 = vaddq_s32(d, d), d4 = vaddq_s32(d2, d2);
+            int32x4_t n = vaddq_s32(vsubq_s32(r, g), d4);
+            n = vbslq_s32(vg, vaddq_s32(vsubq_s32(b, r), d2), n);
+            n = vbslq_s32(vr, vsubq_s32(g, b), n);
+            int32x4_t h = vshrq_n_s32(vaddq_s32(vmulq_s32(n, hdiv), vdupq_n_s32(kHalf)), kShift);
+            h = vaddq_s32(h, vandq_s32(vreinterpretq_s32_u32(vcltzq_s32(h)), vdupq_n_s32(180)));
+
+            uint32x4_t ok = vandq_u32(vcgeq_s32(s, vdupq_n_s32(spec.smin)),
+                                      vandq_u32(vcgeq_s32(v, vdupq_n_s32(spec.vmin)), vcleq_s32(v, vdupq_n_s32(spec.vmax))));
+            uint32x4_t hue = vdupq_n_u32(0);
+            for (int k = 0; k < spec.nHue; ++k)
+                hue = vorrq_u32(hue, vandq_u32(vcgeq_s32(h, vdupq_n_s32(spec.hueLo[k])),
+                                               vcleq_s32(h, vdupq_n_s32(spec.hueHi[k]))));
+            return vandq_u32(ok, hue);
+        }
+
+        inline uint8x16_t pack16_neon(const uint32x4_t m[4])
+        {
+            const uint16x8_t lo = vcombine_u16(vmovn_u32(m[0]), vmovn_u32(m[1]));
+            const uint16x8_t hi = vcombine_u16(vmovn_u32(m[2]), vmovn_u32(m[3]));
+            return vcombine_u8(vmovn_u16(lo), vmovn_u16(hi));
+        }
+
+        void hist_row_neon(const uchar *src, int n, SVHist &hist)
+        {
+            uchar sb[16], vb[16];
+            int x = 0;
+            for (; x + 16 <= n; x += 16, src += 48)
+            {
+                const uint8x16x3_t px = vld3q_u8(src);
+                const uint8x16_t V = vmaxq_u8(vmaxq_u8(px.val[0], px.val[1]), px.val[2]);
+                const uint8x16_t D = vsubq_u8(V, vminq_u8(vminq_u8(px.val[0], px.val[1]), px.val[2]));
+                uint32x4_t s[4];
+                for (int k = 0; k < 4; ++k)
+                    s[k] = vreinterpretq_u32_s32(s_neon(lanes4(V, k), lanes4(D, k)));
+                vst1q_u8(sb, pack16_neon(s));
+                vst1q_u8(vb, V);
+                for (int i = 0; i < 16; ++i)
+                {
+                    hist.s[sb[i]]++;
+                    hist.v[vb[i]]++;
+                }
+            }
+            hist_row_scalar(src, n - x, hist);
+        }
+
+        void band_row_neon(const uchar *src, uchar *dst, int n, const BandSpec &spec)
+        {
+            int x = 0;
+            for (; x + 16 <= n; x += 16, src += 48)
+            {
+                const uint8x16x3_t px = vld3q_u8(src);
+                const uint8x16_t B = px.val[0], G = px.val[1], R = px.val[2];
+                const uint8x16_t V = vmaxq_u8(vmaxq_u8(B, G), R);
+                const uint8x16_t D = vsubq_u8(V, vminq_u8(vminq_u8(B, G), R));
+                uint32x4_t m[4];
+                for (int k = 0; k < 4; ++k)
+                    m[k] = band4_neon(lanes4(B, k), lanes4(G, k), lanes4(R, k), lanes4(V, k), lanes4(D, k), spec);
+                vst1q_u8(dst + x, pack16_neon(m));
+            }
+            band_row_scalar(src, dst + x, n - x, spec);
+        }
+#endif // MCE_HSV_NEON
+
+        bool isa_supported(Isa isa)
+        {
+            switch (isa)
+            {
+            case Isa::Scalar:
+                return true;
+#ifdef MCE_HSV_X86
+            case Isa::SSE41:
+                return __builtin_cpu_supports("sse4.1");
+            case Isa::AVX2:
+                return __builtin_cpu_supports("avx2");
+#endif
+#ifdef MCE_HSV_NEON
+            case Isa::NEON:
+                return true;
+#endif
+            default:
+                return false;
+            }
+        }
+
+        Isa best_isa()
+        {
+            for (Isa isa : {Isa::AVX2, Isa::NEON, Isa::SSE41})
+                if (isa_supported(isa))
+                    return isa;
+            return Isa::Scalar;
+        }
+
+        Isa resolve_isa()
+        {
+            if (const char *env = std::getenv("MCE_HSV_ISA"))
+            {
+                for (Isa isa : {Isa::Scalar, Isa::SSE41, Isa::AVX2, Isa::NEON})
+                    if (std::strcmp(env, isa_name(isa)) == 0 && isa_supported(isa))
+                        return isa;
+            }
+            return best_isa();
+        }
+
+        Isa usable(Isa isa)
+        {
+            return isa_supported(isa) ? isa : best_isa();
+        }
+
+    } // namespace (anon)
+
+    Isa active_isa()
+    {
+        static const Isa isa = resolve_isa();
+        return isa;
+    }
+
+    const char *isa_name(Isa isa)
+    {
+        switch (isa)
+        {
+        case Isa::SSE41:
+            return "sse41";
+        case Isa::AVX2:
+            return "avx2";
+        case Isa::NEON:
+            return "neon";
+        default:
+            return "scalar";
+        }
+    }
+
+    void sv_histograms(const cv::Mat &bgr, SVHist &h, Isa isa)
+    {
+        CV_Assert(bgr.type() == CV_8UC3);
+        std::memset(&h, 0, sizeof(h));
+        isa = usable(isa);
+        for (int y = 0; y < bgr.rows; ++y)
+        {
+            const uchar *src = bgr.ptr<uchar>(y);
+            switch (isa)
+            {
+#ifdef MCE_HSV_X86
+            case Isa::AVX2:
+                hist_row_avx2(src, bgr.cols, h);
+                break;
+            case Isa::SSE41:
+                hist_row_sse41(src, bgr.cols, h);
+                break;
+#endif
+#ifdef MCE_HSV_NEON
+            case Isa::NEON:
+                hist_row_neon(src, bgr.cols, h);
+                break;
+#endif
+            default:
+                hist_row_scalar(src, bgr.cols, h);
+            }
+        }
+    }
+
+    int percentile(const int hist[256], int total, double p01_99)
+    {
+        const int target = (int)std::round(std::clamp(p01_99, 0.0, 100.0) / 100.0 * total);
+        int acc = 0;
+        for (int v = 0; v < 256; ++v)
+        {
+            acc += hist[v];
+            if (acc >= target)
+                return v;
+        }
+        return 255;
+    }
+
+    void add_hue_range(BandSpec &spec, int lo, int hi)
+    {
+        // Insert sorted by start, then re-merge (hue is integral: [a,b] and [b+1,c] touch)
+        int los[BandSpec::kMaxHueRanges + 1], his[BandSpec::kMaxHueRanges + 1];
+        int n = 0;
+        bool placed = false;
+        for (int k = 0; k < spec.nHue; ++k)
+        {
+            if (!placed && lo < spec.hueLo[k])
+            {
+                los[n] = lo;
+                his[n++] = hi;
+                placed = true;
+            }
+            los[n] = spec.hueLo[k];
+            his[n++] = spec.hueHi[k];
+        }
+        if (!placed)
+        {
+            los[n] = lo;
+            his[n++] = hi;
+        }
+
+        int m = 0;
+        for (int i = 0; i < n; ++i)
+        {
+            if (m > 0 && los[i] <= spec.hueHi[m - 1] + 1)
+                spec.hueHi[m - 1] = std::max(spec.hueHi[m - 1], his[i]);
+            else
+            {
+                CV_Assert(m < BandSpec::kMaxHueRanges);
+                spec.hueLo[m] = los[i];
+                spec.hueHi[m] = his[i];
+                ++m;
+            }
+        }
+        spec.nHue = m;
+    }
+
+    void band_mask(const cv::Mat &bgr, const BandSpec &spec, cv::Mat &mask, Isa isa)
+    {
+        CV_Assert(bgr.type() == CV_8UC3);
+        mask.create(bgr.size(), CV_8U);
+        isa = usable(isa);
+        for (int y = 0; y < bgr.rows; ++y)
+        {
+            const uchar *src = bgr.ptr<uchar>(y);
+            uchar *dst = mask.ptr<uchar>(y);
+            switch (isa)
+            {
+#ifdef MCE_HSV_X86
+            case Isa::AVX2:
+                band_row_avx2(src, dst, bgr.cols, spec);
+                break;
+            case Isa::SSE41:
+                band_row_sse41(src, dst, bgr.cols, spec);
+                break;
+#endif
+#ifdef MCE_HSV_NEON
+            case Isa::NEON:
+                band_row_neon(src, dst, bgr.cols, spec);
+                break;
+#endif
+            default:
+                band_row_scalar(src, dst, bgr.cols, spec);
+            }
+        }
+    }
+
+} // namespace mce::hsv
@@ -0,0 +1,108 @@
+// src/image_probe.cpp — header-only size probe + reduced JPEG decode
+#include "mce/image_probe.hpp"
+
+#include <opencv2/imgcodecs.hpp>
+#include <fstream>
+
+namespace mce::io
+{
+    namespace
+    {
+        int be16(const unsigned char *p) { return (p[0] << 8) | p[1]; }
+        long long be32(const unsigned char *p)
+        {
+            return ((long long)p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+        }
+
+        // Walks the marker segments up to the first start-of-frame
+        bool probe_jpeg(std::ifstream &f, ImageInfo &info)
+        {
+            unsigned char b[8];
+            for (;;)
+            {
+                int c = f.get();
+                if (c != 0xFF)
+                    return false;
+                while (c == 0xFF) // fill bytes
+                    c = f.get();
+                if (c == EOF)
+                    return false;
+                if (c == 0x01 || (c >= 0xD0 && c <= 0xD7)) // no length field
+                    continue;
+                if (!f.read((char *)b, 2))
+                    return false;
+                const int len = be16(b);
+                if (len < 2)
+                    return false;
+                // SOF0..SOF15, except DHT (C4), JPG (C8), DAC (CC)
+                if (c >= 0xC0 && c <= 0xCF && c != 0xC4 && c != 0xC8 && c != 0xCC)
+                {
+                    if (len < 7 || !f.read((char *)b, 5))
+                        return false;
+                    info.format = ImageFormat::Jpeg;
+                    info.height = be16(b + 1);
+                    info.width = be16(b + 3);
+                    return info.width > 0 && info.height > 0;
+                }
+                if (c == 0xDA || c == 0xD9) // scan data / end before any frame
+                    return false;
+                f.seekg(len - 2, std::ios::cur);
+            }
+        }
+
+        bool probe_png(std::ifstream &f, ImageInfo &info)
+        {
+            unsigned char b[14]; // rest of signature, IHDR length + type
+            if (!f.read((char *)b, 6 + 8) || b[10] != 'I' || b[11] != 'H' || b[12] != 'D' || b[13] != 'R')
+                return false;
+            unsigned char wh[8];
+            if (!f.read((char *)wh, 8))
+                return false;
+            info.format = ImageFormat::Png;
+            info.width = (int)be32(wh);
+            info.height = (int)be32(wh + 4);
+            return info.width > 0 && info.height > 0;
+        }
+    } // namespace
+
+    bool probe_image(const std::string &path, ImageInfo &info)
+    {
+        info = ImageInfo{};
+        std::ifstream f(path, std::ios::binary);
+        unsigned char sig[2];
+        if (!f || !f.read((char *)sig, 2))
+            return false;
+        if (sig[0] == 0xFF && sig[1] == 0xD8)
+            return probe_jpeg(f, info);
+        if (sig[0] == 0x89 && sig[1] == 'P')
+            return probe_png(f, info);
+        return false;
+    }
+
+    int reduced_decode_factor(const ImageInfo &info, long long budgetPixels)
+    {
+        if (budgetPixels <= 0 || info.format != ImageFormat::Jpeg)
+            return 1;
+        const long long px = (long long)info.width * info.height;
+        int f = 1;
+        while (f < 8 && px / ((long long)(2 * f) * (2 * f)) >= budgetPixels)
+            f *= 2;
+        return f;
+    }
+
+    cv::Mat imread_reduced(const std::string &path, int factor)
+    {
+        switch (factor)
+        {
+        case 2:
+            return cv::imread(path, cv::IMREAD_REDUCED_COLOR_2);
+        case 4:
+            return cv::imread(path, cv::IMREAD_REDUCED_COLOR_4);
+        case 8:
+            return cv::imread(path, cv::IMREAD_REDUCED_COLOR_8);
+        default:
+            return cv::imread(path, cv::IMREAD_COLOR);
+        }
+    }
+
+} // namespace mce::io
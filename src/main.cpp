@@ -1,8 +1,13 @@
 #include "./mce/ansi.hpp"
 #include "./mce/app.hpp"
+#include "./mce/cli.hpp"
 
-int main()
+int main(int argc, char **argv)
 {
+    // Any argument selects headless batch mode; no arguments keeps the TUI
+    if (app::cli::wants_headless(argc, argv))
+        return app::cli::run(argc, argv);
+
     mce::ansi::enable_virtual_terminal_on_windows();
     app::Application app;
     return app.run();
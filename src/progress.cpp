@@ -1,27 +1,41 @@
 #include "mce/progress.hpp"
 #include "mce/ansi.hpp"
+#include "mce/bounded_queue.hpp"
+#include "mce/debug_sink.hpp"
 #include "mce/log.hpp"
 
 // unified detection+coverage API
 #include "mce/detect_and_compute.hpp"
+#include "mce/hsv_kernel.hpp"
+#include "mce/image_probe.hpp"
+#include "mce/result_sink.hpp"
 
+#include <opencv2/core.hpp>
 #include <opencv2/imgcodecs.hpp>
 
+#include <algorithm>
+#include <atomic>
+#include <cctype>
 #include <chrono>
+#include <cmath>
 #include <ctime>
 #include <filesystem>
 #include <fstream>
 #include <iomanip>
 #include <iostream>
+#include <memory>
 #include <sstream>
 #include <string>
+#include <thread>
 
 namespace fs = std::filesystem;
 
 namespace
 {
-    fs::path resolve_output_root()
+    fs::path resolve_output_root(const app::State &state)
     {
+        if (!state.outputRoot.empty())
+            return fs::path(state.outputRoot);
         const char *env = std::getenv("MCE_OUTPUT_ROOT");
         if (env && *env)
             return fs::path(env);
@@ -54,194 +68,1049 @@ namespace
         return p.stem().string();
     }
 
+    using clock = std::chrono::steady_clock;
+
+    mce::DebugEncoding debug_encoding(const app::State &state)
+    {
+        mce::DebugEncoding enc;
+        enc.format = state.debugFormat == "jpg" ? mce::DebugEncoding::Format::Jpeg : mce::DebugEncoding::Format::Png;
+        enc.quality = state.debugQuality;
+        enc.max_side = state.debugPreview;
+        return enc;
+    }
+
+    // One results-CSV line; double quotes group a field, "" inside one is a
+    // literal quote
+    std::vector<std::string> split_csv(const std::string &line)
+    {
+        std::vector<std::string> f(1);
+        bool quoted = false;
+        for (std::size_t k = 0; k < line.size(); ++k)
+        {
+            const char c = line[k];
+            if (c == '"' && quoted && k + 1 < line.size() && line[k + 1] == '"')
+                f.back() += line[++k];
+            else if (c == '"')
+                quoted = !quoted;
+            else if (c == ',' && !quoted)
+                f.emplace_back();
+            else if (c != '\r')
+                f.back() += c;
+        }
+        return f;
+    }
+
+    // A results row, as much of it as render-debug needs
+    struct StoredRow
+    {
+        int index = 0;
+        std::string path;
+        int marker = 0, markers = 0;
+        bool multi = false;      // marker column set: a --multi run, artifacts under "_m<k>"
+        bool thresholds = false; // Smin/Vmin/Vmax known (the image was read)
+        mce::DetectOutput out;   // found, coverage_percent, thresholds, quad
+    };
+
+    // Results CSV, columns by name: files from before the quad column still
+    // give masks
+    bool load_csv_rows(const std::string &file, std::vector<StoredRow> &rows)
+    {
+        std::ifstream in(file);
+        std::string line;
+        if (!in || !std::getline(in, line))
+            return false;
+        const std::vector<std::string> header = split_csv(line);
+        auto column = [&](const char *name)
+        {
+            const auto it = std::find(header.begin(), header.end(), name);
+            return it == header.end() ? -1 : (int)(it - header.begin());
+        };
+        const int cIndex = column("index"), cPath = column("input_path"), cFound = column("found"),
+                  cPct = column("percent"), cS = column("Smin"), cV0 = column("Vmin"), cV1 = column("Vmax"),
+                  cMarker = column("marker"), cMarkers = column("image_markers"), cQuad = column("quad");
+        if (cIndex < 0 || cPath < 0 || cFound < 0 || cS < 0 || cV0 < 0 || cV1 < 0)
+            return false;
+
+        while (std::getline(in, line))
+        {
+            const std::vector<std::string> f = split_csv(line);
+            if (f.size() < header.size())
+                continue;
+            StoredRow row;
+            try
+            {
+                row.index = std::stoi(f[cIndex]);
+            }
+            catch (...)
+            {
+                continue;
+            }
+            row.path = f[cPath];
+            row.out.found = f[cFound] == "1";
+            row.thresholds = !f[cS].empty();
+            row.out.Smin = std::atoi(f[cS].c_str());
+            row.out.Vmin = std::atoi(f[cV0].c_str());
+            row.out.Vmax = std::atoi(f[cV1].c_str());
+            if (cPct >= 0)
+                row.out.coverage_percent = std::atoi(f[cPct].c_str());
+            if (cMarker >= 0)
+            {
+                row.multi = !f[cMarker].empty();
+                row.marker = std::atoi(f[cMarker].c_str());
+            }
+            if (cMarkers >= 0)
+                row.markers = std::atoi(f[cMarkers].c_str());
+            if (row.out.found && cQuad >= 0)
+            {
+                std::istringstream qs(f[cQuad]);
+                cv::Point2f p;
+                while (row.out.quad.size() < 4 && qs >> p.x >> p.y)
+                    row.out.quad.push_back(p);
+                if (row.out.quad.size() != 4)
+                    row.out.quad.clear();
+            }
+            rows.push_back(std::move(row));
+        }
+        return true;
+    }
+
+    // Columnar (.mcec) results through the memory-mapped reader
+    bool load_columnar_rows(const std::string &file, std::vector<StoredRow> &rows)
+    {
+        mce::io::ColumnarReader rd;
+        if (!rd.open(file))
+            return false;
+        const int cIndex = rd.column("index"), cPath = rd.column("input_path"), cFound = rd.column("found"),
+                  cPct = rd.column("percent"), cS = rd.column("Smin"), cV0 = rd.column("Vmin"), cV1 = rd.column("Vmax"),
+                  cMarker = rd.column("marker"), cMarkers = rd.column("image_markers"), cQuad = rd.column("quad");
+        if (cIndex < 0 || cPath < 0 || cFound < 0 || cPct < 0 || cS < 0 || cV0 < 0 || cV1 < 0 ||
+            cMarker < 0 || cMarkers < 0 || cQuad < 0)
+            return false;
+
+        rows.reserve(rd.rows());
+        for (std::size_t r = 0; r < rd.rows(); ++r)
+        {
+            StoredRow row;
+            row.index = (int)rd.integer(cIndex, r);
+            row.path = std::string(rd.text(cPath, r));
+            row.out.found = rd.integer(cFound, r) != 0;
+            row.thresholds = rd.valid(cS, r);
+            row.out.Smin = (int)rd.integer(cS, r);
+            row.out.Vmin = (int)rd.integer(cV0, r);
+            row.out.Vmax = (int)rd.integer(cV1, r);
+            row.out.coverage_percent = (int)rd.integer(cPct, r);
+            row.multi = rd.valid(cMarker, r);
+            row.marker = (int)rd.integer(cMarker, r);
+            row.markers = (int)rd.integer(cMarkers, r);
+            if (row.out.found && rd.valid(cQuad, r))
+            {
+                const float *q = rd.points(cQuad, r);
+                for (int k = 0; k < 4; ++k)
+                    row.out.quad.emplace_back(q[2 * k], q[2 * k + 1]);
+            }
+            rows.push_back(std::move(row));
+        }
+        return true;
+    }
+
+    // Name order with digit runs compared as numbers (frame_9 < frame_10)
+    bool natural_less(const std::string &a, const std::string &b)
+    {
+        size_t i = 0, j = 0;
+        while (i < a.size() && j < b.size())
+        {
+            if (std::isdigit((unsigned char)a[i]) && std::isdigit((unsigned char)b[j]))
+            {
+                size_t i2 = i, j2 = j;
+                while (i2 < a.size() && a[i2] == '0')
+                    ++i2;
+                while (j2 < b.size() && b[j2] == '0')
+                    ++j2;
+                size_t ie = i2, je = j2;
+                while (ie < a.size() && std::isdigit((unsigned char)a[ie]))
+                    ++ie;
+                while (je < b.size() && std::isdigit((unsigned char)b[je]))
+                    ++je;
+                if (ie - i2 != je - j2)
+                    return ie - i2 < je - j2;
+                const int c = a.compare(i2, ie - i2, b, j2, je - j2);
+                if (c != 0)
+                    return c < 0;
+                i = ie;
+                j = je;
+            }
+            else
+            {
+                if (a[i] != b[j])
+                    return a[i] < b[j];
+                ++i;
+                ++j;
+            }
+        }
+        return a.size() - i < b.size() - j;
+    }
+
+    // Sequence mode: one sequence per directory, frames ordered by file name
+    // or modification time. Reorders `images` and returns [begin, end) of
+    // each sequence.
+    std::vector<std::pair<int, int>> order_sequences(std::vector<std::string> &images, const std::string &order)
+    {
+        struct Frame
+        {
+            std::string path, dir, name;
+            fs::file_time_type mtime{};
+        };
+        std::vector<Frame> frames;
+        frames.reserve(images.size());
+        for (const std::string &p : images)
+        {
+            const fs::path fp(p);
+            Frame f{p, fp.parent_path().string(), fp.filename().string()};
+            if (order == "mtime")
+            {
+                std::error_code ec;
+                f.mtime = fs::last_write_time(fp, ec);
+            }
+            frames.push_back(std::move(f));
+        }
+        std::stable_sort(frames.begin(), frames.end(), [&](const Frame &a, const Frame &b)
+                         {
+            if (a.dir != b.dir)
+                return a.dir < b.dir;
+            if (order == "mtime" && a.mtime != b.mtime)
+                return a.mtime < b.mtime;
+            return natural_less(a.name, b.name); });
+
+        std::vector<std::pair<int, int>> seqs;
+        for (int k = 0; k < (int)frames.size(); ++k)
+        {
+            images[k] = frames[k].path;
+            if (k == 0 || frames[k].dir != frames[k - 1].dir)
+                seqs.emplace_back(k, k);
+            seqs.back().second = k + 1;
+        }
+        return seqs;
+    }
+
+    // Everything the reporting side needs for one input image
+    struct ImageResult
+    {
+        int index = 0; // 1-based position in the input list
+        std::string path;
+        bool readOk = false;
+        bool ok = false;
+        long long ms = 0; // imread + detect
+        double decodeMs = 0, detectMs = 0, writeMs = 0; // imread / detect minus debug I/O / debug I/O
+        int decodeScale = 1;                            // reduced JPEG decode factor (1 = full res)
+        std::string debugPolicy;                        // capture policies that fired ("" = no artifacts)
+        mce::DetectOutput out;                // first (or only) marker
+        std::vector<mce::DetectOutput> more; // --multi: markers 2..n
+        int markers() const { return ok && out.found ? 1 + (int)more.size() : 0; }
+    };
+
+    int hardware_threads()
+    {
+        return std::max(1, (int)std::thread::hardware_concurrency());
+    }
+
+    // Worker count: 0 = one per hardware thread, never more than images
+    int resolve_workers(int requested, int nImages)
+    {
+        int w = requested > 0 ? requested : hardware_threads();
+        return std::clamp(w, 1, std::max(1, nImages));
+    }
+
+    // Angle-sweep threads per image: share the cores left over by the batch
+    // workers so workers × scan threads ≈ cores (no oversubscription).
+    int resolve_scan_threads(int requested, int workers)
+    {
+        if (requested > 0)
+            return requested;
+        return std::max(1, hardware_threads() / std::max(1, workers));
+    }
+
+    // A worker's detector plus its warm-up mark: workspace allocations after
+    // the first image are the steady-state ones (0 for same-sized inputs)
+    struct WorkerDetector
+    {
+        mce::Detector det;
+        std::size_t warmMark = 0;
+        bool warm = false;
+
+        explicit WorkerDetector(const mce::DetectOptions &opt) : det(opt) {}
+        void mark_warm()
+        {
+            if (!warm)
+            {
+                warmMark = det.workspace_allocations();
+                warm = true;
+            }
+        }
+        std::size_t steady_allocations() const
+        {
+            return warm ? det.workspace_allocations() - warmMark : 0;
+        }
+    };
+
+    // A decoded input on its way from a reader to a detector worker
+    struct Decoded
+    {
+        int index = 0; // 1-based position in the input list; 0 = end of input
+        int unit = 0;  // sequence (or single image) the frame belongs to
+        std::string path;
+        cv::Mat img; // empty when the read failed
+        double decodeMs = 0;
+        int decodeScale = 1;
+    };
+
+    // Reader stage: probe + imread
+    Decoded decode_one(int index, int unit, const std::string &path, const app::State &state)
+    {
+        Decoded d;
+        d.index = index;
+        d.unit = unit;
+        d.path = path;
+
+        // Reduced decode: coverage is a ratio, so a large JPEG can be decoded
+        // at 1/2..1/8 scale (libjpeg scales in the IDCT) while it keeps the
+        // pixel budget; the header probe is a few hundred bytes of I/O
+        auto t0 = clock::now();
+        try
+        {
+            if (state.decodeBudgetMp > 0.0)
+            {
+                mce::io::ImageInfo info;
+                if (mce::io::probe_image(path, info))
+                    d.decodeScale = mce::io::reduced_decode_factor(info, (long long)(state.decodeBudgetMp * 1e6));
+            }
+            d.img = mce::io::imread_reduced(path, d.decodeScale);
+        }
+        catch (const std::exception &e)
+        {
+            mce::log::e("imread failed on " + path + ": " + e.what());
+            d.img.release();
+        }
+        d.decodeMs = std::chrono::duration<double, std::milli>(clock::now() - t0).count();
+        return d;
+    }
+
+    bool capture_policies_set(const app::State &state)
+    {
+        return state.debugFailures || state.debugEvery > 0 || state.debugSlowMs > 0.0 || state.debugCoverageHi >= 0.0;
+    }
+
+    // Capture policies that select a finished image, '+'-joined ("" = none).
+    // Coverage fires when any marker lies outside [lo, hi].
+    std::string capture_reason(const ImageResult &r, const app::State &state, double detectMs)
+    {
+        std::string why;
+        auto fire = [&](const char *name)
+        {
+            why += why.empty() ? name : std::string("+") + name;
+        };
+        if (state.debugFailures && r.markers() == 0)
+            fire("failure");
+        if (state.debugEvery > 0 && (r.index - 1) % state.debugEvery == 0)
+            fire("every");
+        if (state.debugSlowMs > 0.0 && detectMs > state.debugSlowMs)
+            fire("slow");
+        if (state.debugCoverageHi >= 0.0 && r.markers() > 0)
+        {
+            bool outside = false;
+            for (int m = 0; m < r.markers(); ++m)
+            {
+                const int pct = (m == 0 ? r.out : r.more[m - 1]).coverage_percent;
+                outside = outside || pct < state.debugCoverageLo || pct > state.debugCoverageHi;
+            }
+            if (outside)
+                fire("coverage");
+        }
+        return why;
+    }
+
+    // Artifacts for a selected image, named as the in-call ones would be
+    void render_selected(WorkerDetector &wd, const cv::Mat &img, ImageResult &r,
+                         const app::State &state, const std::string &debugBase)
+    {
+        if (!state.multiMarker)
+        {
+            wd.det.render_debug(img, r.out, debugBase, debugBase);
+            return;
+        }
+        wd.det.render_debug(img, r.out, debugBase, debugBase + "_m1");
+        for (size_t k = 0; k < r.more.size(); ++k)
+        {
+            wd.det.render_debug(img, r.more[k], "", debugBase + "_m" + std::to_string(k + 2));
+            r.more[k].debug_mask_path = r.out.debug_mask_path;
+        }
+    }
+
+    // Detector stage: Detector::detect on the worker's own detector.
+    // `prior` (sequence mode) seeds the search and is updated from the result.
+    ImageResult detect_one(Decoded &d, const app::State &state, WorkerDetector &wd,
+                           const fs::path &debugDir, mce::TrackPrior *prior)
+    {
+        ImageResult r;
+        r.index = d.index;
+        r.path = d.path;
+        r.decodeMs = d.decodeMs;
+        r.decodeScale = d.decodeScale;
+        if (d.img.empty())
+        {
+            r.ms = std::lround(d.decodeMs);
+            return r;
+        }
+        r.readOk = true;
+        const cv::Mat &img = d.img;
+        if (wd.det.options().input_scale != d.decodeScale)
+        {
+            mce::DetectOptions opt = wd.det.options();
+            opt.input_scale = d.decodeScale;
+            wd.det.set_options(opt);
+        }
+        const std::string &path = d.path;
+
+        // Build debug base under our organized debug dir: .../debug/<ts>/<i>_<name>
+        std::string prefix = std::to_string(d.index) + "_" + stem_of(path);
+        fs::path debugBasePath = debugDir / prefix;
+        std::string debugBase = debugBasePath.string();
+
+        // With capture policies the detector runs without artifacts; they
+        // are rendered afterwards, only for the images a policy selects
+        const bool policies = state.saveDebug && capture_policies_set(state);
+        const bool saveInCall = state.saveDebug && !policies;
+
+        // ---- Single call to unified detector+coverage ----
+        // A throwing image must not take down the pool (or stall the writer)
+        auto t1 = clock::now();
+        try
+        {
+            if (state.multiMarker)
+            {
+                std::vector<mce::DetectOutput> outs;
+                r.ok = wd.det.detect_all(img, outs, state.debug, saveInCall, debugBase);
+                r.out = std::move(outs[0]);
+                r.more.assign(std::make_move_iterator(outs.begin() + 1), std::make_move_iterator(outs.end()));
+            }
+            else if (prior)
+            {
+                r.ok = wd.det.detect(img, *prior, r.out, state.debug, saveInCall, debugBase);
+                *prior = mce::track_prior(r.out);
+            }
+            else
+            {
+                r.ok = wd.det.detect(img, r.out, state.debug, saveInCall, debugBase);
+            }
+        }
+        catch (const std::exception &e)
+        {
+            mce::log::e("detect_and_compute failed on " + path + ": " + e.what());
+            r.ok = false;
+        }
+        auto t2 = clock::now();
+        if (state.saveDebug)
+        {
+            r.debugPolicy = policies ? capture_reason(r, state, std::chrono::duration<double, std::milli>(t2 - t1).count())
+                                     : "all";
+            if (policies && !r.debugPolicy.empty())
+            {
+                try
+                {
+                    render_selected(wd, img, r, state, debugBase);
+                }
+                catch (const std::exception &e)
+                {
+                    mce::log::e("debug render failed on " + path + ": " + e.what());
+                }
+            }
+            t2 = clock::now();
+        }
+        wd.mark_warm();
+
+        // Quads are reported in full-resolution pixels
+        if (r.decodeScale > 1)
+        {
+            const float f = (float)r.decodeScale;
+            for (cv::Point2f &q : r.out.quad)
+                q *= f;
+            for (mce::DetectOutput &m : r.more)
+                for (cv::Point2f &q : m.quad)
+                    q *= f;
+        }
+        r.writeMs = r.out.stage_ms.debug_io;
+        for (const mce::DetectOutput &m : r.more)
+            r.writeMs += m.stage_ms.debug_io;
+        const double detectWall = std::chrono::duration<double, std::milli>(t2 - t1).count();
+        r.detectMs = std::max(0.0, detectWall - r.writeMs);
+        r.ms = std::lround(d.decodeMs + detectWall);
+        return r;
+    }
+
+    // Results rows for one image: one per marker, or one for the image.
+    // `multi` fills the marker column (empty in single-marker runs)
+    void write_rows(mce::io::ResultSink &sink, const ImageResult &r, bool multi)
+    {
+        mce::io::ResultRow row;
+        row.index = r.index;
+        row.path = r.path;
+        row.read_ok = r.readOk;
+        row.out = &r.out;
+        row.elapsed_ms = r.ms;
+        row.decode_ms = r.decodeMs;
+        row.detect_ms = r.detectMs;
+        row.write_ms = r.writeMs;
+        row.image_markers = r.markers();
+        row.image_percent = 0;
+        for (int m = 0; m < r.markers(); ++m)
+            row.image_percent += (m == 0 ? r.out : r.more[m - 1]).coverage_percent;
+        row.tracked = r.out.tracked;
+        row.decode_scale = r.decodeScale;
+        row.debug_policy = r.debugPolicy;
+        row.multi = multi;
+        if (r.markers() == 0)
+        {
+            sink.write(row);
+            return;
+        }
+        for (int m = 0; m < r.markers(); ++m)
+        {
+            row.out = m == 0 ? &r.out : &r.more[m - 1];
+            row.marker = m + 1;
+            sink.write(row);
+        }
+    }
+
+    // Console lines + results rows for one result; always called in input order
+    void report_one(std::ostream &con, mce::io::ResultSink &sink, const ImageResult &r,
+                    int N, const app::State &state)
+    {
+        const int i = r.index;
+        const std::string &path = r.path;
+        const long long ms = r.ms;
+        const mce::DetectOutput &out = r.out;
+
+        con << mce::ansi::muted << "(" << i << "/" << N << ")"
+            << mce::ansi::reset << " Processing: " << path << "\n";
+
+        if (!r.readOk)
+        {
+            con << mce::ansi::err << "Failed to read image"
+                << mce::ansi::reset
+                << mce::ansi::muted << " [" << ms << " ms]"
+                << mce::ansi::reset << "\n";
+            write_rows(sink, r, state.multiMarker);
+            return;
+        }
+
+        if (r.ok && out.found)
+        {
+            // Console line with telemetry (one per marker)
+            const int n = r.markers();
+            for (int m = 0; m < n; ++m)
+            {
+                const mce::DetectOutput &o = m == 0 ? out : r.more[m - 1];
+                con << path << "  ";
+                if (state.multiMarker)
+                    con << "#" << m + 1 << " ";
+                con << o.coverage_percent << "%  "
+                    << mce::ansi::muted
+                    << "(angle=" << std::fixed << std::setprecision(1) << o.best_angle_deg
+                    << "°, occ=" << std::setprecision(2) << o.occupancy
+                    << ", hue=" << std::setprecision(2) << o.hue_score
+                    << ", line=" << (o.line_ok ? "ok" : "no") << ")"
+                    << mce::ansi::reset << "\n";
+            }
+
+            if (state.saveDebug)
+            {
+                con << mce::ansi::ok << "        Saved result."
+                    << mce::ansi::reset << "\n";
+            }
+        }
+        else
+        {
+            con << mce::ansi::warn << "No marker found"
+                << mce::ansi::reset << "\n";
+        }
+
+        // inline timing
+        con << mce::ansi::muted << "        [" << ms << " ms]"
+            << mce::ansi::reset << "\n";
+
+        write_rows(sink, r, state.multiMarker);
+    }
+
+    // One pipeline stage, all of its threads summed: time spent working,
+    // waiting for input (starved) and waiting for room downstream (blocked)
+    struct StageStats
+    {
+        int threads = 0;
+        std::atomic<std::int64_t> busyNs{0}, starvedNs{0}, blockedNs{0};
+
+        // "<name> <threads>× <busy>% busy, starved <ms> ms, blocked <ms> ms"
+        void print(std::ostream &os, const char *name, long long wallMs) const
+        {
+            const double wallNs = std::max(1.0, (double)wallMs * 1e6 * std::max(1, threads));
+            os << name << " " << threads << "× " << std::setprecision(0)
+               << 100.0 * busyNs.load() / wallNs << "% busy, starved "
+               << starvedNs.load() / 1000000 << " ms, blocked " << blockedNs.load() / 1000000 << " ms";
+        }
+    };
+
+    std::int64_t ns_since(clock::time_point t0)
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - t0).count();
+    }
+
 } // namespace
 
 namespace app::progress
 {
 
-    void process_and_report(const std::vector<std::string> &images,
-                            const app::State &state)
+    BatchSummary process_and_report(const std::vector<std::string> &inputs,
+                                    const app::State &state)
     {
-        using clock = std::chrono::steady_clock;
         using std::chrono::duration_cast;
         using std::chrono::milliseconds;
 
         mce::log::set(state.debug, state.saveDebug);
 
-        const fs::path root = resolve_output_root();
+        BatchSummary summary;
+        summary.total = static_cast<int>(inputs.size());
+
+        const fs::path root = resolve_output_root(state);
         const std::string ts = now_stamp();
         const fs::path resultsDir = root / "results";
         const fs::path debugDir = root / "debug" / ts;
+        const fs::path packPath = root / "debug" / (ts + ".tar"); // --debug-pack
 
         ensure_dir(resultsDir);
         if (state.saveDebug)
-            ensure_dir(debugDir);
+            ensure_dir(state.debugPack ? debugDir.parent_path() : debugDir);
 
-        const fs::path csvPath = resultsDir / (ts + ".csv");
-        std::ofstream csv(csvPath);
-
-        // CSV header: telemetry + all debug artifacts (incl. crop/clip)
-        csv << "index,input_path,found,percent,angle_deg,occupancy,hue_score,line_ok,"
-               "debug_quad,debug_warp,debug_mask,debug_crop,debug_clip,"
-               "elapsed_ms,Smin,Vmin,Vmax\n";
+        // Results file: <ts>.csv / .jsonl / .mcec per --format
+        std::unique_ptr<mce::io::ResultSink> resultSink = mce::io::make_result_sink(state.format, (resultsDir / ts).string());
+        summary.resultsPath = resultSink->path();
+        if (!resultSink->ok())
+        {
+            summary.outputOk = false;
+            std::cerr << "[ERR] Cannot create results file: " << summary.resultsPath << "\n";
+            return summary;
+        }
 
-        const int N = static_cast<int>(images.size());
-        std::cout << mce::ansi::title << "Running detection on " << N
-                  << " image(s)" << mce::ansi::reset << "\n\n";
-        std::cout << mce::ansi::muted << "Results CSV: " << csvPath.string()
-                  << mce::ansi::reset << "\n";
+        // --save-debug: artifacts are encoded and written off the detect
+        // path; the batch only waits for them once, after the last image
+        std::unique_ptr<mce::DebugSink> sink;
         if (state.saveDebug)
-            std::cout << mce::ansi::muted << "Debug dir : " << debugDir.string()
-                      << mce::ansi::reset << "\n";
-        std::cout << "\n";
-
-        long long total_ms_accum = 0;
-        int foundCount = 0;
-        int i = 0;
-
-        auto run_t0 = clock::now();
-
-        for (const auto &path : images)
         {
-            ++i;
-            std::cout << mce::ansi::muted << "(" << i << "/" << N << ")"
-                      << mce::ansi::reset << " Processing: " << path << "\n";
+            sink = std::make_unique<mce::DebugSink>(state.debugWriters, debug_encoding(state), 4 * (std::size_t)state.debugWriters,
+                                                    state.debugPack ? packPath.string() : std::string());
+            if (!sink->pack_ok())
+            {
+                summary.outputOk = false;
+                std::cerr << "[ERR] Cannot create debug pack: " << packPath.string() << "\n";
+                return summary;
+            }
+        }
 
-            auto t0 = clock::now();
+        // Per-image console lines go to `con`; --quiet points it at a null sink
+        std::ostream nullOut(nullptr);
+        std::ostream &con = state.quiet ? nullOut : std::cout;
 
-            cv::Mat img = cv::imread(path, cv::IMREAD_COLOR);
-            if (img.empty())
-            {
-                auto t1 = clock::now();
-                long long ms = duration_cast<milliseconds>(t1 - t0).count();
-                total_ms_accum += ms;
+        // Sequence mode: frames depend on their predecessor, so the unit of
+        // work is a whole sequence (directory); otherwise one image
+        std::vector<std::string> images = inputs;
+        std::vector<std::pair<int, int>> units;
+        if (state.sequence)
+        {
+            units = order_sequences(images, state.sequenceOrder);
+        }
+        else
+        {
+            for (int k = 0; k < (int)images.size(); ++k)
+                units.emplace_back(k, k + 1);
+        }
 
-                std::cout << mce::ansi::err << "Failed to read image"
-                          << mce::ansi::reset
-                          << mce::ansi::muted << " [" << ms << " ms]"
-                          << mce::ansi::reset << "\n";
+        const int N = static_cast<int>(images.size());
+        const int workers = resolve_workers(state.threads, (int)units.size());
+        // Decoded-frame queues: one shared, or one per worker in sequence mode
+        const int nQueues = state.sequence ? workers : 1;
+        const int readers = state.sequence ? workers : std::clamp(state.readers, 1, std::max(1, (int)units.size()));
 
-                // Write a row with the right number of columns (empty fields)
-                csv << i << "," << '"' << path << '"' << ",0,,,,," // found..line_ok
-                    << ",,,,,"                                     // debug paths (5) incl. crop/clip
-                    << ms << ",,,"                                 // elapsed + S/V thresholds
-                    << "\n";
-                continue;
-            }
+        mce::DetectOptions opt;
+        opt.scan_threads = resolve_scan_threads(state.scanThreads, workers);
+        opt.pyramid = state.pyramid;
+        opt.pyramid_tolerance = state.pyramidTol;
+        opt.validate_top_k = state.validateTopK;
+        mce::parse_validator_order(state.validatorOrder, opt.validator_order); // validated by the CLI
+        opt.kmeans_validator = state.kmeansValidator;
+        opt.gate_min_hues = state.gateMinHues;
+        opt.max_markers = state.maxMarkers;
+        opt.multi_budget_ms = state.multiBudgetMs;
+        opt.track_pad = state.trackPad;
+        mce::reset_validator_stats();
 
-            // Build debug base under our organized debug dir: .../debug/<ts>/<i>_<name>
-            std::string prefix = std::to_string(i) + "_" + stem_of(path);
-            fs::path debugBasePath = debugDir / prefix;
-            std::string debugBase = debugBasePath.string();
+        con << mce::ansi::title << "Running detection on " << N
+            << " image(s)" << mce::ansi::reset << "\n\n";
+        con << mce::ansi::muted << "Results   : " << summary.resultsPath
+            << mce::ansi::reset << "\n";
+        if (state.saveDebug)
+            con << mce::ansi::muted << (state.debugPack ? "Debug pack: " + packPath.string() : "Debug dir : " + debugDir.string())
+                << mce::ansi::reset << "\n";
+        con << mce::ansi::muted << "Workers   : " << workers;
+        if (mce::angle_scan_is_parallel())
+            con << " × " << opt.scan_threads << " angle-scan thread(s)";
+        con << ", " << readers << (readers == 1 ? " reader" : " readers") << mce::ansi::reset << "\n";
+        if (state.sequence)
+            con << mce::ansi::muted << "Sequences : " << units.size() << " (frames by "
+                << state.sequenceOrder << ", tracking pad " << opt.track_pad << ")"
+                << mce::ansi::reset << "\n";
+        if (state.decodeBudgetMp > 0.0)
+            con << mce::ansi::muted << "Decode    : JPEGs reduced down to >= " << state.decodeBudgetMp << " MP"
+                << mce::ansi::reset << "\n";
+        if (state.multiMarker)
+            con << mce::ansi::muted << "Markers   : up to " << opt.max_markers << " per image"
+                << (opt.multi_budget_ms > 0 ? ", budget " + std::to_string((int)opt.multi_budget_ms) + " ms" : "")
+                << (opt.pyramid ? " (pyramid off)" : "") << mce::ansi::reset << "\n";
+        if (opt.pyramid && !state.multiMarker)
+            con << mce::ansi::muted << "Pyramid   : on (long side >= " << opt.pyramid_min_side
+                << " px, tol " << opt.pyramid_tolerance << "%)" << mce::ansi::reset << "\n";
+        if (state.debug)
+            con << mce::ansi::muted << "HSV kernel: " << mce::hsv::isa_name(mce::hsv::active_isa())
+                << mce::ansi::reset << "\n";
+        con << "\n";
 
-            // Precompute crop/clip paths (we know the suffixes used inside detect_and_compute)
-            const std::string cropPath = debugBase + "_debug_crop.png";
-            const std::string clipPath = debugBase + "_debug_clip.png";
+        // One image per worker at a time; keep OpenCV's own pool out of the way
+        // so N workers don't each fan out to every core.
+        const int cvThreadsBefore = cv::getNumThreads();
+        if (workers > 1)
+            cv::setNumThreads(1);
 
-            // ---- Single call to unified detector+coverage ----
-            mce::DetectOutput out;
-            bool ok = mce::detect_and_compute(img, out, state.debug, state.saveDebug, debugBase);
+        long long total_ms_accum = 0;
+        int foundCount = 0, markerCount = 0, trackedCount = 0, capturedCount = 0;
+        long long gateRejects = 0; // components
+        int gateImages = 0;        // images that ended at the gate
+        long long sweepScored = 0, sweepValidated = 0, sweepSkipped = 0;
+        long long cacheLookups = 0, cacheHits = 0;
+        double decodeSum = 0, writeSum = 0;
+        mce::DetectOutput::StageTimes stageSum;
 
-            if (ok && out.found)
-            {
-                // Console line with telemetry
-                std::cout << path << "  "
-                          << out.coverage_percent << "%  "
-                          << mce::ansi::muted
-                          << "(angle=" << std::fixed << std::setprecision(1) << out.best_angle_deg
-                          << "°, occ=" << std::setprecision(2) << out.occupancy
-                          << ", hue=" << std::setprecision(2) << out.hue_score
-                          << ", line=" << (out.line_ok ? "ok" : "no") << ")"
-                          << mce::ansi::reset << "\n";
+        auto run_t0 = clock::now();
 
-                if (state.saveDebug)
-                {
-                    std::cout << mce::ansi::ok << "        Saved result."
-                              << mce::ansi::reset << "\n";
-                }
+        auto account = [&](const ImageResult &r)
+        {
+            total_ms_accum += r.ms;
+            if (!r.readOk)
+                ++summary.readFailed;
+            else if (r.ok && r.out.found)
                 ++foundCount;
-            }
-            else
+            markerCount += r.markers();
+            trackedCount += r.out.tracked;
+            capturedCount += !r.debugPolicy.empty();
+            if (r.readOk && r.markers() == 0 && r.out.gate_rejected > 0 && r.out.sweep_scored == 0)
+                ++gateImages;
+            decodeSum += r.decodeMs;
+            writeSum += r.writeMs;
+            for (int m = 0; m <= (int)r.more.size(); ++m)
             {
-                std::cout << mce::ansi::warn << "No marker found"
-                          << mce::ansi::reset << "\n";
+                const mce::DetectOutput &o = m == 0 ? r.out : r.more[m - 1];
+                sweepScored += o.sweep_scored;
+                sweepValidated += o.sweep_validated;
+                sweepSkipped += o.sweep_skipped;
+                gateRejects += o.gate_rejected;
+                cacheLookups += o.angle_cache_lookups;
+                cacheHits += o.angle_cache_hits;
+                const auto &st = o.stage_ms;
+                stageSum.mask += st.mask;
+                stageSum.component += st.component;
+                stageSum.sweep += st.sweep;
+                stageSum.validate += st.validate;
+                stageSum.refine += st.refine;
             }
+            report_one(con, *resultSink, r, N, state);
+        };
 
-            auto t1 = clock::now();
-            long long ms = duration_cast<milliseconds>(t1 - t0).count();
-            total_ms_accum += ms;
+        // Workspace buffers (re)allocated after each worker's first image
+        std::atomic<std::size_t> steadyAllocs{0};
 
-            // inline timing
-            std::cout << mce::ansi::muted << "        [" << ms << " ms]"
-                      << mce::ansi::reset << "\n";
+        // Three-stage pipeline over bounded lock-free queues:
+        //   readers (decode) → detector workers → this thread (CSV + console)
+        // A full queue blocks its producer, so at most a few decoded frames
+        // per worker are in memory. In sequence mode reader r feeds only
+        // worker r and reads whole sequences, so a worker sees each
+        // sequence's frames in order and can carry the prior across them.
+        std::vector<std::unique_ptr<mce::BoundedQueue<Decoded>>> decoded;
+        for (int q = 0; q < nQueues; ++q)
+            decoded.push_back(std::make_unique<mce::BoundedQueue<Decoded>>(std::max(2, 2 * workers / nQueues)));
+        mce::BoundedQueue<ImageResult> results(std::max(4, 2 * workers));
 
-            // ---- CSV row ----
-            if (!ok || !out.found)
-            {
-                csv << i << "," << '"' << path << '"' << ",0," // index,input,found
-                    << ","                                     // percent
-                    << ","                                     // angle_deg
-                    << ","                                     // occupancy
-                    << ","                                     // hue_score
-                    << ",";                                    // line_ok
+        StageStats readStage, detectStage, writeStage;
+        readStage.threads = readers;
+        detectStage.threads = workers;
+        writeStage.threads = 1;
 
-                if (state.saveDebug)
+        std::atomic<int> nextUnit{0}, readersLeft{readers};
+        std::vector<std::thread> pool;
+        pool.reserve(readers + workers);
+        for (int rd = 0; rd < readers; ++rd)
+        {
+            pool.emplace_back([&, rd]
+                              {
+                mce::BoundedQueue<Decoded> &q = *decoded[rd % nQueues];
+                for (int u = nextUnit.fetch_add(1); u < (int)units.size(); u = nextUnit.fetch_add(1))
                 {
-                    csv << "," << "," << "," // debug_quad, debug_warp, debug_mask
-                        << "," << ",";       // debug_crop, debug_clip
+                    for (int k = units[u].first; k < units[u].second; ++k)
+                    {
+                        const auto t0 = clock::now();
+                        Decoded d = decode_one(k + 1, u, images[k], state);
+                        readStage.busyNs += ns_since(t0);
+                        readStage.blockedNs += mce::push_wait(q, d);
+                    }
                 }
-                else
+                // The last reader out ends the input: one marker per worker
+                if (readersLeft.fetch_sub(1) == 1)
                 {
-                    csv << "," << "," << "," << "," << ","; // 5 empty debug columns
+                    for (int w = 0; w < workers; ++w)
+                    {
+                        Decoded end;
+                        readStage.blockedNs += mce::push_wait(*decoded[w % nQueues], end);
+                    }
+                } });
+        }
+        for (int w = 0; w < workers; ++w)
+        {
+            pool.emplace_back([&, w]
+                              {
+                WorkerDetector wd(opt);
+                wd.det.set_debug_sink(sink.get());
+                mce::BoundedQueue<Decoded> &q = *decoded[w % nQueues];
+                mce::TrackPrior prior; // sequence mode: previous frame of `unit`
+                int unit = -1;
+                for (;;)
+                {
+                    Decoded d;
+                    detectStage.starvedNs += mce::pop_wait(q, d);
+                    if (d.index == 0)
+                        break;
+                    if (d.unit != unit)
+                    {
+                        prior = mce::TrackPrior{};
+                        unit = d.unit;
+                    }
+                    const auto t0 = clock::now();
+                    ImageResult r = detect_one(d, state, wd, debugDir, state.sequence ? &prior : nullptr);
+                    d.img.release();
+                    detectStage.busyNs += ns_since(t0);
+                    detectStage.blockedNs += mce::push_wait(results, r);
                 }
+                steadyAllocs += wd.steady_allocations(); });
+        }
 
-                csv << ms << "," // elapsed_ms
-                    << out.Smin << "," << out.Vmin << "," << out.Vmax
-                    << "\n";
-            }
-            else
+        // Writer: rows go out strictly in input order; results that arrive
+        // early wait in `pending` (small: no images)
+        {
+            std::vector<ImageResult> pending(N);
+            std::vector<char> ready(N, 0);
+            int nextOut = 0;
+            while (nextOut < N)
             {
-                // found == 1
-                csv << i << "," << '"' << path << '"' << ",1,"
-                    << out.coverage_percent << ","
-                    << std::fixed << std::setprecision(2) << out.best_angle_deg << ","
-                    << out.occupancy << ","
-                    << out.hue_score << ","
-                    << (out.line_ok ? 1 : 0) << ",";
-
-                if (state.saveDebug)
+                ImageResult r;
+                writeStage.starvedNs += mce::pop_wait(results, r);
+                const auto t0 = clock::now();
+                const int k = r.index - 1;
+                pending[k] = std::move(r);
+                ready[k] = 1;
+                for (; nextOut < N && ready[nextOut]; ++nextOut)
                 {
-                    csv << '"' << out.debug_quad_path << '"' << ","
-                        << '"' << out.debug_warp_path << '"' << ","
-                        << '"' << out.debug_mask_path << '"' << ","
-                        << '"' << cropPath << '"' << ","
-                        << '"' << clipPath << '"';
+                    account(pending[nextOut]);
+                    pending[nextOut] = ImageResult{};
                 }
-                else
-                {
-                    csv << ",,,,"; // five empty debug columns
-                }
-
-                csv << "," << ms << ","
-                    << out.Smin << ","
-                    << out.Vmin << ","
-                    << out.Vmax << "\n";
+                writeStage.busyNs += ns_since(t0);
             }
         }
+        for (auto &t : pool)
+            t.join();
+        if (sink)
+            sink->flush();
+        if (!resultSink->finish())
+        {
+            summary.outputOk = false;
+            std::cerr << "[ERR] Writing results failed: " << summary.resultsPath << "\n";
+        }
+
+        if (workers > 1)
+            cv::setNumThreads(cvThreadsBefore);
 
         auto run_t1 = clock::now();
         long long run_ms = duration_cast<milliseconds>(run_t1 - run_t0).count();
         double avg_ms = (N > 0) ? (double)total_ms_accum / (double)N : 0.0;
         double ips = (run_ms > 0) ? (1000.0 * (double)N / (double)run_ms) : 0.0;
+        summary.found = foundCount;
+        summary.run_ms = run_ms;
 
         std::cout << "\n"
                   << mce::ansi::bold << "Found " << foundCount << "/"
-                  << N << mce::ansi::reset << " images with a valid marker.\n"
+                  << N << mce::ansi::reset << " images with a valid marker"
+                  << (state.multiMarker ? " (" + std::to_string(markerCount) + " markers)" : "")
+                  << (state.sequence ? " (" + std::to_string(trackedCount) + " tracked)" : "") << ".\n"
                   << mce::ansi::muted
                   << "Total: " << run_ms << " ms, "
                   << "Avg: " << std::fixed << std::setprecision(1) << avg_ms << " ms/img, "
                   << std::setprecision(2) << ips << " img/s"
-                  << mce::ansi::reset << "\n\n";
+                  << " (" << workers << (workers == 1 ? " worker" : " workers") << ")"
+                  << mce::ansi::reset << "\n";
+        if (N > 0)
+        {
+            std::cout << mce::ansi::muted << "Stages (avg ms/img): " << std::setprecision(1)
+                      << "decode " << decodeSum / N
+                      << ", mask " << stageSum.mask / N
+                      << ", component " << stageSum.component / N
+                      << ", sweep " << stageSum.sweep / N
+                      << ", validate " << stageSum.validate / N;
+            if (state.pyramid)
+                std::cout << ", refine " << stageSum.refine / N;
+            if (state.saveDebug)
+                std::cout << ", write " << writeSum / N;
+            std::cout << mce::ansi::reset << "\n";
+            std::cout << mce::ansi::muted << "Pipeline: ";
+            readStage.print(std::cout, "read", run_ms);
+            std::cout << " | ";
+            detectStage.print(std::cout, "detect", run_ms);
+            std::cout << " | ";
+            writeStage.print(std::cout, "write", run_ms);
+            std::cout << mce::ansi::reset << "\n";
+            if (sink)
+            {
+                const mce::DebugSink::Stats ds = sink->stats();
+                std::cout << mce::ansi::muted << "Debug writer: " << capturedCount << "/" << N << " image(s) captured, "
+                          << ds.written << " file(s), "
+                          << std::setprecision(1) << ds.bytes / (1024.0 * 1024.0) << " MB, encode "
+                          << ds.encode_ms << " ms on " << state.debugWriters << " thread(s), detect waited "
+                          << ds.blocked_ms << " ms";
+                if (ds.failed > 0)
+                    std::cout << ", " << ds.failed << " failed";
+                std::cout << mce::ansi::reset << "\n";
+            }
+            if (opt.gate_min_hues > 0)
+                std::cout << mce::ansi::muted << "Pre-sweep gate: " << gateImages << " image(s) short-circuited, "
+                          << gateRejects << " component(s) rejected (min " << opt.gate_min_hues << " hues)"
+                          << mce::ansi::reset << "\n";
+
+            // Cascade counters: runs / pass rate / mean cost per validator
+            std::cout << mce::ansi::muted << "Validators (runs, pass%, avg ms):";
+            bool first = true;
+            for (int k = 0; k < mce::kValidatorCount; ++k)
+            {
+                const auto v = static_cast<mce::Validator>(k);
+                if (!mce::validator_enabled(opt, v))
+                    continue;
+                const mce::ValidatorStats st = mce::validator_stats(v);
+                std::cout << (first ? " " : ", ") << mce::validator_name(v) << " " << st.runs << " "
+                          << std::setprecision(0) << (st.runs ? 100.0 * st.passes / st.runs : 0.0) << "% "
+                          << std::setprecision(2) << (st.runs ? st.total_ms / st.runs : 0.0);
+                first = false;
+            }
+            std::cout << mce::ansi::reset << "\n";
+            std::cout << mce::ansi::muted << "Validator order ("
+                      << (opt.validator_order.empty() ? "adaptive, now" : "pinned") << "):";
+            const auto order = opt.validator_order.empty() ? mce::adaptive_validator_order()
+                                                           : opt.validator_order;
+            first = true;
+            for (mce::Validator v : order)
+            {
+                if (!mce::validator_enabled(opt, v))
+                    continue;
+                std::cout << (first ? " " : " > ") << mce::validator_name(v);
+                first = false;
+            }
+            std::cout << mce::ansi::reset << "\n";
+        }
+        if (state.debug)
+        {
+            std::cout << mce::ansi::muted << "Workspace allocations after warm-up: "
+                      << steadyAllocs.load() << mce::ansi::reset << "\n";
+            std::cout << mce::ansi::muted << "Angle sweep: " << sweepScored << " scored, "
+                      << sweepValidated << " validated, " << sweepSkipped << " warps skipped"
+                      << " (top-K " << opt.validate_top_k << ")" << mce::ansi::reset << "\n";
+            std::cout << mce::ansi::muted << "Angle cache: " << cacheHits << "/" << cacheLookups << " hits ("
+                      << std::setprecision(1) << (cacheLookups > 0 ? 100.0 * cacheHits / cacheLookups : 0.0)
+                      << "%)" << mce::ansi::reset << "\n";
+        }
+        if (state.quiet)
+            std::cout << mce::ansi::muted << "Results: " << summary.resultsPath
+                      << mce::ansi::reset << "\n";
+        std::cout << "\n";
+        return summary;
+    }
+
+    RenderSummary render_debug_from_results(const std::string &resultsPath, const RenderRequest &req,
+                                            const app::State &state)
+    {
+        RenderSummary sum;
+        std::vector<StoredRow> rows;
+        const bool columnar = fs::path(resultsPath).extension() == ".mcec";
+        if (!(columnar ? load_columnar_rows(resultsPath, rows) : load_csv_rows(resultsPath, rows)))
+        {
+            sum.inputOk = false;
+            std::cerr << "[ERR] Cannot read results (an MCE .csv or .mcec file): " << resultsPath << "\n";
+            return sum;
+        }
+
+        const fs::path outDir = req.outDir.empty()
+                                    ? fs::path(resultsPath).parent_path().parent_path() / "debug" / fs::path(resultsPath).stem()
+                                    : fs::path(req.outDir);
+        ensure_dir(outDir);
+
+        mce::DebugSink sink(state.debugWriters, debug_encoding(state), 4 * (std::size_t)state.debugWriters);
+        mce::Detector det;
+        det.set_debug_sink(&sink);
+
+        // Rows of one image are adjacent; the image is read once for them
+        int loadedIndex = -1;
+        cv::Mat img;
+        for (StoredRow &row : rows)
+        {
+            const bool found = row.out.found;
+            if ((!req.indices.empty() && std::find(req.indices.begin(), req.indices.end(), row.index) == req.indices.end()) ||
+                (req.failuresOnly && found) || !row.thresholds)
+                continue;
+            ++sum.rows;
+
+            const bool firstRow = row.index != loadedIndex;
+            if (firstRow)
+            {
+                loadedIndex = row.index;
+                img = cv::imread(row.path, cv::IMREAD_COLOR);
+                if (img.empty())
+                {
+                    ++sum.readFailed;
+                    std::cerr << "[ERR] Cannot read " << row.path << "\n";
+                }
+            }
+            if (img.empty())
+                continue;
+
+            // Same names as the batch's own artifacts: a --multi run names
+            // every marker "_m<k>", even an image's only one
+            mce::DetectOutput &o = row.out;
+            const std::string base = (outDir / (std::to_string(row.index) + "_" + stem_of(row.path))).string();
+            const std::string markerBase = row.multi ? base + "_m" + std::to_string(row.marker) : base;
+            try
+            {
+                det.render_debug(img, o, firstRow ? base : std::string(), markerBase);
+            }
+            catch (const std::exception &e)
+            {
+                mce::log::e("debug render failed on " + row.path + ": " + e.what());
+                continue;
+            }
+            ++sum.rendered;
+            for (const std::string *p : {&o.debug_mask_path, &o.debug_quad_path, &o.debug_crop_path, &o.debug_clip_path})
+                if (!p->empty())
+                    std::cout << *p << "\n";
+        }
+        sink.flush();
+        return sum;
     }
 
 } // namespace app::progress
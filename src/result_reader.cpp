@@ -0,0 +1,257 @@
+// src/result_reader.cpp — memory-mapped reader for columnar (.mcec) results
+#include "mce/result_sink.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace mce::io
+{
+    namespace
+    {
+        std::size_t pad8(std::size_t n) { return (n + 7) / 8 * 8; }
+
+        template <class T>
+        T load(const std::uint8_t *p)
+        {
+            T v;
+            std::memcpy(&v, p, sizeof v);
+            return v;
+        }
+
+        // Bytes of one column's values in a group of `rows` (offsets only
+        // for Text; the string bytes follow them)
+        std::size_t value_bytes(ResultType t, std::size_t rows)
+        {
+            switch (t)
+            {
+            case ResultType::Int:
+            case ResultType::Real:
+                return 8 * rows;
+            case ResultType::Bool:
+                return rows;
+            case ResultType::Text:
+                return 4 * (rows + 1);
+            case ResultType::Points:
+                return 32 * rows;
+            }
+            return 0;
+        }
+    } // namespace
+
+    ColumnarReader::~ColumnarReader()
+    {
+        close();
+    }
+
+    void ColumnarReader::close()
+    {
+        if (base_)
+        {
+#if defined(_WIN32)
+            UnmapViewOfFile(base_);
+            CloseHandle((HANDLE)mapping_);
+#else
+            munmap((void *)base_, size_);
+#endif
+        }
+        base_ = nullptr;
+        mapping_ = nullptr;
+        size_ = rows_ = 0;
+        names_.clear();
+        types_.clear();
+        groups_.clear();
+    }
+
+    bool ColumnarReader::open(const std::string &path)
+    {
+        close();
+#if defined(_WIN32)
+        HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                                  FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE)
+            return false;
+        LARGE_INTEGER len;
+        HANDLE map = nullptr;
+        if (GetFileSizeEx(file, &len) && len.QuadPart > 0)
+            map = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        CloseHandle(file);
+        if (!map)
+            return false;
+        base_ = (const std::uint8_t *)MapViewOfFile(map, FILE_MAP_READ, 0, 0, 0);
+        if (!base_)
+        {
+            CloseHandle(map);
+            return false;
+        }
+        mapping_ = map;
+        size_ = (std::size_t)len.QuadPart;
+#else
+        const int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            return false;
+        struct stat st;
+        void *p = MAP_FAILED;
+        if (fstat(fd, &st) == 0 && st.st_size > 0)
+            p = mmap(nullptr, (std::size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (p == MAP_FAILED)
+            return false;
+        base_ = (const std::uint8_t *)p;
+        size_ = (std::size_t)st.st_size;
+#endif
+
+        // Header
+        if (size_ < 16 + 32 || std::memcmp(base_, "MCECOL1", 8) != 0 ||
+            std::memcmp(base_ + size_ - 8, "MCECEND", 8) != 0)
+        {
+            close();
+            return false;
+        }
+        const std::uint32_t ncols = load<std::uint32_t>(base_ + 8);
+        std::size_t pos = 16;
+        for (std::uint32_t c = 0; c < ncols; ++c)
+        {
+            if (pos + 4 > size_)
+            {
+                close();
+                return false;
+            }
+            const std::uint8_t type = base_[pos];
+            const std::uint16_t len = load<std::uint16_t>(base_ + pos + 2);
+            if (type > (std::uint8_t)ResultType::Points || pos + 4 + len > size_)
+            {
+                close();
+                return false;
+            }
+            types_.push_back((ResultType)type);
+            names_.emplace_back((const char *)base_ + pos + 4, len);
+            pos += 4 + len;
+        }
+
+        // Footer, then each group's column sections
+        const std::uint64_t ngroups = load<std::uint64_t>(base_ + size_ - 24);
+        rows_ = (std::size_t)load<std::uint64_t>(base_ + size_ - 16);
+        if (ngroups > (size_ - 24) / 8)
+        {
+            close();
+            return false;
+        }
+        const std::uint8_t *offsets = base_ + size_ - 24 - 8 * ngroups;
+        std::size_t first = 0;
+        for (std::uint64_t g = 0; g < ngroups; ++g)
+        {
+            pos = (std::size_t)load<std::uint64_t>(offsets + 8 * g);
+            if (pos + 8 > size_)
+            {
+                close();
+                return false;
+            }
+            Group grp;
+            grp.first = first;
+            grp.rows = load<std::uint32_t>(base_ + pos);
+            pos += 8;
+            for (std::size_t c = 0; c < ncols; ++c)
+            {
+                const std::size_t vbytes = pad8((grp.rows + 7) / 8);
+                const std::size_t dbytes = pad8(value_bytes(types_[c], grp.rows));
+                if (pos + vbytes + dbytes > size_)
+                {
+                    close();
+                    return false;
+                }
+                grp.validity.push_back(base_ + pos);
+                grp.data.push_back(base_ + pos + vbytes);
+                grp.textBytes.push_back(0);
+                pos += vbytes + dbytes;
+                if (types_[c] == ResultType::Text) // string bytes after the offsets
+                {
+                    grp.textBytes.back() = load<std::uint32_t>(grp.data.back() + 4 * grp.rows);
+                    pos += pad8(grp.textBytes.back());
+                }
+            }
+            if (pos > size_)
+            {
+                close();
+                return false;
+            }
+            first += grp.rows;
+            groups_.push_back(std::move(grp));
+        }
+        if (first != rows_)
+        {
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    int ColumnarReader::column(std::string_view name) const
+    {
+        const auto it = std::find(names_.begin(), names_.end(), name);
+        return it == names_.end() ? -1 : (int)(it - names_.begin());
+    }
+
+    const ColumnarReader::Group &ColumnarReader::locate(std::size_t r, std::size_t &local) const
+    {
+        const auto it = std::upper_bound(groups_.begin(), groups_.end(), r, [](std::size_t row, const Group &g)
+                                         { return row < g.first; });
+        const Group &g = *(it - 1);
+        local = r - g.first;
+        return g;
+    }
+
+    bool ColumnarReader::valid(int c, std::size_t r) const
+    {
+        std::size_t k;
+        const Group &g = locate(r, k);
+        return (g.validity[c][k / 8] >> (k % 8)) & 1;
+    }
+
+    long long ColumnarReader::integer(int c, std::size_t r) const
+    {
+        std::size_t k;
+        const Group &g = locate(r, k);
+        if (types_[c] == ResultType::Bool)
+            return g.data[c][k];
+        return load<long long>(g.data[c] + 8 * k);
+    }
+
+    double ColumnarReader::real(int c, std::size_t r) const
+    {
+        std::size_t k;
+        const Group &g = locate(r, k);
+        return load<double>(g.data[c] + 8 * k);
+    }
+
+    std::string_view ColumnarReader::text(int c, std::size_t r) const
+    {
+        std::size_t k;
+        const Group &g = locate(r, k);
+        const std::uint32_t a = load<std::uint32_t>(g.data[c] + 4 * k);
+        const std::uint32_t b = load<std::uint32_t>(g.data[c] + 4 * (k + 1));
+        if (a > b || b > g.textBytes[c]) // corrupt offsets: never read outside the group's bytes
+            return {};
+        const char *bytes = (const char *)g.data[c] + pad8(4 * (g.rows + 1));
+        return std::string_view(bytes + a, b - a);
+    }
+
+    const float *ColumnarReader::points(int c, std::size_t r) const
+    {
+        std::size_t k;
+        const Group &g = locate(r, k);
+        return (const float *)(g.data[c] + 32 * k); // 8-byte aligned section
+    }
+
+} // namespace mce::io
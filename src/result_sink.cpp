@@ -0,0 +1,488 @@
+// src/result_sink.cpp — results schema + CSV / JSON Lines / columnar writers
+#include "mce/result_sink.hpp"
+
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+
+namespace mce::io
+{
+    namespace
+    {
+        // ============================== Schema ==============================
+        ResultValue integer(long long v)
+        {
+            ResultValue x;
+            x.null = false;
+            x.i = v;
+            return x;
+        }
+        ResultValue real(double v)
+        {
+            ResultValue x;
+            x.null = false;
+            x.d = v;
+            return x;
+        }
+        ResultValue boolean(bool v) { return integer(v ? 1 : 0); }
+        ResultValue text(std::string_view s) // empty = null
+        {
+            ResultValue x;
+            x.null = s.empty();
+            x.s = s;
+            return x;
+        }
+
+        bool has_marker(const ResultRow &r) { return r.marker > 0 && r.out; }
+        bool has_result(const ResultRow &r) { return r.read_ok && r.out; }
+
+        const std::vector<ResultColumn> kSchema = {
+            {"index", ResultType::Int, 0, [](const ResultRow &r)
+             { return integer(r.index); }},
+            {"input_path", ResultType::Text, 0, [](const ResultRow &r)
+             { return text(r.path); }},
+            {"found", ResultType::Bool, 0, [](const ResultRow &r)
+             { return boolean(has_marker(r)); }},
+            {"percent", ResultType::Int, 0, [](const ResultRow &r)
+             { return has_marker(r) ? integer(r.out->coverage_percent) : ResultValue{}; }},
+            {"angle_deg", ResultType::Real, 2, [](const ResultRow &r)
+             { return has_marker(r) ? real(r.out->best_angle_deg) : ResultValue{}; }},
+            {"occupancy", ResultType::Real, 2, [](const ResultRow &r)
+             { return has_marker(r) ? real(r.out->occupancy) : ResultValue{}; }},
+            {"hue_score", ResultType::Real, 2, [](const ResultRow &r)
+             { return has_marker(r) ? real(r.out->hue_score) : ResultValue{}; }},
+            {"line_ok", ResultType::Bool, 0, [](const ResultRow &r)
+             { return has_marker(r) ? boolean(r.out->line_ok) : ResultValue{}; }},
+            {"debug_quad", ResultType::Text, 0, [](const ResultRow &r)
+             { return has_result(r) ? text(r.out->debug_quad_path) : ResultValue{}; }},
+            {"debug_warp", ResultType::Text, 0, [](const ResultRow &r)
+             { return has_result(r) ? text(r.out->debug_warp_path) : ResultValue{}; }},
+            {"debug_mask", ResultType::Text, 0, [](const ResultRow &r)
+             { return has_result(r) ? text(r.out->debug_mask_path) : ResultValue{}; }},
+            {"debug_crop", ResultType::Text, 0, [](const ResultRow &r)
+             { return has_result(r) ? text(r.out->debug_crop_path) : ResultValue{}; }},
+            {"debug_clip", ResultType::Text, 0, [](const ResultRow &r)
+             { return has_result(r) ? text(r.out->debug_clip_path) : ResultValue{}; }},
+            {"elapsed_ms", ResultType::Int, 0, [](const ResultRow &r)
+             { return integer(r.elapsed_ms); }},
+            {"Smin", ResultType::Int, 0, [](const ResultRow &r)
+             { return has_result(r) ? integer(r.out->Smin) : ResultValue{}; }},
+            {"Vmin", ResultType::Int, 0, [](const ResultRow &r)
+             { return has_result(r) ? integer(r.out->Vmin) : ResultValue{}; }},
+            {"Vmax", ResultType::Int, 0, [](const ResultRow &r)
+             { return has_result(r) ? integer(r.out->Vmax) : ResultValue{}; }},
+            {"decode_ms", ResultType::Real, 2, [](const ResultRow &r)
+             { return real(r.decode_ms); }},
+            {"detect_ms", ResultType::Real, 2, [](const ResultRow &r)
+             { return real(r.detect_ms); }},
+            {"write_ms", ResultType::Real, 2, [](const ResultRow &r)
+             { return real(r.write_ms); }},
+            {"marker", ResultType::Int, 0, [](const ResultRow &r)
+             { return r.multi ? integer(r.marker) : ResultValue{}; }},
+            {"image_markers", ResultType::Int, 0, [](const ResultRow &r)
+             { return integer(r.image_markers); }},
+            {"image_percent", ResultType::Int, 0, [](const ResultRow &r)
+             { return integer(r.image_percent); }},
+            {"tracked", ResultType::Bool, 0, [](const ResultRow &r)
+             { return boolean(r.tracked); }},
+            {"decode_scale", ResultType::Int, 0, [](const ResultRow &r)
+             { return integer(r.decode_scale); }},
+            {"debug_policy", ResultType::Text, 0, [](const ResultRow &r)
+             { return text(r.debug_policy); }},
+            {"quad", ResultType::Points, 0, [](const ResultRow &r)
+             {
+                 ResultValue x;
+                 if (has_marker(r) && r.out->quad.size() == 4)
+                 {
+                     x.null = false;
+                     x.pts = r.out->quad.data();
+                 }
+                 return x;
+             }},
+        };
+
+        // ============================== Text formatting ==============================
+        void put_int(std::string &b, long long v)
+        {
+            char t[24];
+            const auto res = std::to_chars(t, t + sizeof t, v);
+            b.append(t, res.ptr);
+        }
+
+        void put_real(std::string &b, double v, int precision)
+        {
+            char t[64];
+            auto res = std::to_chars(t, t + sizeof t, v, std::chars_format::fixed, precision);
+            if (res.ec != std::errc()) // too long for fixed notation
+                res = std::to_chars(t, t + sizeof t, v);
+            b.append(t, res.ptr);
+        }
+
+        // RFC 4180: quotes around, inner quotes doubled
+        void put_csv_text(std::string &b, std::string_view s)
+        {
+            b += '"';
+            for (char c : s)
+            {
+                if (c == '"')
+                    b += '"';
+                b += c;
+            }
+            b += '"';
+        }
+
+        void put_json_text(std::string &b, std::string_view s)
+        {
+            static const char hex[] = "0123456789abcdef";
+            b += '"';
+            for (char c : s)
+            {
+                const unsigned char u = (unsigned char)c;
+                if (c == '"' || c == '\\')
+                {
+                    b += '\\';
+                    b += c;
+                }
+                else if (u < 0x20)
+                {
+                    b += "\\u00";
+                    b += hex[u >> 4];
+                    b += hex[u & 15];
+                }
+                else
+                    b += c;
+            }
+            b += '"';
+        }
+
+        // Buffered file output: rows are formatted into `buf_` and written
+        // in large blocks
+        class TextSink : public ResultSink
+        {
+        public:
+            explicit TextSink(const std::string &path)
+            {
+                path_ = path;
+                f_.open(path, std::ios::binary | std::ios::trunc);
+                buf_.reserve(kFlushBytes + 4096);
+            }
+            bool ok() const override { return f_.good(); }
+            bool finish() override
+            {
+                flush();
+                f_.close();
+                return !f_.fail();
+            }
+
+        protected:
+            static constexpr std::size_t kFlushBytes = 1 << 16;
+            void end_row()
+            {
+                buf_ += '\n';
+                if (buf_.size() >= kFlushBytes)
+                    flush();
+            }
+            void flush()
+            {
+                f_.write(buf_.data(), (std::streamsize)buf_.size());
+                buf_.clear();
+            }
+
+            std::ofstream f_;
+            std::string buf_;
+        };
+
+        class CsvSink final : public TextSink
+        {
+        public:
+            explicit CsvSink(const std::string &path) : TextSink(path)
+            {
+                const auto &schema = result_schema();
+                for (std::size_t c = 0; c < schema.size(); ++c)
+                {
+                    if (c)
+                        buf_ += ',';
+                    buf_ += schema[c].name;
+                }
+                end_row();
+            }
+
+            // Nulls are empty fields; quads are "x0 y0 ... x3 y3"
+            void write(const ResultRow &row) override
+            {
+                const auto &schema = result_schema();
+                for (std::size_t c = 0; c < schema.size(); ++c)
+                {
+                    if (c)
+                        buf_ += ',';
+                    const ResultValue v = schema[c].get(row);
+                    if (v.null)
+                        continue;
+                    switch (schema[c].type)
+                    {
+                    case ResultType::Int:
+                    case ResultType::Bool:
+                        put_int(buf_, v.i);
+                        break;
+                    case ResultType::Real:
+                        put_real(buf_, v.d, schema[c].precision);
+                        break;
+                    case ResultType::Text:
+                        put_csv_text(buf_, v.s);
+                        break;
+                    case ResultType::Points:
+                        for (int k = 0; k < 4; ++k)
+                        {
+                            if (k)
+                                buf_ += ' ';
+                            put_real(buf_, v.pts[k].x, 2);
+                            buf_ += ' ';
+                            put_real(buf_, v.pts[k].y, 2);
+                        }
+                        break;
+                    }
+                }
+                end_row();
+            }
+        };
+
+        class JsonlSink final : public TextSink
+        {
+        public:
+            explicit JsonlSink(const std::string &path) : TextSink(path) {}
+
+            // One object per row; nulls (and non-finite reals) are null,
+            // quads are [x0, y0, ..., x3, y3]
+            void write(const ResultRow &row) override
+            {
+                const auto &schema = result_schema();
+                buf_ += '{';
+                for (std::size_t c = 0; c < schema.size(); ++c)
+                {
+                    if (c)
+                        buf_ += ',';
+                    buf_ += '"';
+                    buf_ += schema[c].name;
+                    buf_ += "\":";
+                    const ResultValue v = schema[c].get(row);
+                    if (v.null)
+                    {
+                        buf_ += "null";
+                        continue;
+                    }
+                    switch (schema[c].type)
+                    {
+                    case ResultType::Int:
+                        put_int(buf_, v.i);
+                        break;
+                    case ResultType::Bool:
+                        buf_ += v.i ? "true" : "false";
+                        break;
+                    case ResultType::Real:
+                        if (std::isfinite(v.d))
+                            put_real(buf_, v.d, schema[c].precision);
+                        else
+                            buf_ += "null";
+                        break;
+                    case ResultType::Text:
+                        put_json_text(buf_, v.s);
+                        break;
+                    case ResultType::Points:
+                        buf_ += '[';
+                        for (int k = 0; k < 4; ++k)
+                        {
+                            if (k)
+                                buf_ += ',';
+                            put_real(buf_, v.pts[k].x, 2);
+                            buf_ += ',';
+                            put_real(buf_, v.pts[k].y, 2);
+                        }
+                        buf_ += ']';
+                        break;
+                    }
+                }
+                buf_ += '}';
+                end_row();
+            }
+        };
+
+        // ============================== Columnar ==============================
+        // Rows are collected per column and written as a row group every
+        // kGroupRows rows (layout: see ColumnarReader)
+        class ColumnarSink final : public ResultSink
+        {
+        public:
+            explicit ColumnarSink(const std::string &path)
+            {
+                path_ = path;
+                f_.open(path, std::ios::binary | std::ios::trunc);
+                const auto &schema = result_schema();
+                cols_.resize(schema.size());
+                put("MCECOL1", 8);
+                put_u32((std::uint32_t)schema.size());
+                put_u32(0);
+                for (const ResultColumn &c : schema)
+                {
+                    const std::uint8_t tag[2] = {(std::uint8_t)c.type, 0};
+                    const std::uint16_t len = (std::uint16_t)std::strlen(c.name);
+                    put(tag, 2);
+                    put(&len, 2);
+                    put(c.name, len);
+                }
+                pad8();
+            }
+
+            bool ok() const override { return f_.good(); }
+
+            void write(const ResultRow &row) override
+            {
+                const auto &schema = result_schema();
+                if (n_ % 8 == 0)
+                    for (Col &c : cols_)
+                        c.valid.push_back(0);
+                for (std::size_t k = 0; k < schema.size(); ++k)
+                {
+                    Col &c = cols_[k];
+                    const ResultValue v = schema[k].get(row);
+                    if (!v.null)
+                        c.valid.back() |= (std::uint8_t)(1u << (n_ % 8));
+                    switch (schema[k].type)
+                    {
+                    case ResultType::Int:
+                        c.i.push_back(v.i);
+                        break;
+                    case ResultType::Bool:
+                        c.b.push_back((std::uint8_t)v.i);
+                        break;
+                    case ResultType::Real:
+                        c.d.push_back(v.d);
+                        break;
+                    case ResultType::Text:
+                        if (c.off.empty())
+                            c.off.push_back(0);
+                        c.bytes.append(v.s.data(), v.s.size());
+                        c.off.push_back((std::uint32_t)c.bytes.size());
+                        break;
+                    case ResultType::Points:
+                        for (int p = 0; p < 4; ++p)
+                        {
+                            c.pts.push_back(v.null ? 0.0f : v.pts[p].x);
+                            c.pts.push_back(v.null ? 0.0f : v.pts[p].y);
+                        }
+                        break;
+                    }
+                }
+                if (++n_ == kGroupRows)
+                    flush_group();
+            }
+
+            bool finish() override
+            {
+                if (n_ > 0)
+                    flush_group();
+                for (std::uint64_t g : groups_)
+                    put(&g, 8);
+                const std::uint64_t tail[2] = {groups_.size(), rows_};
+                put(tail, sizeof tail);
+                put("MCECEND", 8);
+                f_.close();
+                return !f_.fail();
+            }
+
+        private:
+            static constexpr std::size_t kGroupRows = 4096;
+
+            struct Col
+            {
+                std::vector<std::uint8_t> valid;
+                std::vector<long long> i;
+                std::vector<double> d;
+                std::vector<std::uint8_t> b;
+                std::vector<std::uint32_t> off;
+                std::string bytes;
+                std::vector<float> pts;
+            };
+
+            void put(const void *p, std::size_t n)
+            {
+                f_.write((const char *)p, (std::streamsize)n);
+                pos_ += n;
+            }
+            void put_u32(std::uint32_t v) { put(&v, 4); }
+            void pad8()
+            {
+                static const char zeros[8] = {};
+                put(zeros, (8 - pos_ % 8) % 8);
+            }
+            template <class T>
+            void put_vec(const std::vector<T> &v)
+            {
+                put(v.data(), v.size() * sizeof(T));
+                pad8();
+            }
+
+            void flush_group()
+            {
+                groups_.push_back(pos_);
+                rows_ += n_;
+                put_u32((std::uint32_t)n_);
+                put_u32(0);
+                const auto &schema = result_schema();
+                for (std::size_t k = 0; k < cols_.size(); ++k)
+                {
+                    Col &c = cols_[k];
+                    put_vec(c.valid);
+                    switch (schema[k].type)
+                    {
+                    case ResultType::Int:
+                        put_vec(c.i);
+                        break;
+                    case ResultType::Bool:
+                        put_vec(c.b);
+                        break;
+                    case ResultType::Real:
+                        put_vec(c.d);
+                        break;
+                    case ResultType::Text:
+                        put_vec(c.off);
+                        put(c.bytes.data(), c.bytes.size());
+                        pad8();
+                        break;
+                    case ResultType::Points:
+                        put_vec(c.pts);
+                        break;
+                    }
+                    c = Col{};
+                }
+                n_ = 0;
+            }
+
+            std::ofstream f_;
+            std::uint64_t pos_ = 0, rows_ = 0;
+            std::size_t n_ = 0; // rows in the open group
+            std::vector<Col> cols_;
+            std::vector<std::uint64_t> groups_;
+        };
+    } // namespace
+
+    const std::vector<ResultColumn> &result_schema()
+    {
+        return kSchema;
+    }
+
+    bool result_format_known(const std::string &format)
+    {
+        return format == "csv" || format == "jsonl" || format == "columnar";
+    }
+
+    std::unique_ptr<ResultSink> make_result_sink(const std::string &format, const std::string &stem)
+    {
+        if (format == "jsonl")
+            return std::make_unique<JsonlSink>(stem + ".jsonl");
+        if (format == "columnar")
+            return std::make_unique<ColumnarSink>(stem + ".mcec");
+        return std::make_unique<CsvSink>(stem + ".csv");
+    }
+
+} // namespace mce::io
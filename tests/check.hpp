@@ -0,0 +1,46 @@
+#pragma once
+// Minimal assertion helpers for the ctest executables: a failed CHECK
+// prints its location and marks the run failed; main returns
+// mce_test::result().
+#include <iostream>
+
+namespace mce_test
+{
+    inline int &failures()
+    {
+        static int n = 0;
+        return n;
+    }
+
+    inline int result()
+    {
+        if (failures())
+            std::cerr << failures() << " check(s) failed\n";
+        return failures() ? 1 : 0;
+    }
+
+    // ctest SKIP_RETURN_CODE (e.g. an ISA this CPU lacks)
+    constexpr int kSkip = 77;
+} // namespace mce_test
+
+#define CHECK(cond)                                                                     \
+    do                                                                                  \
+    {                                                                                   \
+        if (!(cond))                                                                    \
+        {                                                                               \
+            ++mce_test::failures();                                                     \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": CHECK(" #cond ") failed\n"; \
+        }                                                                               \
+    } while (0)
+
+// CHECK with extra context streamed after the message
+#define CHECK_MSG(cond, msg)                                                            \
+    do                                                                                  \
+    {                                                                                   \
+        if (!(cond))                                                                    \
+        {                                                                               \
+            ++mce_test::failures();                                                     \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": CHECK(" #cond ") failed: "   \
+                      << msg << "\n";                                                   \
+        }                                                                               \
+    } while (0)
@@ -0,0 +1,78 @@
+# Helpers for the CLI end-to-end scripts (cmake -P). Callers pass
+# -DMCE=<MCE_by_IV> -DEXAMPLE=<example dir> -DWORK=<scratch dir>.
+
+cmake_policy(VERSION 3.15)
+
+foreach (var MCE EXAMPLE WORK)
+  if (NOT DEFINED ${var})
+    message(FATAL_ERROR "${var} not set")
+  endif()
+endforeach()
+file(REMOVE_RECURSE "${WORK}")
+file(MAKE_DIRECTORY "${WORK}")
+
+# mce_run(<args>...): runs the CLI, fails the test on a non-zero exit;
+# stdout + stderr go to ${WORK}/last.log
+function(mce_run)
+  execute_process(COMMAND "${MCE}" ${ARGN}
+                  RESULT_VARIABLE rc OUTPUT_FILE "${WORK}/last.log" ERROR_FILE "${WORK}/last.err")
+  if (NOT rc EQUAL 0)
+    file(READ "${WORK}/last.err" err)
+    message(FATAL_ERROR "MCE_by_IV ${ARGN} exited with ${rc}\n${err}")
+  endif()
+endfunction()
+
+# mce_batch(<root> <args>...): a batch over the example images into <root>
+function(mce_batch root)
+  mce_run(-i "${EXAMPLE}" -o "${root}" -j 1 ${ARGN})
+endfunction()
+
+# mce_single(<var> <glob>): the one file matching <glob>
+function(mce_single var glob)
+  file(GLOB hits "${glob}")
+  list(LENGTH hits n)
+  if (NOT n EQUAL 1)
+    message(FATAL_ERROR "expected one ${glob}, found ${n}: ${hits}")
+  endif()
+  set(${var} "${hits}" PARENT_SCOPE)
+endfunction()
+
+# mce_names(<var> <dir> [<exclude regex>]): sorted file names in <dir>
+function(mce_names var dir)
+  file(GLOB files RELATIVE "${dir}" "${dir}/*")
+  if (ARGC GREATER 2)
+    list(FILTER files EXCLUDE REGEX "${ARGV2}")
+  endif()
+  list(SORT files)
+  set(${var} "${files}" PARENT_SCOPE)
+endfunction()
+
+# mce_csv_read(<prefix> <csv>): ${prefix}_header (column names) and
+# ${prefix}_rows (data lines) of a results CSV. Fields hold no commas or
+# semicolons here: paths are the example's and the scratch dir's.
+function(mce_csv_read prefix csv)
+  file(STRINGS "${csv}" lines)
+  list(POP_FRONT lines header)
+  string(REPLACE "," ";" header "${header}")
+  set(${prefix}_header "${header}" PARENT_SCOPE)
+  set(${prefix}_rows "${lines}" PARENT_SCOPE)
+endfunction()
+
+# mce_csv_field(<var> <header> <row> <column>): one field, quotes removed
+function(mce_csv_field var header row column)
+  list(FIND header "${column}" i)
+  if (i LESS 0)
+    message(FATAL_ERROR "no column ${column} in ${header}")
+  endif()
+  string(REPLACE "\"" "" row "${row}")
+  string(REPLACE "," ";" fields "${row}")
+  list(GET fields ${i} value)
+  set(${var} "${value}" PARENT_SCOPE)
+endfunction()
+
+# mce_expect_equal(<what> <got> <want>)
+function(mce_expect_equal what got want)
+  if (NOT "${got}" STREQUAL "${want}")
+    message(FATAL_ERROR "${what}:\n  got:  ${got}\n  want: ${want}")
+  endif()
+endfunction()
@@ -0,0 +1,84 @@
+# --debug-pack: one <ts>.tar plus its .tar.idx instead of loose files. The
+# CSV references "<pack>#<member>"; `extract` lists exactly those members
+# and copies each out byte-equal to what a loose --save-debug run writes.
+# A plain tar reader sees the same members and bytes, and render-debug
+# redraws the run from its results.
+include("${CMAKE_CURRENT_LIST_DIR}/cli_common.cmake")
+
+mce_batch("${WORK}/pack" --save-debug --debug-pack)
+mce_batch("${WORK}/loose" --save-debug)
+mce_single(pack "${WORK}/pack/debug/*.tar")
+mce_single(index "${WORK}/pack/debug/*.tar.idx")
+mce_single(looseDir "${WORK}/loose/debug/*")
+mce_names(packDir "${WORK}/pack/debug")
+list(LENGTH packDir n)
+mce_expect_equal("files next to the pack" "${n}" "2")
+
+# Members the results reference
+mce_single(csv "${WORK}/pack/results/*.csv")
+mce_csv_read(res "${csv}")
+set(referenced)
+foreach (row IN LISTS res_rows)
+  foreach (column debug_quad debug_warp debug_mask debug_crop debug_clip)
+    mce_csv_field(ref "${res_header}" "${row}" ${column})
+    if (ref STREQUAL "")
+      continue()
+    endif()
+    if (NOT ref MATCHES "^(.*)#([^#]+)$")
+      message(FATAL_ERROR "${column} is not <pack>#<member>: ${ref}")
+    endif()
+    get_filename_component(refPack "${CMAKE_MATCH_1}" ABSOLUTE)
+    mce_expect_equal("${column} pack" "${refPack}" "${pack}")
+    list(APPEND referenced "${CMAKE_MATCH_2}")
+  endforeach()
+endforeach()
+list(SORT referenced)
+mce_names(loose "${looseDir}")
+mce_expect_equal("members vs. a loose run's files" "${referenced}" "${loose}")
+
+# `extract <pack>`: one "<size>\t<member>" line each
+mce_run(extract "${pack}")
+file(STRINGS "${WORK}/last.log" listing)
+set(listed)
+foreach (line IN LISTS listing)
+  if (NOT line MATCHES "^([0-9]+)\t(.+)$")
+    message(FATAL_ERROR "bad listing line: ${line}")
+  endif()
+  file(SIZE "${looseDir}/${CMAKE_MATCH_2}" size)
+  mce_expect_equal("listed size of ${CMAKE_MATCH_2}" "${CMAKE_MATCH_1}" "${size}")
+  list(APPEND listed "${CMAKE_MATCH_2}")
+endforeach()
+list(SORT listed)
+mce_expect_equal("extract listing" "${listed}" "${referenced}")
+
+# Members out one at a time; the last also through the CSV's <pack>#<member> form
+file(MAKE_DIRECTORY "${WORK}/out" "${WORK}/ref" "${WORK}/tar")
+foreach (member IN LISTS referenced)
+  mce_run(extract "${pack}" "${member}" -o "${WORK}/out")
+endforeach()
+list(GET referenced -1 last)
+mce_run(extract "${pack}#${last}" -o "${WORK}/ref")
+execute_process(COMMAND ${CMAKE_COMMAND} -E tar xf "${pack}" WORKING_DIRECTORY "${WORK}/tar" RESULT_VARIABLE rc)
+mce_expect_equal("cmake -E tar xf exit code" "${rc}" "0")
+foreach (dir out tar)
+  mce_names(got "${WORK}/${dir}")
+  mce_expect_equal("${dir}: extracted members" "${got}" "${referenced}")
+  foreach (member IN LISTS referenced)
+    execute_process(COMMAND ${CMAKE_COMMAND} -E compare_files "${WORK}/${dir}/${member}" "${looseDir}/${member}"
+                    RESULT_VARIABLE differ)
+    if (differ)
+      message(FATAL_ERROR "${dir}/${member} differs from the loose run's file")
+    endif()
+  endforeach()
+endforeach()
+execute_process(COMMAND ${CMAKE_COMMAND} -E compare_files "${WORK}/ref/${last}" "${looseDir}/${last}"
+                RESULT_VARIABLE differ)
+if (differ)
+  message(FATAL_ERROR "extract ${pack}#${last} differs from the loose run's file")
+endif()
+
+# A packed run's results still drive render-debug: same names, loose files
+mce_run(render-debug "${csv}" -o "${WORK}/render")
+mce_names(rendered "${WORK}/render")
+mce_names(looseNoWarp "${looseDir}" "_debug_warp\\.")
+mce_expect_equal("render-debug of the packed run" "${rendered}" "${looseNoWarp}")
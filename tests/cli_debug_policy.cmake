@@ -0,0 +1,79 @@
+# Capture policies: each row's debug_policy names the policies that fired
+# ('+'-joined), and exactly those rows have debug files: a mask for every
+# selected image, quad/crop/clip for its found markers. Unselected images
+# leave nothing in the debug directory.
+include("${CMAKE_CURRENT_LIST_DIR}/cli_common.cmake")
+
+# want_policy(<var> <policies> <index> <found> <percent>): what capture_reason
+# gives for a row under <policies> (failure, every3, coverage50:60, slow)
+function(want_policy var policies index found percent)
+  set(why)
+  if ("failure" IN_LIST policies AND NOT found STREQUAL "1")
+    list(APPEND why failure)
+  endif()
+  math(EXPR k "(${index} - 1) % 3")
+  if ("every3" IN_LIST policies AND k EQUAL 0)
+    list(APPEND why every)
+  endif()
+  if ("slow" IN_LIST policies)
+    list(APPEND why slow)
+  endif()
+  if ("coverage50:60" IN_LIST policies AND found STREQUAL "1" AND (percent LESS 50 OR percent GREATER 60))
+    list(APPEND why coverage)
+  endif()
+  string(REPLACE ";" "+" why "${why}")
+  set(${var} "${why}" PARENT_SCOPE)
+endfunction()
+
+# check_run(<name> <policies> <batch args>...)
+function(check_run name policies)
+  mce_batch("${WORK}/${name}" ${ARGN})
+  mce_single(csv "${WORK}/${name}/results/*.csv")
+  mce_csv_read(res "${csv}")
+  set(expected)
+  foreach (row IN LISTS res_rows)
+    mce_csv_field(INDEX "${res_header}" "${row}" index)
+    mce_csv_field(FOUND "${res_header}" "${row}" found)
+    mce_csv_field(PERCENT "${res_header}" "${row}" percent)
+    mce_csv_field(policy "${res_header}" "${row}" debug_policy)
+    want_policy(WANT "${policies}" "${INDEX}" "${FOUND}" "${PERCENT}")
+    mce_expect_equal("${name}: debug_policy of image ${INDEX}" "${policy}" "${WANT}")
+
+    mce_csv_field(stem "${res_header}" "${row}" input_path)
+    get_filename_component(stem "${stem}" NAME_WE)
+    set(columns debug_mask)
+    if (FOUND STREQUAL "1")
+      list(APPEND columns debug_quad debug_crop debug_clip)
+    endif()
+    foreach (column debug_quad debug_mask debug_crop debug_clip)
+      mce_csv_field(path "${res_header}" "${row}" ${column})
+      if (WANT STREQUAL "" OR NOT column IN_LIST columns)
+        mce_expect_equal("${name}: ${column} of unselected image ${INDEX}" "${path}" "")
+      elseif (NOT EXISTS "${path}")
+        message(FATAL_ERROR "${name}: ${column} of image ${INDEX} missing: ${path}")
+      else()
+        get_filename_component(file "${path}" NAME)
+        list(APPEND expected "${file}")
+      endif()
+    endforeach()
+  endforeach()
+
+  file(GLOB written "${WORK}/${name}/debug/*/*")
+  set(names)
+  foreach (path IN LISTS written)
+    get_filename_component(file "${path}" NAME)
+    list(APPEND names "${file}")
+  endforeach()
+  list(SORT names)
+  list(SORT expected)
+  mce_expect_equal("${name}: files in the debug directory" "${names}" "${expected}")
+endfunction()
+
+# Every image found by default: --debug-failures alone would fire nowhere
+check_run(every "failure;every3" --debug-failures --debug-every 3)
+
+# A gate (nearly) no component passes: the failures are captured as well
+check_run(failures "failure;every3" --debug-failures --debug-every 3 --gate 18)
+
+check_run(coverage "coverage50:60" --debug-coverage 50:60)
+check_run(slow "slow" --debug-slow 0.001)
@@ -0,0 +1,69 @@
+# Debug images through the background writer: after the batch returns,
+# every path in a row's debug columns is a complete file in the chosen
+# encoding, and a found marker has its quad, crop and clip. --debug-preview
+# bounds the long side.
+include("${CMAKE_CURRENT_LIST_DIR}/cli_common.cmake")
+
+# Hex of <n> bytes of <file> at <offset>
+function(read_hex var file offset n)
+  file(READ "${file}" hex OFFSET ${offset} LIMIT ${n} HEX)
+  set(${var} "${hex}" PARENT_SCOPE)
+endfunction()
+
+foreach (run png jpg preview)
+  if (run STREQUAL "jpg")
+    mce_batch("${WORK}/${run}" --save-debug --debug-format jpg --debug-quality 80 --debug-writers 3)
+    set(ext jpg)
+    set(magic "ffd8ff")
+  else()
+    set(flags)
+    if (run STREQUAL "preview")
+      set(flags --debug-preview 64 --debug-quality 1)
+    endif()
+    mce_batch("${WORK}/${run}" --save-debug ${flags})
+    set(ext png)
+    set(magic "89504e47")
+  endif()
+
+  mce_single(csv "${WORK}/${run}/results/*.csv")
+  mce_csv_read(res "${csv}")
+  set(found 0)
+  foreach (row IN LISTS res_rows)
+    mce_csv_field(isFound "${res_header}" "${row}" found)
+    set(required debug_mask)
+    if (isFound STREQUAL "1")
+      math(EXPR found "${found} + 1")
+      list(APPEND required debug_quad debug_crop debug_clip)
+    endif()
+    foreach (column debug_quad debug_warp debug_mask debug_crop debug_clip)
+      mce_csv_field(path "${res_header}" "${row}" ${column})
+      if (path STREQUAL "")
+        if (column IN_LIST required)
+          message(FATAL_ERROR "${run}: ${column} empty in: ${row}")
+        endif()
+        continue()
+      endif()
+      if (NOT path MATCHES "\\.${ext}$" OR NOT EXISTS "${path}")
+        message(FATAL_ERROR "${run}: ${column} missing or not .${ext}: ${path}")
+      endif()
+      file(SIZE "${path}" size)
+      read_hex(head "${path}" 0 3)
+      if (size EQUAL 0 OR NOT magic MATCHES "^${head}")
+        message(FATAL_ERROR "${run}: ${path} is not a complete .${ext} (${size} bytes, starts ${head})")
+      endif()
+      if (run STREQUAL "preview")
+        read_hex(w "${path}" 16 4) # IHDR width, height (big-endian)
+        read_hex(h "${path}" 20 4)
+        math(EXPR w "0x${w}")
+        math(EXPR h "0x${h}")
+        if (w GREATER 64 OR h GREATER 64)
+          message(FATAL_ERROR "preview: ${path} is ${w}x${h}, over 64 px")
+        endif()
+      endif()
+    endforeach()
+  endforeach()
+  if (found EQUAL 0)
+    message(FATAL_ERROR "${run}: no marker found in ${EXAMPLE}")
+  endif()
+  message(STATUS "${run}: ${found} found rows, debug files complete")
+endforeach()
@@ -0,0 +1,29 @@
+# render-debug redraws a batch's debug files under the batch's own names:
+# "_m<k>" for every marker of a --multi run (an image's only one too), none
+# in a single-marker run; from CSV and from columnar results. The warp is
+# sweep-only, so render-debug has none to redraw.
+include("${CMAKE_CURRENT_LIST_DIR}/cli_common.cmake")
+
+foreach (mode single multi)
+  set(flags)
+  if (mode STREQUAL "multi")
+    set(flags --multi)
+  endif()
+  mce_batch("${WORK}/${mode}" --save-debug ${flags})
+  mce_single(debugDir "${WORK}/${mode}/debug/*")
+  mce_names(want "${debugDir}" "_debug_warp\\.")
+  if (mode STREQUAL "multi" AND NOT want MATCHES "_m1_debug_quad")
+    message(FATAL_ERROR "--multi batch wrote no _m1 artifacts: ${want}")
+  endif()
+
+  mce_single(csv "${WORK}/${mode}/results/*.csv")
+  mce_run(render-debug "${csv}" -o "${WORK}/${mode}_csv")
+  mce_names(got "${WORK}/${mode}_csv")
+  mce_expect_equal("${mode}: render-debug from CSV" "${got}" "${want}")
+
+  mce_batch("${WORK}/${mode}_c" --format columnar ${flags})
+  mce_single(mcec "${WORK}/${mode}_c/results/*.mcec")
+  mce_run(render-debug "${mcec}" -o "${WORK}/${mode}_mcec")
+  mce_names(got "${WORK}/${mode}_mcec")
+  mce_expect_equal("${mode}: render-debug from .mcec" "${got}" "${want}")
+endforeach()
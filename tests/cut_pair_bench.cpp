@@ -0,0 +1,64 @@
+// tests/cut_pair_bench.cpp — cost of the MaxGap cut-pair search vs. n.
+//
+// Not part of ctest; run ./cut_pair_bench from the build's tests/ folder.
+// Prints the time per profile for the linear search and the O(n²) search
+// it replaced, plus the linear search's time per element: that column
+// stays flat as n grows (n = warpSize for the validator's projections),
+// while the quadratic one grows with n.
+#include "cut_pair_reference.hpp"
+#include "mce/grid_ops.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+namespace
+{
+    volatile int g_sink; // keeps the searches from being optimized out
+
+    // Average ns per call of `fn` over enough calls to fill ~50 ms
+    template <class Fn>
+    double ns_per_call(Fn &&fn)
+    {
+        using clock = std::chrono::steady_clock;
+        long calls = 0;
+        const auto t0 = clock::now();
+        double ns = 0;
+        do
+        {
+            for (int k = 0; k < 16; ++k)
+                fn();
+            calls += 16;
+            ns = std::chrono::duration<double, std::nano>(clock::now() - t0).count();
+        } while (ns < 5e7);
+        return ns / calls;
+    }
+} // namespace
+
+int main()
+{
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<float> real(0.f, 1e4f);
+    std::vector<int> suf;
+
+    std::printf("%8s %14s %14s %16s %10s\n", "n", "linear ns", "quadratic ns", "linear ns/elem", "speed-up");
+    for (int n : {90, 180, 360, 720, 1024, 2048, 4096, 8192})
+    {
+        std::vector<float> p(n);
+        for (float &x : p)
+            x = real(rng);
+        const int minsep = (int)(0.12 * n + 0.5);
+
+        const double lin = ns_per_call([&]
+                                       { int a, b; mce::grid::best_cut_pair(p, minsep, a, b, suf); g_sink = a + b; });
+        const double quad = n <= 4096 ? ns_per_call([&]
+                                                    { int a, b; mce_test::best_cut_pair_quadratic(p, minsep, a, b); g_sink = a + b; })
+                                      : 0.0;
+        if (quad > 0)
+            std::printf("%8d %14.0f %14.0f %16.2f %9.0fx\n", n, lin, quad, lin / n, quad / lin);
+        else
+            std::printf("%8d %14.0f %14s %16.2f %10s\n", n, lin, "-", lin / n, "-");
+    }
+    return 0;
+}
@@ -0,0 +1,30 @@
+#pragma once
+// The exhaustive MaxGap cut-pair search that mce::grid::best_cut_pair
+// replaced (validator_maxgap_2cuts before the linear-time rewrite).
+#include <vector>
+
+namespace mce_test
+{
+    inline bool best_cut_pair_quadratic(const std::vector<float> &p, int minsep, int &a, int &b)
+    {
+        const int n = (int)p.size();
+        const float *pp = p.data();
+        float best = -1.f;
+        a = -1;
+        b = -1;
+        for (int i = 0; i < n; ++i)
+        {
+            for (int j = i + minsep; j < n; ++j)
+            {
+                float sum = pp[i] + pp[j];
+                if (sum > best)
+                {
+                    best = sum;
+                    a = i;
+                    b = j;
+                }
+            }
+        }
+        return (a >= 0 && b >= 0);
+    }
+} // namespace mce_test
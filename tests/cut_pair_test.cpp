@@ -0,0 +1,97 @@
+// tests/cut_pair_test.cpp — linear cut-pair search == the O(n²) search.
+//
+// Random profiles of every shape the MaxGap validator can produce
+// (smoothed real sums, integer sums, few distinct values, constant runs),
+// with minsep from 0 past n. Both searches must return the same flag and
+// the same (a, b), including which of several tied pairs is picked.
+#include "check.hpp"
+#include "cut_pair_reference.hpp"
+#include "mce/grid_ops.hpp"
+
+#include <random>
+#include <vector>
+
+namespace
+{
+    std::mt19937 g_rng(1013);
+
+    int uniform(int lo, int hi) // inclusive
+    {
+        return std::uniform_int_distribution<int>(lo, hi)(g_rng);
+    }
+
+    // kind 0: real values; 1: integers 0..1000; 2: 2–4 distinct values
+    // (many tied pairs); 3: constant; 4: plateaus (runs of equal values)
+    std::vector<float> random_profile(int n, int kind)
+    {
+        std::vector<float> p(n);
+        std::uniform_real_distribution<float> real(0.f, 1.f);
+        const int levels = uniform(2, 4);
+        const float c = real(g_rng);
+        float plateau = c;
+        for (int i = 0; i < n; ++i)
+        {
+            switch (kind)
+            {
+            case 0:
+                p[i] = real(g_rng) * 1e4f;
+                break;
+            case 1:
+                p[i] = (float)uniform(0, 1000);
+                break;
+            case 2:
+                p[i] = (float)uniform(0, levels - 1);
+                break;
+            case 3:
+                p[i] = c;
+                break;
+            default:
+                if (uniform(0, 7) == 0)
+                    plateau = (float)uniform(0, 5);
+                p[i] = plateau;
+            }
+        }
+        return p;
+    }
+} // namespace
+
+int main()
+{
+    std::vector<int> suf;
+    int cases = 0;
+    for (int t = 0; t < 40000; ++t)
+    {
+        const int n = t < 2000 ? uniform(0, 12) : uniform(8, 420);
+        const int kind = t % 5;
+        const std::vector<float> p = random_profile(n, kind);
+        // the validator's 12% separation, plus the edges: 0, n-1, n, beyond
+        int minsep = (int)(0.12 * n + 0.5);
+        switch (uniform(0, 5))
+        {
+        case 0:
+            minsep = 0;
+            break;
+        case 1:
+            minsep = std::max(0, n - 1);
+            break;
+        case 2:
+            minsep = n + uniform(0, 3);
+            break;
+        case 3:
+            minsep = uniform(0, n);
+            break;
+        }
+
+        int wa = 0, wb = 0, ga = 0, gb = 0;
+        const bool want = mce_test::best_cut_pair_quadratic(p, minsep, wa, wb);
+        const bool got = mce::grid::best_cut_pair(p, minsep, ga, gb, suf);
+        CHECK_MSG(want == got && wa == ga && wb == gb,
+                  "n=" << n << " kind=" << kind << " minsep=" << minsep << ": quadratic (" << want << ", "
+                       << wa << ", " << wb << ") vs linear (" << got << ", " << ga << ", " << gb << ")");
+        ++cases;
+        if (mce_test::failures() > 20)
+            break;
+    }
+    std::cout << cases << " profiles compared\n";
+    return mce_test::result();
+}
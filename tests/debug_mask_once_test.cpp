@@ -0,0 +1,170 @@
+// tests/debug_mask_once_test.cpp — one mask artifact per detection.
+//
+// A pyramid pass that is re-run at full resolution and a tracking attempt
+// that falls back to a full detection are provisional: they must not save
+// artifacts of their own. For each case below, an example image (upscaled
+// so the pyramid applies) goes through a Detector whose debug sink appends
+// to a pack; the pack must then hold exactly one "_debug_mask" member, at
+// the input's full resolution, and no name twice. The sink's written
+// count must match the pack.
+#include "check.hpp"
+#include "mce/debug_pack.hpp"
+#include "mce/debug_sink.hpp"
+#include "mce/detect_and_compute.hpp"
+
+#include <opencv2/core.hpp>
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/imgproc.hpp>
+
+#include <filesystem>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace
+{
+    namespace fs = std::filesystem;
+
+    enum class Case
+    {
+        PyramidHit,   // coarse result kept: mask re-built at full resolution
+        PyramidDrift, // coarse result rejected: full-res re-run
+        TrackHit,     // tracked ROI result kept
+        TrackLost,    // tracking fails, full detection (pyramid, re-run)
+    };
+
+    const char *case_name(Case c)
+    {
+        switch (c)
+        {
+        case Case::PyramidHit:
+            return "pyramid-hit";
+        case Case::PyramidDrift:
+            return "pyramid-drift";
+        case Case::TrackHit:
+            return "track-hit";
+        case Case::TrackLost:
+            return "track-lost";
+        }
+        return "?";
+    }
+
+    // True when the detection took the path `c` names (a coarse pass can
+    // miss, a track can be lost on its own)
+    bool check_case(const cv::Mat &img, const std::string &what, Case c, const fs::path &dir)
+    {
+        mce::DetectOptions opt;
+        mce::parse_validator_order("fixed", opt.validator_order);
+        opt.pyramid = c != Case::TrackHit;
+        opt.pyramid_min_side = 150;
+        // Negative: every refined coverage "drifts", forcing the re-run
+        opt.pyramid_tolerance = c == Case::PyramidHit ? 100.0 : -1.0;
+
+        mce::TrackPrior prior;
+        if (c == Case::TrackHit || c == Case::TrackLost)
+        {
+            mce::Detector plain;
+            mce::DetectOutput first;
+            plain.detect(img, first, false, false, "");
+            prior = mce::track_prior(first);
+            if (c == Case::TrackLost && prior.valid)
+            {
+                // A 10 px box in the corner the marker is farthest from
+                const cv::Rect box = cv::boundingRect(prior.quad);
+                const float x = box.x + box.width / 2 > img.cols / 2 ? 0.0f : (float)img.cols - 10;
+                const float y = box.y + box.height / 2 > img.rows / 2 ? 0.0f : (float)img.rows - 10;
+                prior.quad = {{x, y}, {x + 9, y}, {x + 9, y + 9}, {x, y + 9}};
+            }
+        }
+
+        const std::string tag = what + " " + case_name(c);
+        const fs::path pack = dir / (std::string(case_name(c)) + ".tar");
+        std::vector<mce::io::PackEntry> entries;
+        mce::DetectOutput out;
+        mce::DebugSink::Stats stats;
+        {
+            mce::DebugSink sink(2, mce::DebugEncoding{}, 16, pack.string());
+            mce::Detector det(opt);
+            det.set_debug_sink(&sink);
+            const std::string base = (dir / "img").string();
+            if (prior.valid)
+                det.detect(img, prior, out, false, true, base);
+            else
+                det.detect(img, out, false, true, base);
+            sink.flush();
+            stats = sink.stats();
+        }
+        CHECK_MSG(mce::io::read_pack_index(pack.string(), entries), tag << ": cannot read " << pack);
+
+        std::set<std::string> names;
+        int masks = 0;
+        for (const auto &e : entries)
+        {
+            CHECK_MSG(names.insert(e.name).second, tag << ": member " << e.name << " appended twice");
+            if (e.name.find("_debug_mask") == std::string::npos)
+                continue;
+            ++masks;
+            std::vector<char> data;
+            CHECK_MSG(mce::io::read_pack_member(pack.string(), e, data), tag << ": cannot read " << e.name);
+            const cv::Mat bytes(1, (int)data.size(), CV_8U, data.data());
+            const cv::Mat mask = cv::imdecode(bytes, cv::IMREAD_UNCHANGED);
+            CHECK_MSG(mask.size() == img.size(), tag << ": mask is " << mask.cols << "x" << mask.rows << ", input "
+                                                     << img.cols << "x" << img.rows);
+        }
+        CHECK_MSG(masks == 1, tag << ": " << masks << " mask member(s)");
+        CHECK_MSG(stats.written == entries.size() && stats.failed == 0,
+                  tag << ": sink wrote " << stats.written << " (" << stats.failed << " failed), pack holds "
+                      << entries.size());
+        CHECK_MSG(out.debug_mask_path == mce::io::pack_ref(pack.string(), "img_debug_mask.png"),
+                  tag << ": debug_mask_path " << out.debug_mask_path);
+
+        switch (c)
+        {
+        case Case::PyramidHit:
+            return out.scale_factor > 1;
+        case Case::PyramidDrift:
+            return out.scale_factor == 1;
+        case Case::TrackHit:
+            return out.tracked;
+        case Case::TrackLost:
+            return prior.valid && !out.tracked;
+        }
+        return false;
+    }
+} // namespace
+
+int main()
+{
+    const fs::path dir = fs::temp_directory_path() / "mce_debug_mask_once";
+    constexpr Case kCases[] = {Case::PyramidHit, Case::PyramidDrift, Case::TrackHit, Case::TrackLost};
+    int found = 0, taken[4] = {};
+    for (int i = 1; i <= 10; ++i)
+    {
+        const std::string path = std::string(MCE_EXAMPLE_DIR) + "/" + std::to_string(i) + ".png";
+        cv::Mat img = cv::imread(path, cv::IMREAD_COLOR);
+        CHECK_MSG(!img.empty(), path);
+        if (img.empty())
+            continue;
+        cv::resize(img, img, cv::Size(), 4.0, 4.0, cv::INTER_CUBIC);
+
+        mce::DetectOutput probe;
+        mce::Detector().detect(img, probe, false, false, "");
+        if (!probe.found)
+            continue; // every case below needs a marker to keep or lose
+        ++found;
+        for (Case c : kCases)
+        {
+            fs::remove_all(dir);
+            fs::create_directories(dir);
+            taken[(int)c] += check_case(img, path, c, dir);
+        }
+    }
+    fs::remove_all(dir);
+    CHECK_MSG(found > 0, "no upscaled example image produced a marker");
+    for (Case c : kCases)
+    {
+        std::cout << case_name(c) << ": path taken on " << taken[(int)c] << " of " << found << " image(s)\n";
+        CHECK_MSG(taken[(int)c] > 0, case_name(c) << ": path never taken");
+    }
+    return mce_test::result();
+}
@@ -0,0 +1,156 @@
+// tests/decode_budget_test.cpp — reduced JPEG decode vs. full decode.
+//
+// Header probe and factor choice on written files, then two detection
+// checks on the example images saved as JPEGs:
+//  - parity: each image, upscaled ×16, is detected from a full decode and
+//    from IMREAD_REDUCED_COLOR_2/4/8 (DetectOptions::input_scale set as
+//    the batch runner does). A reduced decode is a resample and the
+//    detector is not exactly scale invariant (morphology kernels floor at
+//    3 px, validators see fewer pixels), so an odd image flips or moves by
+//    more than kCoverageTol points; at most kMaxDeviating of the pairs may.
+//  - component floor: each image at its own size in a frame 6× as large,
+//    read at 1/8. The marker's blobs are then under 100 pixels; with
+//    input_scale = 8 the floor shrinks and must keep every marker the
+//    unscaled floor keeps, and more of them.
+#include "check.hpp"
+#include "mce/detect_and_compute.hpp"
+#include "mce/image_probe.hpp"
+
+#include <opencv2/core.hpp>
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/imgproc.hpp>
+
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <utility>
+
+namespace
+{
+    namespace fs = std::filesystem;
+    using namespace mce::io;
+
+    constexpr double kCoverageTol = 2.0;  // percentage points
+    constexpr double kMaxDeviating = 0.15; // share of (image, factor) pairs
+
+    void check_probe(const fs::path &dir)
+    {
+        const cv::Mat img(300, 500, CV_8UC3, cv::Scalar(40, 120, 200));
+        const std::string jpg = (dir / "probe.jpg").string(), png = (dir / "probe.png").string(),
+                          txt = (dir / "probe.txt").string();
+        CHECK(cv::imwrite(jpg, img));
+        CHECK(cv::imwrite(png, img));
+        std::ofstream(txt) << "not an image\n";
+
+        ImageInfo info;
+        CHECK(probe_image(jpg, info) && info.format == ImageFormat::Jpeg && info.width == 500 && info.height == 300);
+        CHECK(probe_image(png, info) && info.format == ImageFormat::Png && info.width == 500 && info.height == 300);
+        CHECK(!probe_image(txt, info));
+        CHECK(!probe_image((dir / "missing.jpg").string(), info));
+
+        // Largest factor that keeps the budget; JPEG only; 8 at most
+        ImageInfo big{ImageFormat::Jpeg, 4000, 3000};
+        CHECK(reduced_decode_factor(big, 0) == 1);
+        CHECK(reduced_decode_factor(big, 12'000'000) == 1);
+        CHECK(reduced_decode_factor(big, 3'000'000) == 2);
+        CHECK(reduced_decode_factor(big, 2'999'999) == 2);
+        CHECK(reduced_decode_factor(big, 750'000) == 4);
+        CHECK(reduced_decode_factor(big, 187'500) == 8);
+        CHECK(reduced_decode_factor(big, 1'000) == 8);
+        big.format = ImageFormat::Png;
+        CHECK(reduced_decode_factor(big, 1'000) == 1);
+
+        const cv::Mat half = imread_reduced(jpg, 2);
+        CHECK(half.cols == 250 && half.rows == 150);
+    }
+
+    mce::DetectOutput detect(const cv::Mat &img, int scale)
+    {
+        mce::DetectOptions opt;
+        mce::parse_validator_order("fixed", opt.validator_order);
+        opt.input_scale = scale;
+        mce::Detector det(opt);
+        mce::DetectOutput out;
+        cv::setRNGSeed(12345); // kmeans validator: same draws for every decode
+        det.detect(img, out, false, false, "");
+        return out;
+    }
+
+    struct Parity
+    {
+        int compared = 0, deviating = 0;
+    };
+
+    void check_parity(const std::string &jpg, const std::string &what, Parity &p)
+    {
+        const mce::DetectOutput full = detect(cv::imread(jpg, cv::IMREAD_COLOR), 1);
+        CHECK_MSG(full.found, what << ": no marker at full resolution");
+        if (!full.found)
+            return;
+        for (int f : {2, 4, 8})
+        {
+            const mce::DetectOutput out = detect(imread_reduced(jpg, f), f);
+            const bool same = out.found && std::abs(out.coverage_percent - full.coverage_percent) <= kCoverageTol;
+            std::cout << what << " 1/" << f << ": coverage " << full.coverage_percent << " -> "
+                      << (out.found ? std::to_string(out.coverage_percent) : std::string("lost"))
+                      << (same ? "" : " (deviates)") << "\n";
+            ++p.compared;
+            p.deviating += !same;
+        }
+    }
+
+    // Returns {unscaled, scaled} number of markers kept at 1/8
+    std::pair<int, int> check_floor(const std::string &jpg, const std::string &what)
+    {
+        const cv::Mat eighth = imread_reduced(jpg, 8);
+        const bool unscaled = detect(eighth, 1).found, scaled = detect(eighth, 8).found;
+        std::cout << what << " 1/8: unscaled floor " << (unscaled ? "keeps" : "drops") << ", scaled floor "
+                  << (scaled ? "keeps" : "drops") << "\n";
+        CHECK_MSG(scaled || !unscaled, what << ": the scaled floor lost a marker the unscaled floor keeps");
+        return {unscaled, scaled};
+    }
+} // namespace
+
+int main()
+{
+    const fs::path dir = fs::temp_directory_path() / "mce_decode_budget";
+    fs::remove_all(dir);
+    fs::create_directories(dir);
+    check_probe(dir);
+
+    Parity parity;
+    int keptUnscaled = 0, keptScaled = 0;
+    for (int i = 1; i <= 10; ++i)
+    {
+        const std::string path = std::string(MCE_EXAMPLE_DIR) + "/" + std::to_string(i) + ".png";
+        const cv::Mat img = cv::imread(path, cv::IMREAD_COLOR);
+        CHECK_MSG(!img.empty(), path);
+        if (img.empty())
+            continue;
+
+        cv::Mat up;
+        cv::resize(img, up, cv::Size(), 16.0, 16.0, cv::INTER_CUBIC);
+        const std::string jpg = (dir / (std::to_string(i) + ".jpg")).string();
+        CHECK(cv::imwrite(jpg, up, {cv::IMWRITE_JPEG_QUALITY, 95}));
+        check_parity(jpg, path, parity);
+
+        cv::Mat frame(img.rows * 6, img.cols * 6, CV_8UC3, cv::Scalar(128, 128, 128));
+        cv::Mat spot = frame(cv::Rect(img.cols * 2, img.rows * 3, img.cols, img.rows));
+        img.copyTo(spot);
+        const std::string framed = (dir / (std::to_string(i) + "_framed.jpg")).string();
+        CHECK(cv::imwrite(framed, frame, {cv::IMWRITE_JPEG_QUALITY, 95}));
+        const auto [unscaled, scaled] = check_floor(framed, path + " framed");
+        keptUnscaled += unscaled;
+        keptScaled += scaled;
+    }
+    fs::remove_all(dir);
+
+    std::cout << parity.deviating << " of " << parity.compared << " reduced decode(s) deviate; 1/8 framed markers kept: "
+              << keptUnscaled << " unscaled, " << keptScaled << " scaled\n";
+    CHECK(parity.compared > 0);
+    CHECK_MSG(parity.deviating <= kMaxDeviating * parity.compared,
+              parity.deviating << " of " << parity.compared << " reduced decodes deviate");
+    CHECK_MSG(keptScaled > keptUnscaled, "the scaled component floor kept no extra marker");
+    return mce_test::result();
+}
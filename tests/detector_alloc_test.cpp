@@ -0,0 +1,174 @@
+// tests/detector_alloc_test.cpp — a warm Detector does not allocate.
+//
+// For every example image a fresh Detector runs detect() once (warm-up),
+// then kRepeats more times on the same image. After the warm-up both
+// counters must stay flat:
+//   * Detector::workspace_allocations() — workspace Mat buffers
+//   * operator new calls made from this binary, i.e. from mce code
+//     (mce_core is linked in statically) or from libstdc++ on its behalf
+//
+// OpenCV allocates internally on every call (filter engines, contour
+// storage, Mat headers' UMatData), so a process-wide new counter can never
+// be flat; calls are attributed to the first frame outside the standard
+// library and only counted when that frame lies in this executable. A
+// frame in this executable that dladdr() names as a std:: function is a
+// template instance (the target is linked with ENABLE_EXPORTS so all of
+// them have names); OpenCV's calls may resolve to those instances too
+// (e.g. vector<int>::_M_default_append), so they are skipped like
+// libstdc++ and the caller decides.
+// Needs backtrace() and dladdr(); elsewhere only the workspace counter is
+// checked.
+#include "check.hpp"
+#include "mce/detect_and_compute.hpp"
+
+#include <opencv2/core.hpp>
+#include <opencv2/imgcodecs.hpp>
+
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string>
+
+#if defined(__GLIBC__) || defined(__APPLE__)
+#include <dlfcn.h>
+#include <execinfo.h>
+#define MCE_TEST_ATTRIBUTE_NEW 1
+#else
+#define MCE_TEST_ATTRIBUTE_NEW 0
+#endif
+
+namespace
+{
+    std::atomic<bool> g_counting{false};
+    std::atomic<std::size_t> g_ownNews{0};
+
+#if MCE_TEST_ATTRIBUTE_NEW
+    const void *g_exeBase = nullptr;
+    thread_local bool t_inHook = false;
+
+    void anchor() {}
+
+    // Mangled std:: names: std::f, std::C::f, std::C::f() const
+    bool is_std_symbol(const char *s)
+    {
+        return s && (!std::strncmp(s, "_ZSt", 4) || !std::strncmp(s, "_ZNSt", 5) || !std::strncmp(s, "_ZNKSt", 6));
+    }
+
+    // frames[0] = this function, [1] = operator new, [2...] = callers
+    __attribute__((noinline)) void note_new()
+    {
+        if (!g_counting.load(std::memory_order_relaxed) || t_inHook)
+            return;
+        t_inHook = true;
+        void *frames[12];
+        const int n = backtrace(frames, 12);
+        for (int i = 2; i < n; ++i)
+        {
+            Dl_info info;
+            if (!dladdr(frames[i], &info))
+                break;
+            if (is_std_symbol(info.dli_sname))
+                continue; // libstdc++ or an exported std:: instance: look at its caller
+            if (info.dli_fbase == g_exeBase)
+            {
+                g_ownNews.fetch_add(1, std::memory_order_relaxed);
+                break;
+            }
+            if (!info.dli_fname || !std::strstr(info.dli_fname, "libstdc++"))
+                break; // OpenCV, libc, ...
+        }
+        t_inHook = false;
+    }
+
+    void init_attribution()
+    {
+        Dl_info info;
+        if (dladdr(reinterpret_cast<void *>(&anchor), &info))
+            g_exeBase = info.dli_fbase;
+        void *warm[2];
+        backtrace(warm, 2); // loads the unwinder before counting starts
+    }
+
+    __attribute__((always_inline)) inline void *counted_alloc(std::size_t n)
+    {
+        note_new();
+        return std::malloc(n ? n : 1);
+    }
+} // namespace
+
+__attribute__((noinline)) void *operator new(std::size_t n)
+{
+    if (void *p = counted_alloc(n))
+        return p;
+    throw std::bad_alloc();
+}
+__attribute__((noinline)) void *operator new[](std::size_t n)
+{
+    if (void *p = counted_alloc(n))
+        return p;
+    throw std::bad_alloc();
+}
+__attribute__((noinline)) void *operator new(std::size_t n, const std::nothrow_t &) noexcept { return counted_alloc(n); }
+__attribute__((noinline)) void *operator new[](std::size_t n, const std::nothrow_t &) noexcept { return counted_alloc(n); }
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete[](void *p) noexcept { std::free(p); }
+void operator delete(void *p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void *p, std::size_t) noexcept { std::free(p); }
+void operator delete(void *p, const std::nothrow_t &) noexcept { std::free(p); }
+void operator delete[](void *p, const std::nothrow_t &) noexcept { std::free(p); }
+#else
+    void init_attribution() {}
+} // namespace
+#endif
+
+int main()
+{
+    init_attribution();
+    const int kImages = 10, kRepeats = 3;
+
+    mce::DetectOptions opt;
+    // Fixed cascade and a fixed RNG seed (kmeans): every call takes the same path
+    mce::parse_validator_order("fixed", opt.validator_order);
+
+    int found = 0;
+    for (int i = 1; i <= kImages; ++i)
+    {
+        const std::string path = std::string(MCE_EXAMPLE_DIR) + "/" + std::to_string(i) + ".png";
+        const cv::Mat img = cv::imread(path, cv::IMREAD_COLOR);
+        CHECK_MSG(!img.empty(), path);
+        if (img.empty())
+            continue;
+
+        mce::Detector det(opt);
+        mce::DetectOutput out;
+        cv::setRNGSeed(12345);
+        g_ownNews = 0;
+        g_counting = true;
+        det.detect(img, out, false, false, "");
+        g_counting = false;
+        const std::size_t warmWs = det.workspace_allocations();
+        const std::size_t warmNews = g_ownNews.load();
+        const bool warmFound = out.found;
+        found += out.found;
+
+        for (int r = 0; r < kRepeats; ++r)
+        {
+            cv::setRNGSeed(12345);
+            g_ownNews = 0;
+            g_counting = true;
+            det.detect(img, out, false, false, "");
+            g_counting = false;
+            CHECK_MSG(det.workspace_allocations() == warmWs,
+                      path << " call " << r + 2 << ": workspace allocations " << warmWs << " -> "
+                           << det.workspace_allocations());
+            CHECK_MSG(g_ownNews.load() == 0,
+                      path << " call " << r + 2 << ": " << g_ownNews.load() << " operator new call(s) from mce code");
+            CHECK_MSG(out.found == warmFound, path << ": result changed between calls");
+        }
+        std::cout << path << ": found=" << warmFound << " warm-up: " << warmWs << " workspace buffers, "
+                  << warmNews << " operator new call(s)\n";
+    }
+    CHECK_MSG(found > 0, "no example image produced a marker; the sweep path was not exercised");
+    return mce_test::result();
+}
@@ -0,0 +1,171 @@
+// tests/hsv_kernel_test.cpp — fused HSV kernels vs cvtColor + inRange.
+//
+// Runs on the tier MCE_HSV_ISA selects (one ctest entry per tier; a tier
+// this CPU or build lacks exits with mce_test::kSkip). For random images
+// of odd widths, ROI views and every 8-bit BGR color, band_mask() must be
+// bit-identical to cvtColor(BGR2HSV) + OR of inRange per hue range, and
+// sv_histograms() must count exactly the S and V planes of cvtColor.
+#include "check.hpp"
+#include "mce/hsv_kernel.hpp"
+
+#include <opencv2/core.hpp>
+#include <opencv2/imgproc.hpp>
+
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+
+namespace
+{
+    using namespace mce::hsv;
+
+    std::mt19937 g_rng(20250817);
+
+    int uniform(int lo, int hi) // inclusive
+    {
+        return std::uniform_int_distribution<int>(lo, hi)(g_rng);
+    }
+
+    // Random BGR pixels; every 4th pixel is gray or a pure primary/secondary
+    // so the diff == 0 and v == r/g/b ties of the hue formula are covered
+    cv::Mat random_bgr(int rows, int cols)
+    {
+        cv::Mat m(rows, cols, CV_8UC3);
+        for (int y = 0; y < rows; ++y)
+        {
+            uchar *p = m.ptr<uchar>(y);
+            for (int x = 0; x < cols; ++x, p += 3)
+            {
+                for (int c = 0; c < 3; ++c)
+                    p[c] = (uchar)uniform(0, 255);
+                if (uniform(0, 3) == 0)
+                {
+                    const int v = uniform(0, 255), lo = uniform(0, v);
+                    const int pattern = uniform(0, 7); // bit c set: channel c at v, else lo
+                    for (int c = 0; c < 3; ++c)
+                        p[c] = (uchar)((pattern >> c & 1) ? v : lo);
+                }
+            }
+        }
+        return m;
+    }
+
+    // Every 8-bit BGR color once (4096 × 4096)
+    cv::Mat all_colors()
+    {
+        cv::Mat m(4096, 4096, CV_8UC3);
+        for (int y = 0; y < m.rows; ++y)
+        {
+            uchar *p = m.ptr<uchar>(y);
+            for (int x = 0; x < m.cols; ++x, p += 3)
+            {
+                const int i = y * m.cols + x;
+                p[0] = (uchar)(i & 255);
+                p[1] = (uchar)(i >> 8 & 255);
+                p[2] = (uchar)(i >> 16);
+            }
+        }
+        return m;
+    }
+
+    BandSpec random_spec()
+    {
+        BandSpec spec;
+        spec.smin = uniform(0, 255);
+        spec.vmin = uniform(0, 255);
+        spec.vmax = uniform(spec.vmin, 255);
+        const int n = uniform(1, 3);
+        for (int k = 0; k < n; ++k)
+        {
+            const int lo = uniform(0, 180);
+            add_hue_range(spec, lo, uniform(lo, 180));
+        }
+        return spec;
+    }
+
+    // The detector's bands (see kHueBands) with typical adaptive limits
+    BandSpec marker_spec()
+    {
+        BandSpec spec;
+        spec.smin = 45;
+        spec.vmin = 60;
+        spec.vmax = 250;
+        for (const auto &b : {std::pair{0, 10}, {170, 180}, {20, 35}, {40, 85}, {86, 100}, {101, 130}, {131, 169}})
+            add_hue_range(spec, b.first, b.second);
+        return spec;
+    }
+
+    cv::Mat reference_mask(const cv::Mat &hsv, const BandSpec &spec)
+    {
+        cv::Mat mask = cv::Mat::zeros(hsv.size(), CV_8U), band;
+        for (int k = 0; k < spec.nHue; ++k)
+        {
+            cv::inRange(hsv, cv::Scalar(spec.hueLo[k], spec.smin, spec.vmin),
+                        cv::Scalar(spec.hueHi[k], 255, spec.vmax), band);
+            cv::bitwise_or(mask, band, mask);
+        }
+        return mask;
+    }
+
+    // `bgr` may be a view; `what` names it in failure messages
+    void check_image(const cv::Mat &bgr, const std::string &what)
+    {
+        cv::Mat hsv;
+        cv::cvtColor(bgr, hsv, cv::COLOR_BGR2HSV);
+
+        SVHist got;
+        sv_histograms(bgr, got);
+        int wantS[256] = {}, wantV[256] = {};
+        for (int y = 0; y < hsv.rows; ++y)
+        {
+            const uchar *p = hsv.ptr<uchar>(y);
+            for (int x = 0; x < hsv.cols; ++x, p += 3)
+            {
+                wantS[p[1]]++;
+                wantV[p[2]]++;
+            }
+        }
+        CHECK_MSG(std::memcmp(got.s, wantS, sizeof(wantS)) == 0, what << ": S histogram differs");
+        CHECK_MSG(std::memcmp(got.v, wantV, sizeof(wantV)) == 0, what << ": V histogram differs");
+
+        for (int t = 0; t < 4; ++t)
+        {
+            const BandSpec spec = t == 0 ? marker_spec() : random_spec();
+            cv::Mat mask;
+            band_mask(bgr, spec, mask);
+            cv::Mat diff;
+            cv::compare(mask, reference_mask(hsv, spec), diff, cv::CMP_NE);
+            const int bad = cv::countNonZero(diff);
+            CHECK_MSG(bad == 0, what << " spec " << t << ": " << bad << " mask pixel(s) differ");
+        }
+    }
+} // namespace
+
+int main()
+{
+    const char *want = std::getenv("MCE_HSV_ISA");
+    const Isa isa = active_isa();
+    if (want && std::strcmp(want, isa_name(isa)) != 0)
+    {
+        std::cout << "MCE_HSV_ISA=" << want << " not available here (best: " << isa_name(isa) << "), skipped\n";
+        return mce_test::kSkip;
+    }
+    std::cout << "tier: " << isa_name(isa) << "\n";
+
+    // Widths around the 16/32-pixel SIMD blocks and their scalar tails
+    for (int w : {1, 2, 3, 5, 7, 15, 16, 17, 31, 32, 33, 47, 63, 64, 65, 101, 255, 257, 641})
+        check_image(random_bgr(uniform(1, 9), w), "random " + std::to_string(w) + " wide");
+
+    // ROI views: odd offsets, row stride != width
+    const cv::Mat big = random_bgr(64, 300);
+    for (int i = 0; i < 12; ++i)
+    {
+        const cv::Rect r(uniform(1, 40), uniform(0, 20), uniform(1, 250), uniform(1, 40));
+        check_image(big(r), "ROI " + std::to_string(r.x) + "," + std::to_string(r.y) + " " +
+                                std::to_string(r.width) + "x" + std::to_string(r.height));
+    }
+
+    check_image(all_colors(), "all 2^24 colors");
+    return mce_test::result();
+}
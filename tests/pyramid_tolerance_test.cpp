@@ -0,0 +1,68 @@
+// tests/pyramid_tolerance_test.cpp — what pyramid_tolerance does and does not bound.
+//
+// The tolerance compares the refined full-resolution coverage with the
+// coarse pass it came from; it is not a bound against a plain full-res
+// run (the angle is the coarse pass's). The palette validator stands in
+// for kmeans, whose draws the coarse pass would consume. On each example,
+// upscaled ×24 so the pyramid applies:
+//  - a negative tolerance rejects every refine, and the re-run must give
+//    exactly the plain result (same found, coverage and quad);
+//  - at the default tolerance, the coarse result is kept on at least one
+//    image. Its difference to the plain run is printed, not checked.
+#include "check.hpp"
+#include "mce/detect_and_compute.hpp"
+
+#include <opencv2/core.hpp>
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/imgproc.hpp>
+
+#include <iostream>
+#include <string>
+
+namespace
+{
+    mce::DetectOutput detect(const cv::Mat &img, bool pyramid, double tolerance)
+    {
+        mce::DetectOptions opt;
+        mce::parse_validator_order("fixed", opt.validator_order);
+        opt.kmeans_validator = false;
+        opt.pyramid = pyramid;
+        opt.pyramid_tolerance = tolerance;
+        mce::Detector det(opt);
+        mce::DetectOutput out;
+        det.detect(img, out, false, false, "");
+        return out;
+    }
+} // namespace
+
+int main()
+{
+    int hits = 0;
+    for (int i = 1; i <= 10; ++i)
+    {
+        const std::string path = std::string(MCE_EXAMPLE_DIR) + "/" + std::to_string(i) + ".png";
+        cv::Mat img = cv::imread(path, cv::IMREAD_COLOR);
+        CHECK_MSG(!img.empty(), path);
+        if (img.empty())
+            continue;
+        cv::resize(img, img, cv::Size(), 24.0, 24.0, cv::INTER_CUBIC);
+
+        const mce::DetectOutput plain = detect(img, false, 0.0);
+        const mce::DetectOutput rerun = detect(img, true, -1.0);
+        CHECK_MSG(rerun.scale_factor == 1, path << ": re-run reports 1/" << rerun.scale_factor);
+        CHECK_MSG(rerun.found == plain.found && rerun.coverage_percent == plain.coverage_percent &&
+                      rerun.quad == plain.quad,
+                  path << ": re-run " << rerun.coverage_percent << "%, plain " << plain.coverage_percent << "%");
+
+        const mce::DetectOptions defaults;
+        const mce::DetectOutput pyr = detect(img, true, defaults.pyramid_tolerance);
+        if (pyr.scale_factor > 1)
+        {
+            ++hits;
+            std::cout << path << " 1/" << pyr.scale_factor << ": pyramid " << pyr.coverage_percent << "%, plain "
+                      << plain.coverage_percent << "%\n";
+        }
+    }
+    CHECK_MSG(hits > 0, "the coarse result was never kept");
+    return mce_test::result();
+}
@@ -0,0 +1,477 @@
+// tests/result_formats_test.cpp — CSV, JSON Lines and .mcec hold the same rows.
+//
+// 4101 synthetic rows go through all three result sinks: markers and
+// images without one (null columns), unreadable images, and paths that
+// need quoting or escaping, some of them either side of the 4096-row
+// group boundary of the columnar file. Each file is parsed back (RFC 4180,
+// a small JSON reader, ColumnarReader) and every cell must equal the
+// schema value in one canonical text form. Finally one text offset of a
+// copy of the .mcec is corrupted: ColumnarReader::text must return empty
+// for the rows it bounds instead of reading outside the group.
+#include "check.hpp"
+#include "mce/result_sink.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace
+{
+    namespace fs = std::filesystem;
+    using namespace mce::io;
+    using Cell = std::optional<std::string>; // nullopt = null
+    using Table = std::vector<std::vector<Cell>>;
+
+    constexpr int kRows = 4101;
+
+    std::string fixed(double v, int precision)
+    {
+        char t[64];
+        std::snprintf(t, sizeof t, "%.*f", precision, v);
+        return t;
+    }
+
+    std::string points(const float *p) // x0 y0 ... x3 y3
+    {
+        std::string s;
+        for (int k = 0; k < 8; ++k)
+            s += (k ? " " : "") + fixed(p[k], 2);
+        return s;
+    }
+
+    Cell canonical(const ResultColumn &col, const ResultValue &v)
+    {
+        if (v.null)
+            return std::nullopt;
+        switch (col.type)
+        {
+        case ResultType::Int:
+        case ResultType::Bool:
+            return std::to_string(v.i);
+        case ResultType::Real:
+            return fixed(v.d, col.precision);
+        case ResultType::Text:
+            return std::string(v.s);
+        case ResultType::Points:
+            return points(&v.pts[0].x);
+        }
+        return std::nullopt;
+    }
+
+    // ------------------------------ Rows ------------------------------
+    struct Rows
+    {
+        std::vector<std::string> paths;
+        std::vector<mce::DetectOutput> outs;
+        std::vector<ResultRow> rows;
+    };
+
+    std::string path_of(int i)
+    {
+        if (i == 1 || i == 4095 || i == 4096 || i == 4097)
+            return "in/\"quoted\", with comma\\and backslash/" + std::to_string(i) + ".jpg";
+        if (i == 4098)
+            return "in/tab\there/ü.jpg";
+        return "in/" + std::to_string(i) + ".jpg";
+    }
+
+    void make_rows(Rows &r)
+    {
+        r.paths.resize(kRows);
+        r.outs.resize(kRows);
+        r.rows.resize(kRows);
+        for (int i = 0; i < kRows; ++i)
+        {
+            r.paths[i] = path_of(i);
+            mce::DetectOutput &o = r.outs[i];
+            const bool marker = i % 3 != 0;
+            o.found = marker;
+            o.coverage_percent = marker ? i % 100 : -1;
+            o.best_angle_deg = i * 0.37 - 40.0;
+            o.occupancy = (i % 97) / 97.0;
+            o.hue_score = (i % 13) / 13.0;
+            o.line_ok = i % 2 == 0;
+            o.Smin = i % 256;
+            o.Vmin = (i * 7) % 256;
+            o.Vmax = 255;
+            if (i % 4 == 0)
+                o.debug_quad_path = "dbg/" + std::to_string(i) + "_debug_quad.jpg";
+            if (marker)
+                o.quad = {{i * 0.5f, 1.25f}, {i + 10.0f, 1.25f}, {i + 10.0f, 20.75f}, {i * 0.5f, 20.75f}};
+
+            ResultRow &row = r.rows[i];
+            row.index = i + 1;
+            row.path = r.paths[i];
+            row.read_ok = i % 5 != 0;
+            row.out = row.read_ok || i % 10 == 0 ? &o : nullptr;
+            row.marker = row.read_ok && marker ? 1 : 0;
+            row.multi = i % 7 == 0;
+            row.elapsed_ms = i * 3;
+            row.decode_ms = i / 8.0;
+            row.detect_ms = i / 3.0;
+            row.write_ms = i % 2 ? 0.125 : 0.0;
+            row.image_markers = row.marker;
+            row.image_percent = row.marker ? o.coverage_percent : 0;
+            row.tracked = i % 11 == 0;
+            row.decode_scale = 1 << (i % 4);
+            row.debug_policy = i % 6 == 0 ? "always" : "";
+        }
+    }
+
+    Table expected(const Rows &r)
+    {
+        const auto &schema = result_schema();
+        Table t;
+        for (const ResultRow &row : r.rows)
+        {
+            t.emplace_back();
+            for (const ResultColumn &col : schema)
+                t.back().push_back(canonical(col, col.get(row)));
+        }
+        return t;
+    }
+
+    bool write_all(const std::string &format, const std::string &stem, const Rows &r)
+    {
+        auto sink = make_result_sink(format, stem);
+        if (!sink->ok())
+            return false;
+        for (const ResultRow &row : r.rows)
+            sink->write(row);
+        return sink->finish();
+    }
+
+    std::string slurp(const std::string &path)
+    {
+        std::ifstream f(path, std::ios::binary);
+        return std::string(std::istreambuf_iterator<char>(f), {});
+    }
+
+    // ------------------------------ CSV ------------------------------
+    // RFC 4180 records; an unquoted empty field is null
+    bool read_csv(const std::string &path, Table &t)
+    {
+        const auto &schema = result_schema();
+        const std::string s = slurp(path);
+        std::vector<Cell> rec;
+        std::size_t i = 0;
+        bool header = true;
+        while (i < s.size())
+        {
+            Cell cell;
+            if (s[i] == '"')
+            {
+                std::string v;
+                for (++i; i < s.size(); ++i)
+                {
+                    if (s[i] == '"' && i + 1 < s.size() && s[i + 1] == '"')
+                        v += s[++i];
+                    else if (s[i] == '"')
+                        break;
+                    else
+                        v += s[i];
+                }
+                ++i; // closing quote
+                cell = v;
+            }
+            else
+            {
+                const std::size_t end = s.find_first_of(",\n", i);
+                if (end != i)
+                    cell = s.substr(i, end - i);
+                i = end;
+            }
+            rec.push_back(cell);
+            if (i >= s.size() || s[i] == '\n')
+            {
+                if (header)
+                {
+                    if (rec.size() != schema.size())
+                        return false;
+                    for (std::size_t c = 0; c < schema.size(); ++c)
+                        if (rec[c] != Cell(schema[c].name))
+                            return false;
+                    header = false;
+                }
+                else
+                    t.push_back(rec); // quads are "x0 y0 ... x3 y3" already
+                rec.clear();
+                if (i >= s.size())
+                    break;
+            }
+            else if (s[i] != ',')
+                return false;
+            ++i;
+        }
+        return !header;
+    }
+
+    // ------------------------------ JSON Lines ------------------------------
+    // Enough JSON for the sink's objects: strings, numbers, true/false/null
+    // and flat arrays of numbers. Values come back in canonical form.
+    class JsonLine
+    {
+    public:
+        explicit JsonLine(const std::string &s) : s_(s) {}
+
+        bool object(std::vector<Cell> &rec)
+        {
+            const auto &schema = result_schema();
+            if (!eat('{'))
+                return false;
+            for (std::size_t c = 0; c < schema.size(); ++c)
+            {
+                std::string key;
+                if ((c && !eat(',')) || !string(key) || key != schema[c].name || !eat(':'))
+                    return false;
+                Cell v;
+                if (!value(schema[c], v))
+                    return false;
+                rec.push_back(v);
+            }
+            return eat('}') && i_ == s_.size();
+        }
+
+    private:
+        bool eat(char c)
+        {
+            if (i_ >= s_.size() || s_[i_] != c)
+                return false;
+            ++i_;
+            return true;
+        }
+        bool word(const char *w)
+        {
+            const std::size_t n = std::strlen(w);
+            if (s_.compare(i_, n, w) != 0)
+                return false;
+            i_ += n;
+            return true;
+        }
+
+        bool string(std::string &out)
+        {
+            if (!eat('"'))
+                return false;
+            while (i_ < s_.size() && s_[i_] != '"')
+            {
+                char c = s_[i_++];
+                if (c == '\\')
+                {
+                    if (i_ >= s_.size())
+                        return false;
+                    c = s_[i_++];
+                    if (c == 'u')
+                    {
+                        if (i_ + 4 > s_.size())
+                            return false;
+                        c = (char)std::stoi(s_.substr(i_, 4), nullptr, 16);
+                        i_ += 4;
+                    }
+                }
+                out += c;
+            }
+            return eat('"');
+        }
+
+        bool number(std::string &out)
+        {
+            const std::size_t end = s_.find_first_of(",]}", i_);
+            if (end == std::string::npos || end == i_)
+                return false;
+            out = s_.substr(i_, end - i_);
+            i_ = end;
+            return true;
+        }
+
+        bool value(const ResultColumn &col, Cell &v)
+        {
+            if (word("null"))
+                return true;
+            std::string s;
+            switch (col.type)
+            {
+            case ResultType::Bool:
+                if (word("true"))
+                    s = "1";
+                else if (word("false"))
+                    s = "0";
+                else
+                    return false;
+                break;
+            case ResultType::Text:
+                if (!string(s))
+                    return false;
+                break;
+            case ResultType::Points:
+                if (!eat('['))
+                    return false;
+                for (int k = 0; k < 8; ++k)
+                {
+                    std::string x;
+                    if ((k && !eat(',')) || !number(x))
+                        return false;
+                    s += (k ? " " : "") + x;
+                }
+                if (!eat(']'))
+                    return false;
+                break;
+            default:
+                if (!number(s))
+                    return false;
+                break;
+            }
+            v = s;
+            return true;
+        }
+
+        const std::string &s_;
+        std::size_t i_ = 0;
+    };
+
+    bool read_jsonl(const std::string &path, Table &t)
+    {
+        std::istringstream in(slurp(path));
+        std::string line;
+        while (std::getline(in, line))
+        {
+            t.emplace_back();
+            if (!JsonLine(line).object(t.back()))
+                return false;
+        }
+        return true;
+    }
+
+    // ------------------------------ Columnar ------------------------------
+    bool read_columnar(const std::string &path, Table &t)
+    {
+        const auto &schema = result_schema();
+        ColumnarReader rd;
+        if (!rd.open(path) || rd.columns() != schema.size())
+            return false;
+        for (std::size_t c = 0; c < schema.size(); ++c)
+            if (rd.name((int)c) != schema[c].name || rd.type((int)c) != schema[c].type)
+                return false;
+        for (std::size_t r = 0; r < rd.rows(); ++r)
+        {
+            t.emplace_back();
+            for (int c = 0; c < (int)schema.size(); ++c)
+            {
+                Cell v;
+                if (rd.valid(c, r))
+                    switch (rd.type(c))
+                    {
+                    case ResultType::Int:
+                    case ResultType::Bool:
+                        v = std::to_string(rd.integer(c, r));
+                        break;
+                    case ResultType::Real:
+                        v = fixed(rd.real(c, r), schema[c].precision);
+                        break;
+                    case ResultType::Text:
+                        v = std::string(rd.text(c, r));
+                        break;
+                    case ResultType::Points:
+                        v = points(rd.points(c, r));
+                        break;
+                    }
+                t.back().push_back(v);
+            }
+        }
+        return true;
+    }
+
+    void compare(const char *format, const Table &want, const Table &got)
+    {
+        const auto &schema = result_schema();
+        CHECK_MSG(got.size() == want.size(), format << ": " << got.size() << " rows, want " << want.size());
+        int mismatches = 0;
+        for (std::size_t r = 0; r < std::min(got.size(), want.size()); ++r)
+        {
+            CHECK_MSG(got[r].size() == want[r].size(), format << " row " << r << ": " << got[r].size() << " cells");
+            for (std::size_t c = 0; c < std::min(got[r].size(), want[r].size()) && mismatches < 10; ++c)
+                if (got[r][c] != want[r][c])
+                {
+                    ++mismatches;
+                    CHECK_MSG(false, format << " row " << r << " " << schema[c].name << ": '"
+                                            << got[r][c].value_or("<null>") << "', want '"
+                                            << want[r][c].value_or("<null>") << "'");
+                }
+        }
+    }
+
+    // Overwrites text offset `k` of column `col` in group 0 (layout: see
+    // ColumnarReader; the columns before `col` must be Int)
+    void corrupt_offset(const std::string &path, int col, int k, std::uint32_t value)
+    {
+        std::fstream f(path, std::ios::binary | std::ios::in | std::ios::out);
+        f.seekg(-24, std::ios::end);
+        std::uint64_t groups = 0;
+        f.read((char *)&groups, 8);
+        f.seekg(-(std::streamoff)(24 + 8 * groups), std::ios::end);
+        std::uint64_t group0 = 0;
+        f.read((char *)&group0, 8);
+        f.seekg((std::streamoff)group0);
+        std::uint32_t rows = 0;
+        f.read((char *)&rows, 4);
+        const std::uint64_t validity = ((rows + 7) / 8 + 7) / 8 * 8;
+        const std::uint64_t pos = group0 + 8 + col * (validity + 8ull * rows) + validity + 4ull * k;
+        f.seekp((std::streamoff)pos);
+        f.write((const char *)&value, 4);
+    }
+
+    void check_corrupt_offsets(const std::string &good, const fs::path &dir, const Table &want)
+    {
+        const auto &schema = result_schema();
+        const int col = 1;
+        CHECK(schema[0].type == ResultType::Int && schema[col].type == ResultType::Text);
+        const std::string bad = (dir / "corrupt.mcec").string();
+        fs::copy_file(good, bad, fs::copy_options::overwrite_existing);
+        corrupt_offset(bad, col, 3, 0xFFFFFFF0u); // end of row 2, start of row 3
+
+        ColumnarReader rd;
+        const bool opened = rd.open(bad);
+        CHECK_MSG(opened, "corrupt offset: framing is intact, open must succeed");
+        if (!opened)
+            return;
+        CHECK_MSG(rd.text(col, 2).empty(), "row 2: offset past the group's bytes was read");
+        CHECK_MSG(rd.text(col, 3).empty(), "row 3: decreasing offsets were read");
+        CHECK(want[4][col] && rd.text(col, 4) == *want[4][col]);
+        CHECK(want[4096][col] && rd.text(col, 4096) == *want[4096][col]);
+    }
+} // namespace
+
+int main()
+{
+    const fs::path dir = fs::temp_directory_path() / "mce_result_formats";
+    fs::remove_all(dir);
+    fs::create_directories(dir);
+    const std::string stem = (dir / "results").string();
+
+    Rows rows;
+    make_rows(rows);
+    const Table want = expected(rows);
+
+    for (const char *format : {"csv", "jsonl", "columnar"})
+        CHECK_MSG(write_all(format, stem, rows), format << ": write failed");
+
+    Table csv, jsonl, columnar;
+    CHECK_MSG(read_csv(stem + ".csv", csv), "csv: malformed");
+    CHECK_MSG(read_jsonl(stem + ".jsonl", jsonl), "jsonl: malformed");
+    CHECK_MSG(read_columnar(stem + ".mcec", columnar), "mcec: cannot open");
+    compare("csv", want, csv);
+    compare("jsonl", want, jsonl);
+    compare("mcec", want, columnar);
+
+    check_corrupt_offsets(stem + ".mcec", dir, want);
+    fs::remove_all(dir);
+    return mce_test::result();
+}
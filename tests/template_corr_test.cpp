@@ -0,0 +1,99 @@
+// tests/template_corr_test.cpp — grid::template_corr == TM_CCOEFF_NORMED.
+//
+// The template validator scores a Sobel magnitude against the ideal grid
+// template with a fused one-pass formula instead of cv::matchTemplate.
+// For random, constant-region and constant (zero-variance) magnitudes of
+// the warp sizes the validator sees, |score − matchTemplate| must stay
+// below 1e-4.
+#include "check.hpp"
+#include "mce/grid_ops.hpp"
+
+#include <opencv2/core.hpp>
+#include <opencv2/imgproc.hpp>
+
+#include <cmath>
+#include <random>
+#include <string>
+
+namespace
+{
+    std::mt19937 g_rng(1015);
+
+    float uniform(float lo, float hi)
+    {
+        return std::uniform_real_distribution<float>(lo, hi)(g_rng);
+    }
+
+    int uniform_int(int lo, int hi) // inclusive
+    {
+        return std::uniform_int_distribution<int>(lo, hi)(g_rng);
+    }
+
+    // kind 0: noise; 1: flat background with random rectangles (constant
+    // regions, like a warp of uniform cells); 2: noise plus the grid itself
+    // (correlation near 1); 3: constant (zero variance); 4: constant but one
+    // row (variance on a single line)
+    cv::Mat random_mag(cv::Size sz, int kind, const cv::Mat &templ)
+    {
+        cv::Mat m(sz, CV_32F);
+        const float base = uniform(0.f, 400.f);
+        for (int y = 0; y < m.rows; ++y)
+        {
+            float *r = m.ptr<float>(y);
+            for (int x = 0; x < m.cols; ++x)
+                r[x] = kind == 0 || kind == 2 ? uniform(0.f, 1000.f) : base;
+        }
+        if (kind == 1)
+        {
+            for (int k = uniform_int(1, 12); k > 0; --k)
+            {
+                const int x = uniform_int(0, sz.width - 1), y = uniform_int(0, sz.height - 1);
+                const cv::Rect r(x, y, uniform_int(1, sz.width - x), uniform_int(1, sz.height - y));
+                m(r).setTo(uniform(0.f, 1000.f));
+            }
+        }
+        else if (kind == 2)
+        {
+            cv::scaleAdd(templ, 4000.0, m, m);
+        }
+        else if (kind == 4)
+        {
+            m.row(uniform_int(0, sz.height - 1)).setTo(base + uniform(1.f, 500.f));
+        }
+        return m;
+    }
+} // namespace
+
+int main()
+{
+    // Warp sizes the validator sees: full, barcode-stripped, small mode
+    const cv::Size sizes[] = {{360, 360}, {360, 317}, {59, 59}, {59, 52}, {120, 97}, {16, 16}};
+    const char *kinds[] = {"noise", "constant regions", "grid + noise", "constant", "constant + one row"};
+    double worst = 0;
+    int n = 0;
+    for (const cv::Size &sz : sizes)
+    {
+        mce::grid::GridTemplate gt;
+        mce::grid::make_grid_template(sz, gt);
+        for (int t = 0; t < 40; ++t)
+        {
+            const int kind = t % 5;
+            const cv::Mat mag = random_mag(sz, kind, gt.t);
+
+            cv::Mat ref;
+            cv::matchTemplate(mag, gt.t, ref, cv::TM_CCOEFF_NORMED);
+            CHECK(ref.rows == 1 && ref.cols == 1);
+            const double want = ref.at<float>(0, 0);
+            const double got = mce::grid::template_corr(mag, gt);
+            const double err = std::fabs(got - want);
+            worst = std::max(worst, err);
+            ++n;
+            CHECK_MSG(err < 1e-4, sz.width << "x" << sz.height << " " << kinds[kind] << ": template_corr " << got
+                                            << " vs matchTemplate " << want);
+            if (kind == 3)
+                CHECK_MSG(got == 0.0, sz.width << "x" << sz.height << " zero variance: " << got << ", want 0");
+        }
+    }
+    std::cout << n << " magnitudes compared, max |diff| " << worst << "\n";
+    return mce_test::result();
+}